@@ -1,12 +1,130 @@
 #pragma once
 
+#include "matrix_op/parallel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace matrix_service {
 
+inline constexpr std::uint64_t DefaultSmallRequestCost = 128ull * 128 * 128;
+
+// Общие на процесс настройки исполнения процедур
+struct ExecutorConfig
+{
+    // Сколько потоков может считать одно умножение (0 - по числу ядер)
+    std::uint16_t compute_threads = 0;
+    // Умножения с rows * inner * columns меньше порога считаются в потоке запроса
+    std::uint64_t parallel_threshold = matrix_op::DefaultParallelThreshold;
+    // Лимит памяти кэша готовых ответов на повторные запросы (0 - кэш выключен)
+    std::size_t result_cache_bytes = 0;
+    // Потоки для асинхронно исполняемых запросов (SubmitProcedure), 0 - по числу ядер
+    std::uint16_t request_threads = 0;
+    // Закрепить потоки SubmitProcedure за ядрами (поток i - за ядром i по кругу)
+    bool pin_request_threads = false;
+
+    // Планировщик: запросы с оценкой стоимости (rows * inner * columns) меньше small_request_cost
+    // и остальные исполняются в отдельных полосах с заданным числом мест, внутри полосы - сначала
+    // дешевые. Ожидание в течение request_aging_ms вдвое снижает оценку, чтобы дорогие не голодали.
+    // Оба числа мест 0 - без планировщика, запросы исполняются сразу.
+    std::uint16_t small_request_slots = 0;
+    std::uint16_t large_request_slots = 0;
+    std::uint64_t small_request_cost = DefaultSmallRequestCost;
+    std::uint32_t request_aging_ms = 100;
+
+    // Одновременные FP32-умножения на одинаковую матрицу B (без эпилога, блочным алгоритмом) ждут
+    // друг друга столько микросекунд и считаются одним произведением. 0 - без объединения
+    std::uint32_t coalesce_window_us = 0;
+
+    // Лимит памяти хранилища загруженных матриц (STORE_MATRIX), 0 - хранилище выключено.
+    // Матрица занимает в нем примерно вдвое больше своего размера: хранится еще и упакованной
+    std::size_t matrix_store_bytes = 0;
+
+    // Каталог файлов матриц для умножения без загрузки в память (MAPPED_MUL), пусто - процедура выключена
+    std::string mapped_matrix_dir;
+};
+
+struct ResultCacheStats
+{
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;
+};
+
+struct CoalescingStats
+{
+    std::uint64_t window_us = 0;
+    std::uint64_t requests = 0;  // Умножений, которые могли объединиться
+    std::uint64_t coalesced = 0; // Из них посчитаны в чужом общем произведении
+    std::uint64_t batches = 0;   // Общих произведений больше чем из одного запроса
+};
+
+struct MatrixStoreStats
+{
+    std::size_t matrices = 0;
+    std::size_t bytes = 0;
+    std::uint64_t evictions = 0; // Вытеснено по лимиту памяти (без явных RELEASE_MATRIX)
+};
+
+struct SchedulerStats
+{
+    std::uint64_t small_started = 0;
+    std::uint64_t large_started = 0;
+    std::uint64_t borrowed = 0; // Мелкие запросы на свободных местах дорогой полосы
+    std::size_t small_waiting = 0;
+    std::size_t large_waiting = 0;
+};
+
+// Применяет настройки; вызывается до начала обработки запросов
+void ConfigureExecutor(const ExecutorConfig& conf);
+
+// Кадр протокола: {размер content (FrameSize)} + {content}
+using FrameSize = std::int32_t;
+
 // Исполняет процедуру, content должен содержать сериализованный протобуф Procedure,
 // ответом также будет сериализованный протобуф Procedure.
 // Второе поле - является ли исполнение успешным. Если нет, то proc_id==INVALID, а content содержит ошибку
+// Успешные ответы запоминаются в кэше, если он включен (см. ExecutorConfig::result_cache_bytes)
 std::pair<std::string, bool> ExecuteProcedure(std::string_view content);
 
+// То же без лишних копий для серверов: content разбирается в арене потока, payload не копируется,
+// а ответ сразу с префиксом размера пишется в framed_response поверх прежнего содержимого.
+// Емкость framed_response переиспользуется, поэтому повторные запросы не выделяют память на разбор и ответ.
+// Возвращает успешность исполнения, как второе поле выше.
+bool ExecuteProcedure(std::string_view content, std::vector<char>& framed_response);
+
+// Запрос для асинхронного исполнения. Буферы передаются во владение пулу и возвращаются
+// в завершении, чтобы вызывающий мог переиспользовать их емкость.
+struct AsyncProcedure
+{
+    std::vector<char> request;         // content запроса начинается с request_offset (например, после префикса размера)
+    std::size_t request_offset = 0;
+    std::vector<char> framed_response; // Ответ с префиксом размера, см. ExecuteProcedure выше
+    bool succeeded = false;            // Пустой framed_response при !succeeded - внутренняя ошибка, ответа нет
+};
+
+// Вызывается в потоке пула, должно быть коротким (например, переложить результат в очередь цикла событий)
+using ProcedureCompletion = std::function<void(AsyncProcedure&&)>;
+
+// Ставит исполнение в пул из ExecutorConfig::request_threads потоков и сразу возвращается
+void SubmitProcedure(AsyncProcedure procedure, ProcedureCompletion completion);
+
+// Счетчики кэша ответов, нули при выключенном кэше
+ResultCacheStats GetResultCacheStats();
+
+// Счетчики объединения умножений, нули без него
+CoalescingStats GetCoalescingStats();
+
+// Счетчики планировщика, нули без него
+SchedulerStats GetSchedulerStats();
+
+// Состояние хранилища матриц, нули без него
+MatrixStoreStats GetMatrixStoreStats();
+
 } // namespace matrix_service
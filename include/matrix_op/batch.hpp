@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace matrix_op {
+
+// Размеры пакета: count произведений (rows x inner) * (inner x columns)
+struct BatchShape
+{
+    std::uint32_t count;
+    std::uint32_t rows;
+    std::uint32_t inner;
+    std::uint32_t columns;
+};
+
+// MatrixCalcError, если размеры аргументов не соответствуют shape или пакет пуст
+void ValidateBatch(const BatchShape& shape, std::span<const float> first, std::span<const float> another);
+
+// result_i = first_i * another_i для всех i < shape.count. Матрицы каждого массива лежат подряд
+// плотно по строкам. Маленькие произведения считаются группами по нескольку: элемент каждой матрицы
+// группы - в своей SIMD-линии, так что линии заполнены и на 2x2. Пакет делится между потоками
+// общего пула (см. parallel.hpp), если суммарный объем больше ParallelThreshold().
+void MultiplyBatch(const BatchShape& shape, std::span<const float> first, std::span<const float> another,
+                   std::span<float> result);
+
+} // namespace matrix_op
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "matrix.hpp"
+#include "matrix_view.hpp"
+#include "storage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace matrix_op {
+
+// Оптимальный порядок умножения цепочки A0 * A1 * ... * A(n-1), где Ai - dims[i] x dims[i+1].
+// Классическая динамика O(n^3) по стоимости rows * inner * columns каждого умножения.
+class ChainOrder
+{
+public:
+    explicit ChainOrder(std::span<const std::uint32_t> dims);
+
+    std::uint32_t Size() const { return size_; }
+    // Суммарная стоимость оптимального порядка
+    std::uint64_t Cost() const { return Cost(0, size_ - 1); }
+    std::uint64_t Cost(std::uint32_t i, std::uint32_t j) const { return cost_[i * size_ + j]; }
+    // Где разрезать Ai..Aj: (Ai..Ak) * (Ak+1..Aj)
+    std::uint32_t Split(std::uint32_t i, std::uint32_t j) const { return split_[i * size_ + j]; }
+
+private:
+    std::uint32_t size_;
+    std::vector<std::uint64_t> cost_;
+    std::vector<std::uint32_t> split_;
+};
+
+// Размеры (rows, columns) наибольшего промежуточного произведения цепочки в порядке ChainOrder,
+// т.е. того, что MultiplyChain выделит в пуле. {0, 0}, если промежуточных нет (меньше трех матриц)
+std::pair<std::uint32_t, std::uint32_t> LargestChainIntermediate(std::span<const std::uint32_t> dims);
+
+
+// Пул буферов под промежуточные результаты: освобожденный буфер отдается
+// следующему подходящему по размеру запросу вместо нового выделения.
+class BufferPool
+{
+public:
+    AlignedBuffer Acquire(std::size_t size);
+    void Release(AlignedBuffer buffer);
+
+private:
+    std::vector<AlignedBuffer> free_;
+};
+
+
+// result = factors[0] * ... * factors[n-1] в оптимальном порядке (n >= 1).
+// Промежуточные произведения берутся из pool и возвращаются в него.
+// Эпилог options применяется только к последнему умножению (n >= 2).
+void MultiplyChain(std::span<const MatrixView> factors, MutableMatrixView result,
+                   const MulOptions& options, BufferPool& pool);
+
+} // namespace matrix_op
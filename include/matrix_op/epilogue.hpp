@@ -0,0 +1,27 @@
+#pragma once
+
+// Без зависимостей от стандартной библиотеки: подключается и в SIMD-ядра (см. kernels.hpp)
+
+namespace matrix_op {
+
+// Поэлементная функция, применяемая к результату умножения
+enum class Activation
+{
+    None,
+    Relu, // max(x, 0)
+};
+
+// Эпилог умножения: result = act(alpha * op(A) * op(B) + beta * result + bias).
+// Применяется микроядром к тайлу результата, пока тот в регистрах, - результат пишется
+// в память один раз. При beta == 0 прежнее содержимое result не читается.
+struct Epilogue
+{
+    float alpha = 1;
+    float beta = 0;
+    const float* bias = nullptr; // По элементу на столбец результата или nullptr
+    Activation activation = Activation::None;
+
+    bool Trivial() const { return alpha == 1 && beta == 0 && bias == nullptr && activation == Activation::None; }
+};
+
+} // namespace matrix_op
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "isa_kind.hpp"
+
+#include <string_view>
+
+namespace matrix_op {
+
+std::string_view IsaName(Isa isa);
+// Разбор имени ("scalar", "avx2", "avx512"), false - если имя неизвестно
+bool ParseIsa(std::string_view name, Isa& isa);
+
+// Лучший набор, поддерживаемый процессором и ОС (определяется через CPUID один раз)
+Isa DetectedIsa();
+bool IsaSupported(Isa isa);
+
+// Текущее ядро. По умолчанию - DetectedIsa(), но можно понизить переменной
+// окружения MATRIX_OP_ISA=<name> (неподдерживаемое значение игнорируется).
+Isa ActiveIsa();
+// Принудительный выбор ядра (для тестов и бенчмарков), MatrixCalcError - если не поддерживается
+void ForceIsa(Isa isa);
+
+} // namespace matrix_op
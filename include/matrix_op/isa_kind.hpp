@@ -0,0 +1,16 @@
+#pragma once
+
+// Только перечисление, без функций над ним: его видят и SIMD-ядра (см. kernels.hpp)
+#include <cstdint>
+
+namespace matrix_op {
+
+// Набор инструкций, под который собрано микроядро умножения
+enum class Isa : std::uint8_t
+{
+    Scalar = 0, // Переносимый вариант, есть всегда
+    Avx2   = 1, // AVX2 + FMA
+    Avx512 = 2, // AVX-512F
+};
+
+} // namespace matrix_op
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "matrix_view.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace matrix_op {
+
+// Файл матрицы: заголовок MappedMatrixHeader, затем rows x columns float по строкам подряд
+// (порядок байтов - как у машины). Заголовок занимает 64 байта, так что данные выровнены.
+struct MappedMatrixHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t rows;
+    std::uint32_t columns;
+    std::uint8_t reserved[48];
+};
+static_assert(sizeof(MappedMatrixHeader) == 64);
+
+inline constexpr std::uint32_t MappedMatrixMagic = 0x4d504f4d; // "MOPM"
+inline constexpr std::uint32_t MappedMatrixVersion = 1;
+
+// Матрица в файле, отображенном в память (mmap). Может быть больше оперативной памяти:
+// страницы подгружаются ядром ОС по обращению и вытесняются обратно в файл.
+class MappedMatrix
+{
+public:
+    // Непустой root - каталог, относительно которого берется path: путь не выходит из него
+    // и не проходит через символические ссылки (openat2, Linux 5.6+)
+
+    // Только для чтения. MatrixCalcError, если файл не открывается или заголовок/размер некорректны
+    static MappedMatrix Open(const std::string& path, const std::string& root = {});
+    // Новая матрица rows x columns из нулей. Пишется во временный файл рядом с path и заменяет path
+    // только в Commit: отображения старого файла (в том числе аргументов того же умножения) не портятся.
+    // Без Commit временный файл удаляется деструктором
+    static MappedMatrix Create(const std::string& path, std::uint32_t rows, std::uint32_t columns,
+                               const std::string& root = {});
+
+    MappedMatrix(MappedMatrix&& another) noexcept;
+    MappedMatrix& operator=(MappedMatrix&& another) noexcept;
+    ~MappedMatrix();
+
+    std::uint32_t Rows() const { return rows_; }
+    std::uint32_t Columns() const { return columns_; }
+    bool Writable() const { return writable_; }
+
+    MatrixView View() const;
+    // MatrixCalcError, если открыта только для чтения
+    MutableMatrixView MutableView();
+
+    // Созданная матрица заменит файл, открытый как another
+    bool Replaces(const MappedMatrix& another) const;
+    // Переименовывает временный файл созданной матрицы в path из Create
+    void Commit();
+
+private:
+    // Владеет fd сразу: при ошибке дальнейшего открытия все закроет деструктор
+    MappedMatrix(int fd, bool writable);
+    void Map(const std::string& path, std::size_t size);
+    void Close();
+
+private:
+    int fd_ = -1;
+    void* mapping_ = nullptr;
+    std::size_t size_ = 0;
+    bool writable_ = false;
+    std::uint32_t rows_ = 0;
+    std::uint32_t columns_ = 0;
+    // Файл (st_dev, st_ino): у открытой - ее, у созданной - заменяемый в Commit, если он есть
+    std::uint64_t file_dev_ = 0;
+    std::uint64_t file_ino_ = 0;
+    // Созданная, до Commit: каталог и имена временного и итогового файлов в нем
+    int dir_fd_ = -1;
+    std::string temp_name_;
+    std::string name_;
+};
+
+inline constexpr std::size_t DefaultOutOfCoreWorkingSet = 256u << 20;
+
+struct OutOfCoreOptions
+{
+    // Сколько байт окон аргументов и результата держать отображенными одновременно
+    std::size_t working_set_bytes = DefaultOutOfCoreWorkingSet;
+};
+
+// result = first * another по частям, когда матрицы не помещаются в память. Для каждой полосы строк
+// first (вместе с полосой result) через память проходит another слоями по K, следующий слой заранее
+// запрашивается у ОС (madvise WILLNEED), пройденные - отпускаются (DONTNEED). Каждая часть считается
+// блочным умножением (см. matrix.hpp) с накоплением в result, слои кратны блоку K ядра - результат
+// совпадает бит в бит с умножением в памяти. Слой another - не меньше одного блока K, даже если
+// это больше working_set_bytes. result должен быть first.Rows() x another.Columns().
+void MultiplyOutOfCore(const MappedMatrix& first, const MappedMatrix& another, MappedMatrix& result,
+                       const OutOfCoreOptions& options = {});
+
+} // namespace matrix_op
@@ -1,25 +1,134 @@
 #pragma once
 
+#include "epilogue.hpp"
 #include "matrix_exception.hpp"
+#include "matrix_view.hpp"
+#include "precision.hpp"
+#include "storage.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <compare>
+#include <cstddef>
 #include <cstdint>
 #include <format>
+#include <iterator>
 #include <span>
-#include <vector>
 
 namespace matrix_op {
 
+enum class MulAlgorithm
+{
+    Classic,  // Блочное O(n^3), детерминированная ошибка округления
+    Strassen, // Штрассен-Виноград: быстрее на больших матрицах, но погрешность выше
+};
+
+// Минимальный размер подзадачи, на котором рекурсия Штрассена еще выигрывает у блочного ядра
+inline constexpr std::uint32_t DefaultStrassenCutoff = 1024;
+
+// Множитель берется как есть или транспонированным: op(X) = X или X^T.
+// Транспонирование не материализуется - его поглощает упаковка панелей в блочном ядре.
+enum class Trans
+{
+    No,
+    Yes,
+};
+
+struct MulOptions
+{
+    MulAlgorithm algorithm = MulAlgorithm::Classic;
+    // Для Strassen: рекурсия идет, пока min(rows, inner, columns) / 2 >= cutoff
+    std::uint32_t strassen_cutoff = DefaultStrassenCutoff;
+    // В блочном алгоритме сливается с записью результата, в Штрассене - отдельный проход
+    Epilogue epilogue = {};
+};
+
+
+// Поэлементный обход матрицы по строкам без учета дополнения строк (см. Matrix::Stride()).
+// Для массового копирования быстрее идти по строкам через Matrix::operator[].
+class MatrixContent
+{
+public:
+    // Итератор самодостаточен: переживает временный MatrixContent (Content().begin())
+    class Iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = float;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const float*;
+        using reference = const float&;
+
+        Iterator() = default;
+        Iterator(const float* data, std::uint32_t columns, std::size_t stride, std::size_t idx)
+            : data_(data), columns_(columns), stride_(stride), idx_(idx)
+        {}
+
+        reference operator*() const { return At(idx_); }
+        reference operator[](difference_type n) const { return At(idx_ + n); }
+
+        Iterator& operator++() { ++idx_; return *this; }
+        Iterator operator++(int) { Iterator prev = *this; ++idx_; return prev; }
+        Iterator& operator--() { --idx_; return *this; }
+        Iterator operator--(int) { Iterator prev = *this; --idx_; return prev; }
+        Iterator& operator+=(difference_type n) { idx_ += n; return *this; }
+        Iterator& operator-=(difference_type n) { idx_ -= n; return *this; }
+
+        friend Iterator operator+(Iterator it, difference_type n) { return it += n; }
+        friend Iterator operator+(difference_type n, Iterator it) { return it += n; }
+        friend Iterator operator-(Iterator it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) { return lhs.idx_ - rhs.idx_; }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) { return lhs.idx_ == rhs.idx_; }
+        friend auto operator<=>(const Iterator& lhs, const Iterator& rhs) { return lhs.idx_ <=> rhs.idx_; }
+
+    private:
+        const float& At(std::size_t idx) const
+        {
+            return stride_ == columns_ ? data_[idx] : data_[idx / columns_ * stride_ + idx % columns_];
+        }
+
+    private:
+        const float* data_ = nullptr;
+        std::uint32_t columns_ = 0;
+        std::size_t stride_ = 0;
+        std::size_t idx_ = 0;
+    };
+
+    MatrixContent(const float* data, std::uint32_t rows, std::uint32_t columns, std::size_t stride)
+        : data_(data), rows_(rows), columns_(columns), stride_(stride)
+    {}
+
+    std::size_t size() const { return std::size_t(rows_) * columns_; }
+    bool empty() const { return size() == 0; }
+
+    const float& operator[](std::size_t idx) const
+    {
+        assert(idx < size());
+        return begin()[idx];
+    }
+
+    Iterator begin() const { return Iterator(data_, columns_, stride_, 0); }
+    Iterator end() const { return Iterator(data_, columns_, stride_, size()); }
+
+private:
+    const float* data_;
+    std::uint32_t rows_;
+    std::uint32_t columns_;
+    std::size_t stride_;
+};
+
+
+// Матрица row-major. Строки выровнены и могут быть дополнены до Stride() элементов
+// (см. storage.hpp), поэтому данные не обязательно лежат подряд.
 class Matrix
 {
 public:
     Matrix(std::uint32_t rows, std::uint32_t columns, const float* begin, const float* end)
-        : rows_(rows),
-          columns_(columns),
-          matrix_(begin, end)
+        : Matrix(ValidatedRows(rows, columns, end - begin), columns)
     {
-        if (matrix_.size() != rows_ * columns_ || matrix_.empty()) [[unlikely]]
-            throw MatrixCalcError(std::format("Data size {} != {} (r) x {} (c) <or> empty matrix", matrix_.size(), rows_, columns_));
+        for (std::uint32_t r = 0; r < rows_; r++)
+            std::copy(begin + std::size_t(r) * columns_, begin + std::size_t(r + 1) * columns_, RowData(r));
     }
 
     Matrix(const Matrix&) = default;
@@ -30,33 +139,81 @@ public:
     std::span<const float> operator[](std::uint32_t row) const
     {
         assert(row < rows_);
-        return std::span<const float>(matrix_.data() + columns_*row, columns_);
+        return std::span<const float>(storage_.Data() + stride_*row, columns_);
     }
 
     std::uint32_t Rows() const { return rows_; }
     std::uint32_t Columns() const { return columns_; }
-    std::span<const float> Content() const { return matrix_; }
+    // Шаг между началами строк в элементах (>= Columns())
+    std::size_t Stride() const { return stride_; }
+    const float* Data() const { return storage_.Data(); }
+    MatrixContent Content() const { return MatrixContent(storage_.Data(), rows_, columns_, stride_); }
+    MatrixView View() const { return MatrixView(rows_, columns_, stride_, storage_.Data()); }
 
-    friend Matrix operator*(const Matrix&, const Matrix&);
+    friend Matrix Multiply(const Matrix&, const Matrix&, const MulOptions&);
+    friend Matrix Transpose(const Matrix&);
 
 private:
+    // Содержимое не инициализируется
     Matrix(std::uint32_t rows, std::uint32_t columns)
         : rows_(rows),
           columns_(columns),
-          matrix_(rows_ * columns_)
+          stride_(LeadingDimension(columns)),
+          storage_(stride_ * rows)
     {}
 
-    float& operator[](std::pair<std::uint32_t, std::uint32_t> rc)
+    float* RowData(std::uint32_t row) { return storage_.Data() + stride_*row; }
+
+    // Проверка до выделения памяти: размеры из запроса могут быть сколь угодно большими
+    static std::uint32_t ValidatedRows(std::uint32_t rows, std::uint32_t columns, std::size_t size)
     {
-        assert(rc.first < rows_ && rc.second < columns_);
-        return *(matrix_.data() + columns_*rc.first + rc.second);
+        if (size != std::size_t(rows) * columns || size == 0) [[unlikely]]
+            throw MatrixCalcError(std::format("Data size {} != {} (r) x {} (c) <or> empty matrix", size, rows, columns));
+        return rows;
     }
 
 private:
     std::uint32_t rows_;
     std::uint32_t columns_;
+    std::size_t stride_;
 
-    std::vector<float> matrix_;
+    AlignedBuffer storage_;
 };
 
+// options.epilogue.beta должен быть 0: у нового результата нет прежнего содержимого
+Matrix Multiply(const Matrix& first, const Matrix& another, const MulOptions& options);
+
+// MatrixCalcError, если матрицы нельзя перемножить
+void ValidateMulShapes(MatrixView first, MatrixView another);
+// Для любого формата элементов (float, Float16, BFloat16, std::int8_t)
+template<typename T>
+void ValidateMulShapes(BasicMatrixView<T> first, Trans first_trans, BasicMatrixView<T> another, Trans another_trans);
+
+// Умножение без промежуточных копий: result должен иметь размер first.Rows() x another.Columns()
+// и не пересекаться с аргументами (bias эпилога - тоже)
+void Multiply(MatrixView first, MatrixView another, MutableMatrixView result, const MulOptions& options = {});
+// result = op(first) * op(another), размер result - строки op(first) x столбцы op(another)
+void Multiply(MatrixView first, Trans first_trans, MatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options = {});
+
+// Пониженная точность хранения: элементы расширяются до fp32 при упаковке панелей, умножение
+// и накопление идут в fp32 теми же микроядрами. Только блочный алгоритм: options.algorithm игнорируется.
+void Multiply(Float16MatrixView first, Trans first_trans, Float16MatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options = {});
+void Multiply(BFloat16MatrixView first, Trans first_trans, BFloat16MatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options = {});
+// int8: произведения (q - zero_point) точно копятся в int32 по блокам K,
+// результат - first.scale * another.scale * сумма в fp32
+void Multiply(QuantizedMatrixView first, Trans first_trans, QuantizedMatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options = {});
+
+// result = matrix^T, размер result - matrix.Columns() x matrix.Rows(), не пересекается с matrix
+void Transpose(MatrixView matrix, MutableMatrixView result);
+Matrix Transpose(const Matrix& matrix);
+
+inline Matrix operator*(const Matrix& first, const Matrix& another)
+{
+    return Multiply(first, another, {});
+}
+
 } // namespace matrix_op
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "matrix_exception.hpp"
+#include "precision.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <span>
+
+namespace matrix_op {
+
+// Невладеющее представление row-major матрицы: rows x columns, строки через stride элементов.
+// Позволяет умножать данные на месте (например, прямо из протобуфа) без копирования в Matrix.
+// T - формат хранения элементов: float или пониженной точности (см. precision.hpp).
+template<typename T>
+class BasicMatrixView
+{
+public:
+    BasicMatrixView(std::uint32_t rows, std::uint32_t columns, std::size_t stride, const T* data)
+        : rows_(rows),
+          columns_(columns),
+          stride_(stride),
+          data_(data)
+    {
+        assert(stride_ >= columns_);
+    }
+
+    // Плотные данные [begin, end), с той же проверкой размера, что и у Matrix
+    BasicMatrixView(std::uint32_t rows, std::uint32_t columns, const T* begin, const T* end)
+        : BasicMatrixView(rows, columns, columns, begin)
+    {
+        const std::size_t size = end - begin;
+        if (size != std::size_t(rows_) * columns_ || size == 0) [[unlikely]]
+            throw MatrixCalcError(std::format("Data size {} != {} (r) x {} (c) <or> empty matrix", size, rows_, columns_));
+    }
+
+    std::span<const T> operator[](std::uint32_t row) const
+    {
+        assert(row < rows_);
+        return std::span<const T>(data_ + stride_*row, columns_);
+    }
+
+    std::uint32_t Rows() const { return rows_; }
+    std::uint32_t Columns() const { return columns_; }
+    std::size_t Stride() const { return stride_; }
+    const T* Data() const { return data_; }
+
+private:
+    std::uint32_t rows_;
+    std::uint32_t columns_;
+    std::size_t stride_;
+    const T* data_;
+};
+
+using MatrixView = BasicMatrixView<float>;
+using Float16MatrixView = BasicMatrixView<Float16>;
+using BFloat16MatrixView = BasicMatrixView<BFloat16>;
+
+// int8-матрица с параметрами квантования
+struct QuantizedMatrixView
+{
+    BasicMatrixView<std::int8_t> values;
+    Quantization quantization;
+};
+
+// То же для результата: куда писать произведение
+class MutableMatrixView
+{
+public:
+    MutableMatrixView(std::uint32_t rows, std::uint32_t columns, std::size_t stride, float* data)
+        : rows_(rows),
+          columns_(columns),
+          stride_(stride),
+          data_(data)
+    {
+        assert(stride_ >= columns_);
+    }
+
+    std::span<float> operator[](std::uint32_t row) const
+    {
+        assert(row < rows_);
+        return std::span<float>(data_ + stride_*row, columns_);
+    }
+
+    std::uint32_t Rows() const { return rows_; }
+    std::uint32_t Columns() const { return columns_; }
+    std::size_t Stride() const { return stride_; }
+    float* Data() const { return data_; }
+
+    operator MatrixView() const { return MatrixView(rows_, columns_, stride_, data_); }
+
+private:
+    std::uint32_t rows_;
+    std::uint32_t columns_;
+    std::size_t stride_;
+    float* data_;
+};
+
+} // namespace matrix_op
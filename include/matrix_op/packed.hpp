@@ -0,0 +1,51 @@
+#pragma once
+
+#include "matrix.hpp"
+#include "matrix_view.hpp"
+#include "storage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace matrix_op {
+
+namespace detail {
+struct MicroKernel;
+}
+
+// Правый множитель op(B), заранее упакованный в панели микроядра (как их пакует блочное
+// умножение). Умножения на него не тратят время и память на упаковку B - выгодно, когда
+// на одну матрицу умножают много раз. Упаковка привязана к ядру, активному при создании
+// (см. ActiveIsa()): оно же используется при умножении, даже если потом выбрано другое.
+class PackedMatrix
+{
+public:
+    explicit PackedMatrix(MatrixView matrix, Trans trans = Trans::No);
+
+    // Размеры op(B)
+    std::uint32_t Rows() const { return rows_; }
+    std::uint32_t Columns() const { return columns_; }
+    // Память под упакованные панели в байтах (неполные панели дополнены нулями)
+    std::size_t Bytes() const { return data_.Size() * sizeof(float); }
+
+private:
+    friend void Multiply(MatrixView first, Trans first_trans, const PackedMatrix& another,
+                         MutableMatrixView result, const MulOptions& options);
+
+    const detail::MicroKernel* kernel_;
+    std::uint32_t rows_;
+    std::uint32_t columns_;
+    AlignedBuffer data_;
+};
+
+// MatrixCalcError, если матрицы нельзя перемножить
+void ValidateMulShapes(MatrixView first, Trans first_trans, const PackedMatrix& another);
+
+// result = op(first) * another, размер result - строки op(first) x another.Columns().
+// Только блочный алгоритм: options.algorithm игнорируется. Результат совпадает бит в бит
+// с Multiply на неупакованной матрице тем же ядром (кроме маленьких фиксированных размеров,
+// которые там идут мимо упаковки).
+void Multiply(MatrixView first, Trans first_trans, const PackedMatrix& another,
+              MutableMatrixView result, const MulOptions& options = {});
+
+} // namespace matrix_op
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace matrix_op {
+
+// Сколько потоков (включая вызывающий) может считать одно произведение.
+// 0 - по числу ядер. Потоки берутся из общего на процесс пула.
+void SetParallelism(std::uint32_t threads);
+std::uint32_t Parallelism();
+
+// Произведения с rows * inner * columns меньше порога считаются в вызывающем потоке,
+// чтобы не платить за fork/join на маленьких матрицах.
+inline constexpr std::uint64_t DefaultParallelThreshold = 256ull * 256 * 256;
+void SetParallelThreshold(std::uint64_t volume);
+std::uint64_t ParallelThreshold();
+
+} // namespace matrix_op
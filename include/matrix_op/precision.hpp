@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+namespace matrix_op {
+
+// Форматы хранения пониженной точности. Арифметика всегда идет в fp32 (int32 для int8):
+// элементы расширяются при упаковке панелей, см. Multiply в matrix.hpp.
+
+// IEEE 754 binary16
+struct Float16
+{
+    std::uint16_t bits;
+};
+
+// bfloat16: старшие 16 бит fp32
+struct BFloat16
+{
+    std::uint16_t bits;
+};
+
+inline float ToFloat(Float16 value)
+{
+    const std::uint32_t sign = std::uint32_t(value.bits & 0x8000) << 16;
+    const std::uint32_t exponent = (value.bits >> 10) & 0x1f;
+    const std::uint32_t mantissa = value.bits & 0x3ff;
+
+    if (exponent == 0x1f) // inf / nan
+        return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+    if (exponent == 0)    // ноль / денормализованное: mantissa * 2^-24
+        return std::bit_cast<float>(sign | std::bit_cast<std::uint32_t>(float(mantissa) * 0x1p-24f));
+    return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// Округление к ближайшему четному, переполнение - в inf
+inline Float16 ToFloat16(float value)
+{
+    const std::uint32_t x = std::bit_cast<std::uint32_t>(value);
+    const std::uint32_t sign = (x >> 16) & 0x8000;
+    const std::uint32_t abs = x & 0x7fffffff;
+
+    if (abs > 0x7f800000) // nan (сохраняем quiet-бит)
+        return { std::uint16_t(sign | 0x7e00) };
+    if (abs >= 0x477ff000) // >= 65520 округляется в inf
+        return { std::uint16_t(sign | 0x7c00) };
+    if (abs < 0x38800000) // < 2^-14 - денормализованное: округление делает FPU при сложении с 0.5
+    {
+        const float shifted = std::bit_cast<float>(abs) + 0.5f;
+        return { std::uint16_t(sign | (std::bit_cast<std::uint32_t>(shifted) - 0x3f000000)) };
+    }
+
+    // Смена смещения экспоненты (127 -> 15) и округление мантиссы с 23 до 10 бит
+    const std::uint32_t odd = (abs >> 13) & 1;
+    return { std::uint16_t(sign | ((abs - 0x38000000 + 0xfff + odd) >> 13)) };
+}
+
+inline float ToFloat(BFloat16 value)
+{
+    return std::bit_cast<float>(std::uint32_t(value.bits) << 16);
+}
+
+inline BFloat16 ToBFloat16(float value)
+{
+    const std::uint32_t x = std::bit_cast<std::uint32_t>(value);
+    if ((x & 0x7fffffff) > 0x7f800000) // nan
+        return { std::uint16_t((x >> 16) | 0x40) };
+    return { std::uint16_t((x + 0x7fff + ((x >> 16) & 1)) >> 16) };
+}
+
+
+// Аффинное квантование int8: value = scale * (q - zero_point)
+struct Quantization
+{
+    float scale = 1.f;
+    std::int32_t zero_point = 0;
+};
+
+// Параметры, покрывающие [min, max] (расширенный до нуля, чтобы ноль представлялся точно)
+inline Quantization ChooseQuantization(float min, float max)
+{
+    min = std::min(min, 0.f);
+    max = std::max(max, 0.f);
+    if (!(max > min)) // все нули (или nan)
+        return {};
+
+    const float scale = (max - min) / 255.f;
+    const float zero_point = std::clamp(std::round(-128.f - min / scale), -128.f, 127.f);
+    return { scale, std::int32_t(zero_point) };
+}
+
+inline std::int8_t Quantize(float value, Quantization q)
+{
+    const float scaled = std::round(value / q.scale) + float(q.zero_point);
+    if (std::isnan(scaled)) [[unlikely]]
+        return std::int8_t(q.zero_point);
+    return std::int8_t(std::clamp(scaled, -128.f, 127.f));
+}
+
+inline float Dequantize(std::int8_t value, Quantization q)
+{
+    return q.scale * float(std::int32_t(value) - q.zero_point);
+}
+
+} // namespace matrix_op
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "matrix_view.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace matrix_op {
+
+// Способ сжатия разреженной матрицы. "Линия" - строка для CSR и столбец для CSC.
+enum class SparseLayout
+{
+    Csr, // offsets - начала строк, indices - номера столбцов
+    Csc, // offsets - начала столбцов, indices - номера строк
+};
+
+// Невладеющее представление CSR/CSC-матрицы: ненулевые элементы линии l лежат
+// в [offsets[l], offsets[l + 1]) массивов indices и values. Порядок индексов внутри линии любой.
+class SparseMatrixView
+{
+public:
+    // MatrixCalcError, если структура некорректна (размеры массивов, монотонность offsets, индексы вне матрицы)
+    SparseMatrixView(std::uint32_t rows, std::uint32_t columns, SparseLayout layout,
+                     std::span<const std::uint32_t> offsets,
+                     std::span<const std::uint32_t> indices,
+                     std::span<const float> values);
+
+    std::uint32_t Rows() const { return rows_; }
+    std::uint32_t Columns() const { return columns_; }
+    SparseLayout Layout() const { return layout_; }
+    std::uint32_t Lines() const { return layout_ == SparseLayout::Csr ? rows_ : columns_; }
+    std::size_t NonZeros() const { return values_.size(); }
+
+    std::span<const std::uint32_t> Offsets() const { return offsets_; }
+    std::span<const std::uint32_t> Indices() const { return indices_; }
+    std::span<const float> Values() const { return values_; }
+
+    // Те же данные как транспонированная матрица: CSR-матрица A - это CSC-матрица A^T
+    SparseMatrixView Transposed() const;
+
+private:
+    struct Unchecked {};
+    SparseMatrixView(Unchecked, std::uint32_t rows, std::uint32_t columns, SparseLayout layout,
+                     std::span<const std::uint32_t> offsets,
+                     std::span<const std::uint32_t> indices,
+                     std::span<const float> values);
+
+private:
+    std::uint32_t rows_;
+    std::uint32_t columns_;
+    SparseLayout layout_;
+    std::span<const std::uint32_t> offsets_;
+    std::span<const std::uint32_t> indices_;
+    std::span<const float> values_;
+};
+
+
+// Владеющая CSR/CSC-матрица
+class SparseMatrix
+{
+public:
+    SparseMatrix(std::uint32_t rows, std::uint32_t columns, SparseLayout layout,
+                 std::vector<std::uint32_t> offsets,
+                 std::vector<std::uint32_t> indices,
+                 std::vector<float> values);
+
+    // Ненулевые элементы плотной матрицы
+    static SparseMatrix FromDense(MatrixView dense, SparseLayout layout);
+
+    std::uint32_t Rows() const { return rows_; }
+    std::uint32_t Columns() const { return columns_; }
+    SparseLayout Layout() const { return layout_; }
+    std::size_t NonZeros() const { return values_.size(); }
+    SparseMatrixView View() const;
+
+private:
+    std::uint32_t rows_;
+    std::uint32_t columns_;
+    SparseLayout layout_;
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::uint32_t> indices_;
+    std::vector<float> values_;
+};
+
+// Перепаковка в другой формат (CSR <-> CSC) за O(nnz + rows + columns), индексы в линиях - по возрастанию
+SparseMatrix Convert(SparseMatrixView matrix, SparseLayout layout);
+// Плотная копия, result - matrix.Rows() x matrix.Columns()
+void ToDense(SparseMatrixView matrix, MutableMatrixView result);
+
+
+// MatrixCalcError, если матрицы нельзя перемножить
+void ValidateMulShapes(SparseMatrixView first, MatrixView another);
+void ValidateMulShapes(MatrixView first, SparseMatrixView another);
+void ValidateMulShapes(SparseMatrixView first, SparseMatrixView another);
+
+// Умножения с разреженным операндом. Строки результата делятся между потоками общего пула
+// (см. parallel.hpp) полосами с примерно равным числом ненулевых элементов.
+// Разреженная на плотную (SpMM, при одном столбце another - SpMV). CSC переупаковывается в CSR.
+void Multiply(SparseMatrixView first, MatrixView another, MutableMatrixView result);
+// Плотная на разреженную: для CSR - разброс строк another, для CSC - скалярные произведения со столбцами
+void Multiply(MatrixView first, SparseMatrixView another, MutableMatrixView result);
+// Разреженная на разреженную по Густавсону (плотный аккумулятор строки), результат в CSR
+SparseMatrix Multiply(SparseMatrixView first, SparseMatrixView another);
+
+} // namespace matrix_op
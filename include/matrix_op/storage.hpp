@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace matrix_op {
+
+// Политика размещения матриц в памяти (общая на процесс)
+struct StorageOptions
+{
+    // Дополнять шаг строки, если он кратен 4 КБ: иначе строки одного столбца попадают
+    // в один набор кэша (4K aliasing) на ширинах - степенях двойки.
+    bool pad_leading_dimension = true;
+    // Буферы от этого размера (в байтах) выделяются под huge pages (madvise MADV_HUGEPAGE)
+    std::size_t hugepage_threshold = 4u << 20;
+};
+
+void SetStorageOptions(const StorageOptions& options);
+StorageOptions GetStorageOptions();
+
+// Выравнивание начала буфера и строк (при ширине от RowAlignment / sizeof(float))
+inline constexpr std::size_t RowAlignment = 64;
+
+// Шаг строки (в элементах) для матрицы с данным числом столбцов
+std::size_t LeadingDimension(std::uint32_t columns);
+
+
+// Выровненный на RowAlignment буфер float-ов (содержимое не инициализируется)
+class AlignedBuffer
+{
+public:
+    AlignedBuffer() = default;
+    explicit AlignedBuffer(std::size_t size);
+
+    AlignedBuffer(const AlignedBuffer& another);
+    AlignedBuffer& operator=(const AlignedBuffer& another);
+    AlignedBuffer(AlignedBuffer&&) = default;
+    AlignedBuffer& operator=(AlignedBuffer&&) = default;
+
+    float* Data() { return data_.get(); }
+    const float* Data() const { return data_.get(); }
+    std::size_t Size() const { return size_; }
+
+private:
+    struct Deleter
+    {
+        void operator()(float* ptr) const;
+    };
+
+    std::unique_ptr<float[], Deleter> data_;
+    std::size_t size_ = 0;
+};
+
+} // namespace matrix_op
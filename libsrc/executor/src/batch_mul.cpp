@@ -0,0 +1,42 @@
+#include "procedures.hpp"
+
+#include "matrix_op/batch.hpp"
+#include "matrix_op/matrix_exception.hpp"
+
+#include <format>
+#include <limits>
+#include <span>
+
+namespace matrix_service {
+
+void RunProcedure(const BatchMulRequest& request, BatchMulResponse& resp)
+{
+    const matrix_op::BatchShape shape{ request.count(), request.rows(), request.inner(), request.columns() };
+    const std::span<const float> first(request.first().data(), request.first_size());
+    const std::span<const float> another(request.another().data(), request.another_size());
+
+    try
+    {
+        // Размеры проверяем до выделения места под результат
+        matrix_op::ValidateBatch(shape, first, another);
+        const std::uint64_t size = std::uint64_t(shape.count) * shape.rows * shape.columns;
+        if (size > std::uint64_t(std::numeric_limits<int>::max())) [[unlikely]]
+            throw matrix_op::MatrixCalcError(std::format("Batch result is too large: {} x ({} x {})", shape.count, shape.rows, shape.columns));
+
+        // Ядро пишет прямо в буфер ответа
+        BatchMulResponse::Result& result = *resp.mutable_result();
+        result.set_count(shape.count);
+        result.set_rows(shape.rows);
+        result.set_columns(shape.columns);
+        result.mutable_content()->Reserve(size);
+        float* data = result.mutable_content()->AddNAlreadyReserved(size);
+        matrix_op::MultiplyBatch(shape, first, another, std::span<float>(data, size));
+    }
+    catch(const matrix_op::MatrixCalcError& e)
+    {
+        *resp.mutable_error() = e.what();
+    }
+
+}
+
+} // namespace matrix_service
@@ -0,0 +1,198 @@
+#include "coalescer.hpp"
+
+#include "matrix_op/storage.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace matrix_service {
+
+namespace {
+
+std::uint64_t OperandHash(matrix_op::MatrixView m)
+{
+    const std::size_t row_bytes = std::size_t(m.Columns()) * sizeof(float);
+    if (m.Stride() == m.Columns())
+        return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(m.Data()), row_bytes * m.Rows()));
+
+    std::uint64_t hash = 0;
+    for (std::uint32_t r = 0; r < m.Rows(); r++)
+        hash = hash * 31 + std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(m[r].data()), row_bytes));
+    return hash;
+}
+
+bool SameContent(matrix_op::MatrixView lhs, matrix_op::MatrixView rhs)
+{
+    if (lhs.Rows() != rhs.Rows() || lhs.Columns() != rhs.Columns())
+        return false;
+    if (lhs.Data() == rhs.Data() && lhs.Stride() == rhs.Stride())
+        return true;
+    for (std::uint32_t r = 0; r < lhs.Rows(); r++)
+    {
+        if (std::memcmp(lhs[r].data(), rhs[r].data(), std::size_t(lhs.Columns()) * sizeof(float)) != 0)
+            return false;
+    }
+    return true;
+}
+
+std::uint32_t OpRows(matrix_op::MatrixView m, matrix_op::Trans trans)
+{
+    return trans == matrix_op::Trans::Yes ? m.Columns() : m.Rows();
+}
+
+std::unique_ptr<MulCoalescer> g_coalescer;
+
+} // namespace
+
+
+MulCoalescer::MulCoalescer(std::chrono::microseconds window)
+    : window_(window)
+{}
+
+std::shared_ptr<MulCoalescer::Group> MulCoalescer::FindGroup(Shard& shard, std::uint64_t hash, matrix_op::MatrixView b,
+                                                             matrix_op::Trans b_trans, std::uint32_t rows)
+{
+    const auto [begin, end] = shard.open.equal_range(hash);
+    for (auto it = begin; it != end; ++it)
+    {
+        Group& group = *it->second;
+        // Сравнение под мьютексом: B группы живет, пока группа не посчитана, а она еще в open
+        if (group.b_trans == b_trans && group.rows + rows <= MaxGroupRows && SameContent(group.b, b))
+            return it->second;
+    }
+    return nullptr;
+}
+
+void MulCoalescer::Multiply(matrix_op::MatrixView a, matrix_op::Trans a_trans,
+                            matrix_op::MatrixView b, matrix_op::Trans b_trans,
+                            matrix_op::MutableMatrixView result)
+{
+    requests_++;
+    const std::uint32_t rows = OpRows(a, a_trans);
+    if (rows >= MaxGroupRows)
+        return matrix_op::Multiply(a, a_trans, b, b_trans, result);
+
+    const std::uint64_t hash = OperandHash(b);
+    Shard& shard = shards_[hash % ShardCount];
+    std::shared_ptr<Group> group;
+    {
+        std::unique_lock lock(shard.mutex);
+        if ((group = FindGroup(shard, hash, b, b_trans, rows)))
+        {
+            // Участник: результат посчитает первый запрос группы
+            group->members.push_back({ a, a_trans, result });
+            group->rows += rows;
+            coalesced_++;
+            if (group->rows >= MaxGroupRows)
+                group->cv.notify_all();
+
+            group->cv.wait(lock, [&group] { return group->done; });
+            if (group->error)
+                std::rethrow_exception(group->error);
+            return;
+        }
+
+        group = std::make_shared<Group>(b, b_trans);
+        group->members.push_back({ a, a_trans, result });
+        group->rows = rows;
+        const auto it = shard.open.emplace(hash, group);
+
+        group->cv.wait_for(lock, window_, [&group] { return group->rows >= MaxGroupRows; });
+        // Окно закрыто: новые участники создадут свою группу
+        shard.open.erase(it);
+    }
+
+    // Группу больше никто не меняет - считаем без мьютекса
+    try
+    {
+        RunGroup(*group);
+    }
+    catch (...)
+    {
+        group->error = std::current_exception();
+    }
+    if (group->members.size() > 1)
+        batches_++;
+
+    {
+        std::lock_guard lock(shard.mutex);
+        group->done = true;
+    }
+    group->cv.notify_all();
+
+    if (group->error)
+        std::rethrow_exception(group->error);
+}
+
+void MulCoalescer::RunGroup(Group& group)
+{
+    if (group.members.size() == 1)
+    {
+        const Member& member = group.members.front();
+        return matrix_op::Multiply(member.a, member.a_trans, group.b, group.b_trans, member.result);
+    }
+
+    const std::uint32_t inner = OpRows(group.b, group.b_trans);
+    const std::uint32_t columns = group.members.front().result.Columns();
+
+    // op(A) участников друг под другом
+    const std::size_t a_stride = matrix_op::LeadingDimension(inner);
+    matrix_op::AlignedBuffer a_buffer(a_stride * group.rows);
+    std::uint32_t offset = 0;
+    for (const Member& member : group.members)
+    {
+        const std::uint32_t rows = member.result.Rows();
+        matrix_op::MutableMatrixView slice(rows, inner, a_stride, a_buffer.Data() + offset * a_stride);
+        if (member.a_trans == matrix_op::Trans::Yes)
+            matrix_op::Transpose(member.a, slice);
+        else
+        {
+            for (std::uint32_t r = 0; r < rows; r++)
+                std::copy(member.a[r].begin(), member.a[r].end(), slice[r].begin());
+        }
+        offset += rows;
+    }
+
+    const std::size_t c_stride = matrix_op::LeadingDimension(columns);
+    matrix_op::AlignedBuffer c_buffer(c_stride * group.rows);
+    matrix_op::Multiply(matrix_op::MatrixView(group.rows, inner, a_stride, a_buffer.Data()), matrix_op::Trans::No,
+                        group.b, group.b_trans,
+                        matrix_op::MutableMatrixView(group.rows, columns, c_stride, c_buffer.Data()));
+
+    // Полосы результата - по ответам
+    offset = 0;
+    for (const Member& member : group.members)
+    {
+        for (std::uint32_t r = 0; r < member.result.Rows(); r++)
+        {
+            const float* row = c_buffer.Data() + (offset + r) * c_stride;
+            std::copy(row, row + columns, member.result[r].begin());
+        }
+        offset += member.result.Rows();
+    }
+}
+
+CoalescingStats MulCoalescer::Stats() const
+{
+    CoalescingStats stats;
+    stats.window_us = window_.count();
+    stats.requests = requests_;
+    stats.coalesced = coalesced_;
+    stats.batches = batches_;
+    return stats;
+}
+
+
+void ConfigureCoalescing(std::chrono::microseconds window)
+{
+    g_coalescer = window.count() > 0 ? std::make_unique<MulCoalescer>(window) : nullptr;
+}
+
+MulCoalescer* ActiveCoalescer()
+{
+    return g_coalescer.get();
+}
+
+} // namespace matrix_service
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "executor/executor.hpp"
+
+#include "matrix_op/matrix.hpp"
+#include "matrix_op/matrix_view.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace matrix_service {
+
+// Объединение одновременных умножений на одну и ту же матрицу B (общая матрица весов у разных клиентов).
+// Первый запрос группы ждет window, присоединившиеся к нему ждут результата; затем op(A) всех участников
+// ставятся друг под другом и считаются одним произведением: B упаковывается и проходит через кэш один раз.
+// Группа ищется по хэшу содержимого B и размерам, совпадение B проверяется целиком, так что коллизия
+// хэша не смешает разные матрицы.
+class MulCoalescer
+{
+public:
+    // Больше строк в общем произведении не собирается: у высоких A выигрыша от объединения нет
+    static constexpr std::uint32_t MaxGroupRows = 4096;
+
+    explicit MulCoalescer(std::chrono::microseconds window);
+    MulCoalescer(const MulCoalescer&) = delete;
+    MulCoalescer& operator=(const MulCoalescer&) = delete;
+
+    // Размеры должны быть проверены (ValidateMulShapes), result не пересекается с аргументами.
+    // Блокирует на время окна и общего умножения; ошибка общего умножения достается всем участникам.
+    void Multiply(matrix_op::MatrixView a, matrix_op::Trans a_trans,
+                  matrix_op::MatrixView b, matrix_op::Trans b_trans,
+                  matrix_op::MutableMatrixView result);
+
+    CoalescingStats Stats() const;
+
+private:
+    struct Member
+    {
+        matrix_op::MatrixView a;
+        matrix_op::Trans a_trans;
+        matrix_op::MutableMatrixView result;
+    };
+
+    struct Group
+    {
+        Group(matrix_op::MatrixView b, matrix_op::Trans b_trans)
+            : b(b), b_trans(b_trans)
+        {}
+
+        matrix_op::MatrixView b;
+        matrix_op::Trans b_trans;
+        std::vector<Member> members;
+        std::uint32_t rows = 0;
+        bool done = false;
+        std::exception_ptr error;
+        std::condition_variable cv;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_multimap<std::uint64_t, std::shared_ptr<Group>> open;
+    };
+
+    static constexpr std::size_t ShardCount = 16;
+
+    // Группа, еще ждущая участников, с тем же B и местом под rows строк, под мьютексом шарда
+    static std::shared_ptr<Group> FindGroup(Shard& shard, std::uint64_t hash, matrix_op::MatrixView b,
+                                            matrix_op::Trans b_trans, std::uint32_t rows);
+    static void RunGroup(Group& group);
+
+private:
+    const std::chrono::microseconds window_;
+    std::array<Shard, ShardCount> shards_;
+
+    std::atomic<std::uint64_t> requests_ = 0;
+    std::atomic<std::uint64_t> coalesced_ = 0;
+    std::atomic<std::uint64_t> batches_ = 0;
+};
+
+// Общий на процесс, меняется только в ConfigureExecutor. window 0 - объединение выключено
+void ConfigureCoalescing(std::chrono::microseconds window);
+// nullptr, если выключено
+MulCoalescer* ActiveCoalescer();
+
+} // namespace matrix_service
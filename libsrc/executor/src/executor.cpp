@@ -1,9 +1,30 @@
 #include "executor/executor.hpp"
+#include "coalescer.hpp"
+#include "matrix_store.hpp"
 #include "procedures.hpp"
+#include "request_cost.hpp"
+#include "request_pool.hpp"
+#include "result_cache.hpp"
+#include "scheduler.hpp"
 
 #include "matrix_service.pb.h"
 
+#include "matrix_op/parallel.hpp"
+
+#include <google/protobuf/arena.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <algorithm>
+#include <chrono>
 #include <cassert>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 #include <tuple>
 #include <utility>
 
@@ -17,6 +38,26 @@ using ProvidedProcedures = std::tuple<
     std::pair<
         matrix_service::MatrixOpRequest, // RequestT
         matrix_service::MatrixOpResponse // ResponseT
+    >,
+    std::pair<
+        matrix_service::MatrixExprRequest,
+        matrix_service::MatrixExprResponse
+    >,
+    std::pair<
+        matrix_service::BatchMulRequest,
+        matrix_service::BatchMulResponse
+    >,
+    std::pair<
+        matrix_service::StoreMatrixRequest,
+        matrix_service::StoreMatrixResponse
+    >,
+    std::pair<
+        matrix_service::ReleaseMatrixRequest,
+        matrix_service::ReleaseMatrixResponse
+    >,
+    std::pair<
+        matrix_service::MappedMulRequest,
+        matrix_service::MappedMulResponse
     >
 >;
 
@@ -41,61 +82,391 @@ static_assert(ValidateProcedures<ProvidedProcedures>(
               ));
 
 
+// Кадр ProcedureData без копирования: payload ссылается на байты запроса
+struct ProcedureFrame
+{
+    int proc_id = 0;
+    std::string_view payload;
+};
+
+// Разбор по правилам protobuf: неизвестные поля пропускаются, повторное поле перекрывает прежнее
+bool ParseProcedureFrame(std::string_view request, ProcedureFrame& frame)
+{
+    using google::protobuf::internal::WireFormatLite;
+    static constexpr std::uint32_t ProcIdTag =
+        WireFormatLite::MakeTag(ProcedureData::kProcIdFieldNumber, WireFormatLite::WIRETYPE_VARINT);
+    static constexpr std::uint32_t PayloadTag =
+        WireFormatLite::MakeTag(ProcedureData::kPayloadFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+
+    google::protobuf::io::CodedInputStream input(reinterpret_cast<const std::uint8_t*>(request.data()), request.size());
+    while (std::uint32_t tag = input.ReadTag())
+    {
+        if (tag == ProcIdTag)
+        {
+            std::uint32_t proc_id = 0;
+            if (!input.ReadVarint32(&proc_id))
+                return false;
+            frame.proc_id = int(proc_id);
+        }
+        else if (tag == PayloadTag)
+        {
+            std::uint32_t size = 0;
+            if (!input.ReadVarint32(&size))
+                return false;
+            const int offset = input.CurrentPosition();
+            if (!input.Skip(size))
+                return false;
+            frame.payload = request.substr(offset, size);
+        }
+        else if (!WireFormatLite::SkipField(&input, tag))
+            return false;
+    }
+    return input.ConsumedEntireMessage();
+}
+
+// Пишет префикс размера и ProcedureData{proc_id, payload} байт в байт как SerializeAsString,
+// payload записывает write_payload(target) -> конец записанного
+template<typename WritePayload>
+void WriteFrame(int proc_id, std::size_t payload_size, std::vector<char>& framed, WritePayload write_payload)
+{
+    using google::protobuf::io::CodedOutputStream;
+    using google::protobuf::internal::WireFormatLite;
+
+    std::size_t size = 0;
+    if (proc_id != 0)
+        size += WireFormatLite::TagSize(ProcedureData::kProcIdFieldNumber, WireFormatLite::TYPE_ENUM) + WireFormatLite::EnumSize(proc_id);
+    if (payload_size != 0)
+        size += WireFormatLite::TagSize(ProcedureData::kPayloadFieldNumber, WireFormatLite::TYPE_BYTES)
+              + CodedOutputStream::VarintSize32(payload_size) + payload_size;
+    if (size > std::size_t(std::numeric_limits<FrameSize>::max())) [[unlikely]]
+        throw ProcedureError(std::format("Response of {} bytes does not fit into a frame", size));
+
+    // resize не освобождает память: буфер ответа переиспользуется между запросами
+    framed.resize(sizeof(FrameSize) + size);
+    const FrameSize frame_size = size;
+    std::memcpy(framed.data(), &frame_size, sizeof(frame_size));
+
+    std::uint8_t* target = reinterpret_cast<std::uint8_t*>(framed.data() + sizeof(FrameSize));
+    if (proc_id != 0)
+        target = WireFormatLite::WriteEnumToArray(ProcedureData::kProcIdFieldNumber, proc_id, target);
+    if (payload_size != 0)
+    {
+        target = WireFormatLite::WriteTagToArray(ProcedureData::kPayloadFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED, target);
+        target = CodedOutputStream::WriteVarint32ToArray(payload_size, target);
+        target = write_payload(target);
+    }
+    assert(target == reinterpret_cast<std::uint8_t*>(framed.data() + framed.size()));
+}
+
+
+// Арена потока для запроса и ответа. Начальный блок переживает запросы и подрастает
+// под самый большой из них, поэтому в установившемся режиме разбор и ответ не идут в кучу.
+class ThreadArena
+{
+public:
+    google::protobuf::Arena& Get()
+    {
+        if (!arena_)
+        {
+            if (!block_)
+                block_ = std::make_unique_for_overwrite<char[]>(block_size_);
+            google::protobuf::ArenaOptions options;
+            options.initial_block = block_.get();
+            options.initial_block_size = block_size_;
+            arena_.emplace(options);
+        }
+        return *arena_;
+    }
+
+    // Освобождает сообщения последнего запроса
+    void Reset()
+    {
+        if (!arena_)
+            return;
+        const std::size_t used = arena_->SpaceAllocated();
+        if (used <= block_size_ || used > MaxBlockSize)
+        {
+            arena_->Reset();
+            return;
+        }
+        // Блока не хватило: следующая арена начнется с блока, вместившего бы этот запрос целиком
+        arena_.reset();
+        block_size_ = used;
+        block_.reset();
+    }
+
+private:
+    static constexpr std::size_t StartBlockSize = 64 * 1024;
+    // Больше не держим за потоком между запросами
+    static constexpr std::size_t MaxBlockSize = 64 * 1024 * 1024;
+
+    std::size_t block_size_ = StartBlockSize;
+    std::unique_ptr<char[]> block_;
+    std::optional<google::protobuf::Arena> arena_; // Объявлена после block_: разрушается раньше
+};
+
+// Освобождает ресурсы запроса при любом выходе из него, в том числе по исключению не ProcedureError
+class RequestScope
+{
+public:
+    explicit RequestScope(ThreadArena& arena) : arena_(arena) {}
+    RequestScope(const RequestScope&) = delete;
+    RequestScope& operator=(const RequestScope&) = delete;
+
+    ~RequestScope()
+    {
+        arena_.Reset();
+        ReleasePinnedMatrices();
+    }
+
+private:
+    ThreadArena& arena_;
+};
+
+
 // Исполнение процедур
 template<std::size_t Idx>
-bool TryRunProcedure(const ProcedureData& request, std::string& response)
+bool TryRunProcedure(ProcedureFrame request, google::protobuf::Arena& arena, std::vector<char>& framed_response)
 {
-    if (request.proc_id() != Idx)
+    if (request.proc_id != Idx)
         return false;
 
     using RequestT = typename std::tuple_element_t<Idx, ProvidedProcedures>::first_type;
-    RequestT request_proto;
-    if (!request_proto.ParseFromArray(request.payload().data(), request.payload().size())) [[unlikely]]
+    using ResponseT = typename std::tuple_element_t<Idx, ProvidedProcedures>::second_type;
+    RequestT* request_proto = google::protobuf::Arena::CreateMessage<RequestT>(&arena);
+    if (!request_proto->ParseFromArray(request.payload.data(), request.payload.size())) [[unlikely]]
         throw ProcedureError(std::format("Corrupted protobuf for procedure request with id {}!", Idx));
 
-    static_assert(std::is_same_v<decltype(RunProcedure(request_proto)),
-                                 typename std::tuple_element_t<Idx, ProvidedProcedures>::second_type>);
-    auto response_proto = RunProcedure(request_proto);
-    response = response_proto.SerializeAsString();
+    ResponseT* response_proto = google::protobuf::Arena::CreateMessage<ResponseT>(&arena);
+    RunProcedure(*request_proto, *response_proto);
 
+    WriteFrame(Idx, response_proto->ByteSizeLong(), framed_response, [&](std::uint8_t* target)
+    {
+        return response_proto->SerializeWithCachedSizesToArray(target);
+    });
     return true;
 }
 
-} // namespace
+// Пересоздается только в ConfigureExecutor, до начала обработки запросов
+std::unique_ptr<ResultCache> g_result_cache;
 
+struct RequestPoolState
+{
+    std::mutex mutex;
+    std::shared_ptr<RequestPool> pool;
+};
 
-std::pair<std::string, bool> ExecuteProcedure(std::string_view request)
+RequestPoolState& PoolState()
+{
+    static RequestPoolState state;
+    return state;
+}
+
+std::shared_ptr<RequestPool> SharedRequestPool()
+{
+    auto& state = PoolState();
+    std::lock_guard lock(state.mutex);
+    if (!state.pool)
+        state.pool = std::make_shared<RequestPool>(std::max(1u, std::thread::hardware_concurrency()));
+    return state.pool;
+}
+
+void SetRequestThreads(std::uint32_t threads, bool pin)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto& state = PoolState();
+    std::shared_ptr<RequestPool> old_pool;
+    {
+        std::lock_guard lock(state.mutex);
+        if (state.pool && state.pool->Threads() == threads && state.pool->Pinned() == pin)
+            return;
+        // Старый пул доработает поставленные запросы при разрушении, уже вне мьютекса
+        old_pool = std::exchange(state.pool, std::make_shared<RequestPool>(threads, pin));
+    }
+}
+
+bool ExecuteUncached(std::string_view request, std::vector<char>& framed_response)
 {
-    ProcedureData response_proto;
+    thread_local ThreadArena thread_arena;
+    const RequestScope scope(thread_arena);
 
+    bool succeeded = true;
     try
     {
-        ProcedureData request_proto;
-        if (!request_proto.ParseFromArray(request.data(), request.size())) [[unlikely]]
+        ProcedureFrame request_frame;
+        if (!ParseProcedureFrame(request, request_frame)) [[unlikely]]
             throw ProcedureError("Corrupted matrix_service::Procedure protobuf!");
 
-        std::string response;
         auto try_run_procedures =
-            []<std::size_t... Ids>(const ProcedureData& request_proto, std::string& response, std::integer_sequence<std::size_t, Ids...>)
+            []<std::size_t... Ids>(ProcedureFrame request_frame, google::protobuf::Arena& arena,
+                                   std::vector<char>& framed_response, std::integer_sequence<std::size_t, Ids...>)
             {
-                bool was_executed = ( false || ... || TryRunProcedure<Ids + 1>(request_proto, response) );
+                bool was_executed = ( false || ... || TryRunProcedure<Ids + 1>(request_frame, arena, framed_response) );
                 if (!was_executed) [[unlikely]]
-                    throw ProcedureError(std::format("Unknown ProcedureId: {}", (int) request_proto.proc_id()));
+                    throw ProcedureError(std::format("Unknown ProcedureId: {}", request_frame.proc_id));
             };
 
-        try_run_procedures(request_proto, response,
+        try_run_procedures(request_frame, thread_arena.Get(), framed_response,
                            std::make_integer_sequence<std::size_t, std::tuple_size_v<ProvidedProcedures> - 1>());
-
-        response_proto.set_proc_id(request_proto.proc_id());
-        *response_proto.mutable_payload() = response;
-        return { response_proto.SerializeAsString(), true };
     }
     catch (const ProcedureError& e)
     {
-        response_proto.set_proc_id(ProcedureData::ProcedureId::ProcedureData_ProcedureId_INVALID);
-        *response_proto.mutable_payload() = e.what();
-        return { response_proto.SerializeAsString(), false };
+        const std::string_view error = e.what();
+        WriteFrame(ProcedureData::ProcedureId::ProcedureData_ProcedureId_INVALID, error.size(), framed_response,
+                   [&](std::uint8_t* target) { return std::copy(error.begin(), error.end(), target); });
+        succeeded = false;
     }
+    return succeeded;
+}
+
+// Операции с хранилищем и файлами меняют состояние сервера, повторять их ответ нельзя.
+// Запросы с handle тоже не кэшируются: после RELEASE_MATRIX или вытеснения они должны получать error,
+// а исполнение поднимает их матрицы в LRU хранилища
+bool Cacheable(std::string_view request)
+{
+    ProcedureFrame frame;
+    return ParseProcedureFrame(request, frame)
+           && frame.proc_id != ProcedureData::STORE_MATRIX && frame.proc_id != ProcedureData::RELEASE_MATRIX
+           && frame.proc_id != ProcedureData::MAPPED_MUL
+           && !ReferencesStoredMatrix(frame.proc_id, frame.payload);
+}
+
+// Исполнение с записью успешного ответа в кэш (если он включен)
+bool ExecuteAndCache(std::string_view request, std::vector<char>& framed_response)
+{
+    const bool succeeded = ExecuteUncached(request, framed_response);
+    // Ошибки протокола не кэшируются: такие запросы дешевы и не должны вытеснять полезные ответы
+    if (g_result_cache && succeeded && Cacheable(request))
+        g_result_cache->Insert(request, std::string_view(framed_response.data(), framed_response.size()));
+    return succeeded;
+}
+
+// Пересоздается только в ConfigureExecutor; shared_ptr - асинхронные запросы держат его до завершения
+std::shared_ptr<RequestScheduler> g_scheduler;
+
+std::uint64_t EstimateCost(std::string_view request)
+{
+    ProcedureFrame frame;
+    return ParseProcedureFrame(request, frame) ? RequestCost(frame.proc_id, frame.payload) : 0;
+}
+
+// Исключения здесь некому принять, как синхронному вызывающему: ответа просто нет
+void ExecuteAsync(AsyncProcedure& procedure)
+{
+    try
+    {
+        const std::string_view request(procedure.request.data() + procedure.request_offset,
+                                       procedure.request.size() - procedure.request_offset);
+        procedure.succeeded = ExecuteAndCache(request, procedure.framed_response);
+    }
+    catch (...)
+    {
+        procedure.framed_response.clear();
+        procedure.succeeded = false;
+    }
+}
+
+} // namespace
+
+
+void ConfigureExecutor(const ExecutorConfig& conf)
+{
+    matrix_op::SetParallelism(conf.compute_threads);
+    matrix_op::SetParallelThreshold(conf.parallel_threshold);
+    g_result_cache = conf.result_cache_bytes ? std::make_unique<ResultCache>(conf.result_cache_bytes) : nullptr;
+    SetRequestThreads(conf.request_threads, conf.pin_request_threads);
+    ConfigureCoalescing(std::chrono::microseconds(conf.coalesce_window_us));
+    ConfigureMatrixStore(conf.matrix_store_bytes);
+    SetMappedMatrixDir(conf.mapped_matrix_dir);
+
+    g_scheduler.reset();
+    if (conf.small_request_slots || conf.large_request_slots)
+    {
+        g_scheduler = std::make_shared<RequestScheduler>(RequestScheduler::Config{
+            conf.small_request_cost,
+            conf.small_request_slots,
+            conf.large_request_slots,
+            std::chrono::milliseconds(conf.request_aging_ms),
+        });
+    }
+}
+
+bool ExecuteProcedure(std::string_view request, std::vector<char>& framed_response)
+{
+    if (g_result_cache && g_result_cache->Find(request, framed_response))
+        return true;
+
+    // Место у планировщика нужно только для исполнения: попадания в кэш его не ждут
+    std::optional<ScheduledSlot> slot;
+    if (g_scheduler)
+        slot.emplace(*g_scheduler, EstimateCost(request));
+    return ExecuteAndCache(request, framed_response);
+}
+
+std::pair<std::string, bool> ExecuteProcedure(std::string_view request)
+{
+    std::vector<char> framed_response;
+    const bool succeeded = ExecuteProcedure(request, framed_response);
+    return { std::string(framed_response.begin() + sizeof(FrameSize), framed_response.end()), succeeded };
+}
+
+void SubmitProcedure(AsyncProcedure procedure, ProcedureCompletion completion)
+{
+    // Задачи не держат пул: последняя ссылка не должна освобождаться в его же потоке
+    SharedRequestPool()->Post([scheduler = g_scheduler, procedure = std::move(procedure), completion = std::move(completion)]() mutable
+    {
+        const std::string_view request(procedure.request.data() + procedure.request_offset,
+                                       procedure.request.size() - procedure.request_offset);
+        if (g_result_cache && g_result_cache->Find(request, procedure.framed_response))
+        {
+            procedure.succeeded = true;
+            completion(std::move(procedure));
+            return;
+        }
+        if (!scheduler)
+        {
+            ExecuteAsync(procedure);
+            completion(std::move(procedure));
+            return;
+        }
+
+        // Поток пула не ждет места: исполнение ставится в пул заново, когда планировщик его допустит
+        const std::uint64_t cost = EstimateCost(request);
+        scheduler->Schedule(cost, [scheduler, procedure = std::move(procedure), completion = std::move(completion)]
+                                  (RequestScheduler::Lane lane) mutable
+        {
+            SharedRequestPool()->Post([scheduler, lane, procedure = std::move(procedure), completion = std::move(completion)]() mutable
+            {
+                ExecuteAsync(procedure);
+                scheduler->Release(lane);
+                completion(std::move(procedure));
+            });
+        });
+    });
+}
+
+ResultCacheStats GetResultCacheStats()
+{
+    return g_result_cache ? g_result_cache->Stats() : ResultCacheStats{};
+}
+
+CoalescingStats GetCoalescingStats()
+{
+    const MulCoalescer* coalescer = ActiveCoalescer();
+    return coalescer ? coalescer->Stats() : CoalescingStats{};
+}
+
+SchedulerStats GetSchedulerStats()
+{
+    return g_scheduler ? g_scheduler->Stats() : SchedulerStats{};
+}
+
+MatrixStoreStats GetMatrixStoreStats()
+{
+    const MatrixStore* store = ActiveMatrixStore();
+    return store ? store->Stats() : MatrixStoreStats{};
 }
 
 } // namespace matrix_service
@@ -0,0 +1,76 @@
+#include "procedures.hpp"
+
+#include "matrix_op/mapped.hpp"
+#include "matrix_op/matrix.hpp"
+#include "matrix_op/matrix_exception.hpp"
+
+#include <filesystem>
+#include <format>
+#include <utility>
+
+namespace matrix_service {
+
+namespace {
+
+std::string g_mapped_matrix_dir;
+
+// Путь запроса внутри каталога: абсолютные пути и ".." - ошибка формата запроса.
+// Символические ссылки и прочие выходы из каталога отвергает уже открытие (root в MappedMatrix)
+const std::string& CheckPath(const std::string& relative)
+{
+    const std::filesystem::path path(relative);
+    if (relative.empty() || !path.is_relative()) [[unlikely]]
+        throw ProcedureError(std::format("Matrix file path must be relative: '{}'", relative));
+    for (const auto& part : path)
+    {
+        if (part == "..") [[unlikely]]
+            throw ProcedureError(std::format("Matrix file path must not leave the directory: '{}'", relative));
+    }
+    return relative;
+}
+
+} // namespace
+
+
+void SetMappedMatrixDir(std::string dir)
+{
+    g_mapped_matrix_dir = std::move(dir);
+}
+
+void RunProcedure(const MappedMulRequest& request, MappedMulResponse& resp)
+{
+    const std::string& first_path = CheckPath(request.first());
+    const std::string& another_path = CheckPath(request.another());
+    const std::string& result_path = CheckPath(request.result());
+
+    try
+    {
+        if (g_mapped_matrix_dir.empty()) [[unlikely]]
+            throw matrix_op::MatrixCalcError("Mapped matrices are disabled");
+
+        const matrix_op::MappedMatrix first = matrix_op::MappedMatrix::Open(first_path, g_mapped_matrix_dir);
+        const matrix_op::MappedMatrix another = matrix_op::MappedMatrix::Open(another_path, g_mapped_matrix_dir);
+        // Размеры проверяем до создания файла результата
+        matrix_op::ValidateMulShapes(first.View(), another.View());
+        matrix_op::MappedMatrix result =
+            matrix_op::MappedMatrix::Create(result_path, first.Rows(), another.Columns(), g_mapped_matrix_dir);
+        if (result.Replaces(first) || result.Replaces(another)) [[unlikely]]
+            throw matrix_op::MatrixCalcError(std::format("Result file '{}' must differ from the arguments", request.result()));
+
+        matrix_op::OutOfCoreOptions options;
+        if (request.working_set_bytes() != 0)
+            options.working_set_bytes = request.working_set_bytes();
+        matrix_op::MultiplyOutOfCore(first, another, result, options);
+        // Готовый результат заменяет файл целиком: параллельные чтения видят старый или новый
+        result.Commit();
+
+        resp.mutable_result()->set_rows(result.Rows());
+        resp.mutable_result()->set_columns(result.Columns());
+    }
+    catch (const matrix_op::MatrixCalcError& e)
+    {
+        *resp.mutable_error() = e.what();
+    }
+}
+
+} // namespace matrix_service
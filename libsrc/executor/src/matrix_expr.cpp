@@ -0,0 +1,134 @@
+#include "procedures.hpp"
+#include "proto_matrix.hpp"
+
+#include "matrix_op/chain.hpp"
+#include "matrix_op/matrix.hpp"
+#include "matrix_op/matrix_exception.hpp"
+#include "matrix_op/storage.hpp"
+
+#include <format>
+#include <vector>
+
+namespace matrix_service {
+
+namespace {
+
+// Значение операнда DAG: view на вход из протобуфа или на промежуточный буфер
+struct Operand
+{
+    matrix_op::MatrixView view;
+    matrix_op::AlignedBuffer buffer; // Пуст для входных матриц
+};
+
+// Порядок цепочки узла считается за O(n^3) по памяти O(n^2) и обходится рекурсией глубины n
+constexpr int MaxNodeArgs = 64;
+
+// Проверка структуры DAG - это ошибки формата запроса, а не вычисления
+void ValidateNodes(const MatrixExprRequest& request)
+{
+    if (request.nodes().empty()) [[unlikely]]
+        throw ProcedureError("MatrixExprRequest without nodes");
+
+    const std::uint32_t inputs = request.inputs_size();
+    for (int i = 0; i < request.nodes_size(); i++)
+    {
+        const auto& node = request.nodes()[i];
+        if (node.op() != MatrixOpRequest::MUL) [[unlikely]]
+            throw ProcedureError(std::format("Unsupported operation in node {}: {}", i, (int) node.op()));
+        if (node.args_size() < 2 || node.args_size() > MaxNodeArgs) [[unlikely]]
+            throw ProcedureError(std::format("Invalid count of args in node {}: {}", i, node.args_size()));
+
+        for (std::uint32_t arg : node.args())
+        {
+            if (arg >= inputs + i) [[unlikely]]
+                throw ProcedureError(std::format("Node {} refers to unknown operand {}", i, arg));
+        }
+    }
+}
+
+} // namespace
+
+
+void RunProcedure(const MatrixExprRequest& request, MatrixExprResponse& resp)
+{
+    ValidateNodes(request);
+
+    std::vector<Operand> operands;
+    operands.reserve(request.inputs_size() + request.nodes_size());
+
+    // Сколько раз на операнд еще сошлются - чтобы вовремя освобождать промежуточные
+    std::vector<std::uint32_t> uses_left(request.inputs_size() + request.nodes_size(), 0);
+    for (const auto& node : request.nodes())
+    {
+        for (std::uint32_t arg : node.args())
+            uses_left[arg]++;
+    }
+
+    matrix_op::MulOptions options;
+    if (request.algorithm() == MatrixOpRequest::STRASSEN)
+        options.algorithm = matrix_op::MulAlgorithm::Strassen;
+
+    try
+    {
+        // Входы - прямо из протобуфа (или из хранилища: вытесненный handle - ошибка в ответе)
+        for (const auto& input : request.inputs())
+            operands.push_back({ ViewFromProto(input), {} });
+
+        // Буферы промежуточных результатов переиспользуются и внутри цепочек, и между узлами
+        matrix_op::BufferPool pool;
+        std::vector<matrix_op::MatrixView> factors;
+        std::vector<std::uint32_t> dims;
+
+        for (int i = 0; i < request.nodes_size(); i++)
+        {
+            const auto& node = request.nodes()[i];
+
+            factors.clear();
+            dims.clear();
+            for (std::uint32_t arg : node.args())
+                factors.push_back(operands[arg].view);
+            // Размеры проверяем до выделения буферов: под результат узла и промежуточные внутри цепочки
+            dims.push_back(factors.front().Rows());
+            for (std::size_t f = 0; f < factors.size(); f++)
+            {
+                if (f > 0)
+                    matrix_op::ValidateMulShapes(factors[f - 1], factors[f]);
+                dims.push_back(factors[f].Columns());
+            }
+            const auto [largest_rows, largest_columns] = matrix_op::LargestChainIntermediate(dims);
+            ValidateResultSize(largest_rows, largest_columns);
+
+            const std::uint32_t rows = factors.front().Rows();
+            const std::uint32_t columns = factors.back().Columns();
+
+            if (i + 1 == request.nodes_size())
+            {
+                // Итоговый узел пишется сразу в ответ
+                matrix_op::MultiplyChain(factors, ResultToProto(rows, columns, *resp.mutable_result()), options, pool);
+                break;
+            }
+
+            ValidateResultSize(rows, columns);
+            const std::size_t stride = matrix_op::LeadingDimension(columns);
+            matrix_op::AlignedBuffer buffer = pool.Acquire(stride * rows);
+            matrix_op::MutableMatrixView value(rows, columns, stride, buffer.Data());
+            matrix_op::MultiplyChain(factors, value, options, pool);
+
+            // Узел больше никому не нужен - его буфер можно отдать следующим
+            for (std::uint32_t arg : node.args())
+            {
+                if (--uses_left[arg] == 0)
+                    pool.Release(std::move(operands[arg].buffer));
+            }
+
+            operands.push_back({ value, std::move(buffer) });
+        }
+    }
+    catch (const matrix_op::MatrixCalcError& e)
+    {
+        *resp.mutable_error() = e.what();
+    }
+
+}
+
+} // namespace matrix_service
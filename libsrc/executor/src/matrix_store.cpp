@@ -0,0 +1,117 @@
+#include "matrix_store.hpp"
+
+#include "matrix_op/matrix_exception.hpp"
+
+#include <algorithm>
+#include <format>
+#include <vector>
+
+namespace matrix_service {
+
+StoredMatrix::StoredMatrix(matrix_op::MatrixView view)
+    : rows(view.Rows()),
+      columns(view.Columns()),
+      stride(matrix_op::LeadingDimension(columns)),
+      data(stride * rows),
+      packed(view)
+{
+    for (std::uint32_t r = 0; r < rows; r++)
+        std::copy(view[r].begin(), view[r].end(), data.Data() + r * stride);
+}
+
+
+MatrixStore::MatrixStore(std::size_t budget_bytes)
+    : budget_(budget_bytes)
+{}
+
+std::uint64_t MatrixStore::Put(matrix_op::MatrixView matrix)
+{
+    // Копия и упаковка - вне мьютекса
+    auto stored = std::make_shared<const StoredMatrix>(matrix);
+    const std::size_t bytes = stored->Bytes();
+    if (bytes > budget_) [[unlikely]]
+        throw matrix_op::MatrixCalcError(std::format("Matrix {} x {} needs {} bytes, store limit is {}",
+                                                     matrix.Rows(), matrix.Columns(), bytes, budget_));
+
+    std::lock_guard lock(mutex_);
+    while (bytes_ + bytes > budget_)
+    {
+        Erase(std::prev(lru_.end()));
+        evictions_++;
+    }
+
+    const std::uint64_t handle = next_handle_++;
+    lru_.push_front({ handle, std::move(stored) });
+    index_.emplace(handle, lru_.begin());
+    bytes_ += bytes;
+    return handle;
+}
+
+std::shared_ptr<const StoredMatrix> MatrixStore::Find(std::uint64_t handle)
+{
+    std::lock_guard lock(mutex_);
+    const auto it = index_.find(handle);
+    if (it == index_.end())
+        return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->matrix;
+}
+
+bool MatrixStore::Release(std::uint64_t handle)
+{
+    std::lock_guard lock(mutex_);
+    const auto it = index_.find(handle);
+    if (it == index_.end())
+        return false;
+    Erase(it->second);
+    return true;
+}
+
+MatrixStoreStats MatrixStore::Stats() const
+{
+    std::lock_guard lock(mutex_);
+    return { lru_.size(), bytes_, evictions_ };
+}
+
+void MatrixStore::Erase(std::list<Entry>::iterator it)
+{
+    bytes_ -= it->matrix->Bytes();
+    index_.erase(it->handle);
+    lru_.erase(it);
+}
+
+
+namespace {
+
+// Пересоздается только в ConfigureExecutor, до начала обработки запросов
+std::unique_ptr<MatrixStore> g_matrix_store;
+
+// Матрицы, на которые ссылается исполняемый в потоке запрос
+thread_local std::vector<std::shared_ptr<const StoredMatrix>> t_pinned;
+
+} // namespace
+
+void ConfigureMatrixStore(std::size_t budget_bytes)
+{
+    g_matrix_store = budget_bytes ? std::make_unique<MatrixStore>(budget_bytes) : nullptr;
+}
+
+MatrixStore* ActiveMatrixStore()
+{
+    return g_matrix_store.get();
+}
+
+const StoredMatrix& PinStoredMatrix(std::uint64_t handle)
+{
+    std::shared_ptr<const StoredMatrix> stored = g_matrix_store ? g_matrix_store->Find(handle) : nullptr;
+    if (!stored) [[unlikely]]
+        throw matrix_op::MatrixCalcError(std::format("Unknown or evicted matrix handle: {}", handle));
+    return *t_pinned.emplace_back(std::move(stored));
+}
+
+void ReleasePinnedMatrices()
+{
+    t_pinned.clear();
+}
+
+} // namespace matrix_service
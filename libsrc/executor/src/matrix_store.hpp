@@ -0,0 +1,82 @@
+#pragma once
+
+#include "executor/executor.hpp"
+
+#include "matrix_op/matrix_view.hpp"
+#include "matrix_op/packed.hpp"
+#include "matrix_op/storage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace matrix_service {
+
+// Матрица, загруженная клиентом один раз для многих запросов
+struct StoredMatrix
+{
+    explicit StoredMatrix(matrix_op::MatrixView view);
+
+    // Как есть: левый аргумент, транспонирование, выражения
+    matrix_op::MatrixView View() const { return matrix_op::MatrixView(rows, columns, stride, data.Data()); }
+    std::size_t Bytes() const { return data.Size() * sizeof(float) + packed.Bytes(); }
+
+    std::uint32_t rows;
+    std::uint32_t columns;
+    std::size_t stride;
+    matrix_op::AlignedBuffer data;
+    matrix_op::PackedMatrix packed; // Панели микроядра для правого аргумента без транспонирования
+};
+
+// Хранилище матриц по handle с лимитом памяти: при превышении вытесняются давно не использованные.
+// Запросы получают shared_ptr, так что вытеснение или Release во время вычисления безопасны.
+// Handle не переиспользуются: содержимое под handle не меняется, пока он жив.
+class MatrixStore
+{
+public:
+    explicit MatrixStore(std::size_t budget_bytes);
+    MatrixStore(const MatrixStore&) = delete;
+    MatrixStore& operator=(const MatrixStore&) = delete;
+
+    // MatrixCalcError, если матрица одна больше лимита
+    std::uint64_t Put(matrix_op::MatrixView matrix);
+    // nullptr, если handle неизвестен или вытеснен. Найденная становится недавно использованной
+    std::shared_ptr<const StoredMatrix> Find(std::uint64_t handle);
+    bool Release(std::uint64_t handle);
+
+    MatrixStoreStats Stats() const;
+
+private:
+    struct Entry
+    {
+        std::uint64_t handle;
+        std::shared_ptr<const StoredMatrix> matrix;
+    };
+
+    void Erase(std::list<Entry>::iterator it);
+
+private:
+    const std::size_t budget_;
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // Спереди - недавно использованные
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index_;
+    std::size_t bytes_ = 0;
+    std::uint64_t next_handle_ = 1;
+    std::uint64_t evictions_ = 0;
+};
+
+// Общее на процесс, пересоздается (с потерей матриц) только в ConfigureExecutor. 0 - хранилище выключено
+void ConfigureMatrixStore(std::size_t budget_bytes);
+// nullptr, если выключено
+MatrixStore* ActiveMatrixStore();
+
+// Матрица по handle для текущего запроса: закрепляется в потоке до ReleasePinnedMatrices().
+// MatrixCalcError, если handle неизвестен или вытеснен - клиенту нужно загрузить матрицу заново
+const StoredMatrix& PinStoredMatrix(std::uint64_t handle);
+// Вызывается по завершении запроса
+void ReleasePinnedMatrices();
+
+} // namespace matrix_service
@@ -1,51 +1,282 @@
+#include "coalescer.hpp"
+#include "matrix_store.hpp"
 #include "procedures.hpp"
+#include "proto_matrix.hpp"
 
 #include "matrix_op/matrix.hpp"
 #include "matrix_op/matrix_exception.hpp"
+#include "matrix_op/packed.hpp"
+#include "matrix_op/sparse.hpp"
+#include "matrix_op/storage.hpp"
 
+#include <algorithm>
 #include <format>
+#include <type_traits>
 
 namespace matrix_service {
 
 namespace {
 
-matrix_op::Matrix FromProto(const Matrix& m)
+matrix_op::Trans ArgTrans(const MatrixOpRequest& request, int idx)
 {
-    if (m.content().size() != (int) (m.rows() * m.columns())) [[unlikely]]
-        throw ProcedureError(std::format("Invalid matrix content size: {} != {} x {}", m.content_size(), m.rows(), m.columns()));
+    return !request.transpose().empty() && request.transpose()[idx] ? matrix_op::Trans::Yes : matrix_op::Trans::No;
+}
+
+// Элементы представления без параметров квантования - для проверки размеров
+template<typename T>
+matrix_op::BasicMatrixView<T> Values(matrix_op::BasicMatrixView<T> view) { return view; }
+matrix_op::BasicMatrixView<std::int8_t> Values(matrix_op::QuantizedMatrixView view) { return view.values; }
+
+// Результат rows x columns в ответ: в FP32 compute пишет прямо в буфер ответа,
+// в остальных кодировках - во временный fp32-буфер, который затем кодируется
+template<typename ComputeT>
+void ComputeToProto(std::uint32_t rows, std::uint32_t columns, Matrix::Encoding encoding, Matrix& result, ComputeT compute)
+{
+    if (encoding == Matrix::FP32)
+        return compute(ResultToProto(rows, columns, result));
+
+    ValidateResultSize(rows, columns);
+    const std::size_t stride = matrix_op::LeadingDimension(columns);
+    matrix_op::AlignedBuffer buffer(stride * rows);
+    matrix_op::MutableMatrixView value(rows, columns, stride, buffer.Data());
+    compute(value);
+    EncodeToProto(value, encoding, result);
+}
+
+// Эпилог запроса для результата rows x columns (addend - только проверяется)
+matrix_op::Epilogue EpilogueFromProto(const MatrixOpRequest::Epilogue& epilogue, std::uint32_t rows, std::uint32_t columns)
+{
+    matrix_op::Epilogue result;
+    result.alpha = epilogue.has_alpha() ? epilogue.alpha() : 1.f;
+    result.beta = epilogue.beta();
+    result.activation = epilogue.activation() == MatrixOpRequest::RELU ? matrix_op::Activation::Relu
+                                                                        : matrix_op::Activation::None;
+
+    if (!epilogue.bias().empty())
+    {
+        if (std::uint32_t(epilogue.bias_size()) != columns) [[unlikely]]
+            throw matrix_op::MatrixCalcError(std::format("Invalid bias size: {} != {} columns", epilogue.bias_size(), columns));
+        result.bias = epilogue.bias().data();
+    }
 
-    return matrix_op::Matrix(m.rows(), m.columns(), m.content().data(), m.content().data() + m.content().size());
+    if (result.beta != 0)
+    {
+        if (!epilogue.has_addend()) [[unlikely]]
+            throw ProcedureError("Epilogue with beta requires an addend");
+        const matrix_op::MatrixView addend = ViewFromProto(epilogue.addend());
+        if (addend.Rows() != rows || addend.Columns() != columns) [[unlikely]]
+        {
+            throw matrix_op::MatrixCalcError(std::format("Invalid addend shape: ({} x {}) != ({} x {})",
+                                                         addend.Rows(), addend.Columns(), rows, columns));
+        }
+    }
+
+    return result;
+}
+
+// op(first) * op(another) с эпилогом в ответ.
+// options.algorithm - только для FP32, остальные форматы считаются блочным алгоритмом.
+// packed_another - та же another, заранее упакованная (матрица из хранилища без транспонирования)
+template<typename ViewT>
+void MultiplyToProto(ViewT first, matrix_op::Trans first_trans, ViewT another, matrix_op::Trans another_trans,
+                     const MatrixOpRequest& request, Matrix& result, matrix_op::MulOptions options = {},
+                     const matrix_op::PackedMatrix* packed_another = nullptr)
+{
+    // Размеры проверяем до выделения буфера под результат
+    const auto first_values = Values(first);
+    const auto another_values = Values(another);
+    matrix_op::ValidateMulShapes(first_values, first_trans, another_values, another_trans);
+    const std::uint32_t rows = first_trans == matrix_op::Trans::Yes ? first_values.Columns() : first_values.Rows();
+    const std::uint32_t columns = another_trans == matrix_op::Trans::Yes ? another_values.Rows() : another_values.Columns();
+    options.epilogue = EpilogueFromProto(request.epilogue(), rows, columns);
+
+    ComputeToProto(rows, columns, request.result_encoding(), result, [&](matrix_op::MutableMatrixView value)
+    {
+        // beta * addend ядро читает из результата
+        if (options.epilogue.beta != 0)
+        {
+            const matrix_op::MatrixView addend = ViewFromProto(request.epilogue().addend());
+            for (std::uint32_t r = 0; r < rows; r++)
+                std::copy(addend[r].begin(), addend[r].end(), value[r].begin());
+        }
+        if constexpr (std::is_same_v<ViewT, matrix_op::MatrixView>)
+        {
+            // B уже упакована: объединять с другими запросами незачем
+            if (packed_another && options.algorithm == matrix_op::MulAlgorithm::Classic)
+                return matrix_op::Multiply(first, first_trans, *packed_another, value, options);
+            MulCoalescer* coalescer = ActiveCoalescer();
+            if (coalescer && options.epilogue.Trivial() && options.algorithm == matrix_op::MulAlgorithm::Classic)
+                return coalescer->Multiply(first, first_trans, another, another_trans, value);
+        }
+        matrix_op::Multiply(first, first_trans, another, another_trans, value, options);
+    });
+}
+
+// Транспонированный разреженный аргумент - те же массивы в другом формате.
+// Размеры ограничены до умножения: из них ядра берут и размеры результата
+matrix_op::SparseMatrixView SparseArg(const Matrix& m, matrix_op::Trans trans)
+{
+    const matrix_op::SparseMatrixView view = SparseViewFromProto(m);
+    ValidateSparseSize(view);
+    return trans == matrix_op::Trans::Yes ? view.Transposed() : view;
+}
+
+// Плотный аргумент при разреженном: ядра читают его по строкам, так что транспонированный копируется
+matrix_op::MatrixView DenseArg(const Matrix& m, matrix_op::Trans trans, matrix_op::AlignedBuffer& storage)
+{
+    const matrix_op::MatrixView view = ViewFromProto(m);
+    if (trans == matrix_op::Trans::No)
+        return view;
+
+    const std::size_t stride = matrix_op::LeadingDimension(view.Rows());
+    storage = matrix_op::AlignedBuffer(stride * view.Columns());
+    matrix_op::MutableMatrixView transposed(view.Columns(), view.Rows(), stride, storage.Data());
+    matrix_op::Transpose(view, transposed);
+    return transposed;
+}
+
+// Умножение с разреженным аргументом: ядро выбирается по кодировкам аргументов
+void MultiplySparseToProto(const MatrixOpRequest& request, Matrix& result)
+{
+    const Matrix& first = request.args()[0];
+    const Matrix& another = request.args()[1];
+    const matrix_op::Trans t1 = ArgTrans(request, 0);
+    const matrix_op::Trans t2 = ArgTrans(request, 1);
+    const Matrix::Encoding encoding = request.result_encoding();
+
+    if (IsSparse(first.encoding()) && IsSparse(another.encoding()))
+    {
+        const matrix_op::SparseMatrix product = matrix_op::Multiply(SparseArg(first, t1), SparseArg(another, t2));
+        if (IsSparse(encoding))
+        {
+            const matrix_op::SparseLayout layout = encoding == Matrix::CSR ? matrix_op::SparseLayout::Csr : matrix_op::SparseLayout::Csc;
+            return SparseToProto(product.Layout() == layout ? product.View() : matrix_op::Convert(product.View(), layout).View(), result);
+        }
+        return ComputeToProto(product.Rows(), product.Columns(), encoding, result, [&](matrix_op::MutableMatrixView value)
+        {
+            matrix_op::ToDense(product.View(), value);
+        });
+    }
+
+    matrix_op::AlignedBuffer storage;
+    if (IsSparse(first.encoding()))
+    {
+        const matrix_op::SparseMatrixView a = SparseArg(first, t1);
+        const matrix_op::MatrixView b = DenseArg(another, t2, storage);
+        matrix_op::ValidateMulShapes(a, b);
+        return ComputeToProto(a.Rows(), b.Columns(), encoding, result, [&](matrix_op::MutableMatrixView value)
+        {
+            matrix_op::Multiply(a, b, value);
+        });
+    }
+
+    const matrix_op::MatrixView a = DenseArg(first, t1, storage);
+    const matrix_op::SparseMatrixView b = SparseArg(another, t2);
+    matrix_op::ValidateMulShapes(a, b);
+    ComputeToProto(a.Rows(), b.Columns(), encoding, result, [&](matrix_op::MutableMatrixView value)
+    {
+        matrix_op::Multiply(a, b, value);
+    });
 }
 
 } // namespace
 
 
-MatrixOpResponse RunProcedure(const MatrixOpRequest& request)
+void RunProcedure(const MatrixOpRequest& request, MatrixOpResponse& resp)
 {
-    if (request.op() != MatrixOpRequest::MUL) [[unlikely]]
+    int args_count = 0;
+    switch (request.op())
+    {
+    case MatrixOpRequest::MUL:
+        args_count = 2;
+        break;
+    case MatrixOpRequest::TRANSPOSE:
+        args_count = 1;
+        break;
+    default:
         throw ProcedureError(std::format("Unsupported operation in MatrixOpRequest: {}", (int) request.op()));
-    if (request.args_size() != 2) [[unlikely]]
+    }
+
+    if (request.args_size() != args_count) [[unlikely]]
         throw ProcedureError(std::format("Invalid count of args in MatrixOpRequest: {}", request.args_size()));
+    if (!request.transpose().empty() && (request.op() != MatrixOpRequest::MUL || request.transpose_size() != args_count)) [[unlikely]]
+        throw ProcedureError(std::format("Invalid count of transpose flags in MatrixOpRequest: {}", request.transpose_size()));
+    if (request.op() == MatrixOpRequest::TRANSPOSE ? request.result_encoding() != Matrix::FP32
+                                                   : !Matrix::Encoding_IsValid(request.result_encoding())) [[unlikely]]
+        throw ProcedureError(std::format("Unsupported result encoding in MatrixOpRequest: {}", (int) request.result_encoding()));
+    if (request.has_epilogue() && (request.op() != MatrixOpRequest::MUL
+                                   || !MatrixOpRequest::Activation_IsValid(request.epilogue().activation()))) [[unlikely]]
+        throw ProcedureError("Invalid epilogue in MatrixOpRequest");
+    if (request.op() == MatrixOpRequest::MUL)
+    {
+        const Matrix::Encoding e1 = request.args()[0].encoding();
+        const Matrix::Encoding e2 = request.args()[1].encoding();
+        if (IsSparse(e1) || IsSparse(e2))
+        {
+            if ((!IsSparse(e1) && e1 != Matrix::FP32) || (!IsSparse(e2) && e2 != Matrix::FP32)) [[unlikely]]
+                throw ProcedureError("Sparse argument of MatrixOpRequest can only be multiplied by FP32 or sparse one");
+            if (request.has_epilogue()) [[unlikely]]
+                throw ProcedureError("Epilogue is not supported for sparse arguments of MatrixOpRequest");
+        }
+        else if (e1 != e2) [[unlikely]]
+            throw ProcedureError("Arguments of MatrixOpRequest have different encodings");
+    }
 
-    MatrixOpResponse resp;
     try
     {
-        matrix_op::Matrix m1 = FromProto(request.args()[0]);
-        matrix_op::Matrix m2 = FromProto(request.args()[1]);
+        // Аргументы берутся прямо из буфера протобуфа, без копирования в matrix_op::Matrix
+        if (request.op() == MatrixOpRequest::TRANSPOSE)
+        {
+            matrix_op::MatrixView m = ViewFromProto(request.args()[0]);
+            matrix_op::Transpose(m, ResultToProto(m.Columns(), m.Rows(), *resp.mutable_result()));
+            return;
+        }
+
+        const matrix_op::Trans t1 = ArgTrans(request, 0);
+        const matrix_op::Trans t2 = ArgTrans(request, 1);
+        Matrix& result = *resp.mutable_result();
 
-        matrix_op::Matrix multiplication = m1 * m2;
+        if (IsSparse(request.args()[0].encoding()) || IsSparse(request.args()[1].encoding()))
+        {
+            MultiplySparseToProto(request, result);
+            return;
+        }
 
-        auto* result_proto_matrix = resp.mutable_result();
-        result_proto_matrix->set_rows(multiplication.Rows());
-        result_proto_matrix->set_columns(multiplication.Columns());
-        result_proto_matrix->mutable_content()->Assign(multiplication.Content().begin(), multiplication.Content().end());
+        switch (request.args()[0].encoding())
+        {
+        case Matrix::FP32:
+        {
+            matrix_op::MulOptions options;
+            if (request.algorithm() == MatrixOpRequest::STRASSEN)
+                options.algorithm = matrix_op::MulAlgorithm::Strassen;
+            const Matrix& another = request.args()[1];
+            const matrix_op::PackedMatrix* packed = another.handle() != 0 && t2 == matrix_op::Trans::No
+                                                  ? &PinStoredMatrix(another.handle()).packed : nullptr;
+            MultiplyToProto(ViewFromProto(request.args()[0]), t1, ViewFromProto(another), t2,
+                            request, result, options, packed);
+            break;
+        }
+        case Matrix::FP16:
+            MultiplyToProto(Float16ViewFromProto(request.args()[0]), t1, Float16ViewFromProto(request.args()[1]), t2,
+                            request, result);
+            break;
+        case Matrix::BF16:
+            MultiplyToProto(BFloat16ViewFromProto(request.args()[0]), t1, BFloat16ViewFromProto(request.args()[1]), t2,
+                            request, result);
+            break;
+        case Matrix::INT8:
+            MultiplyToProto(QuantizedViewFromProto(request.args()[0]), t1, QuantizedViewFromProto(request.args()[1]), t2,
+                            request, result);
+            break;
+        default:
+            throw ProcedureError(std::format("Unsupported matrix encoding: {}", (int) request.args()[0].encoding()));
+        }
     }
     catch(const matrix_op::MatrixCalcError& e)
     {
         *resp.mutable_error() = e.what();
     }
 
-    return resp;
 }
 
 } // namespace matrix_service
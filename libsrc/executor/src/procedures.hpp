@@ -2,6 +2,7 @@
 
 #include "matrix_service.pb.h"
 #include <stdexcept>
+#include <string>
 
 namespace matrix_service {
 
@@ -13,7 +14,15 @@ public:
 };
 
 
-// Частные случаи процедур
-MatrixOpResponse RunProcedure(const MatrixOpRequest&);
+// Частные случаи процедур. Ответ заполняется на месте: он может лежать в арене вместе с запросом
+void RunProcedure(const MatrixOpRequest&, MatrixOpResponse&);
+void RunProcedure(const MatrixExprRequest&, MatrixExprResponse&);
+void RunProcedure(const BatchMulRequest&, BatchMulResponse&);
+void RunProcedure(const StoreMatrixRequest&, StoreMatrixResponse&);
+void RunProcedure(const ReleaseMatrixRequest&, ReleaseMatrixResponse&);
+void RunProcedure(const MappedMulRequest&, MappedMulResponse&);
+
+// Каталог файлов матриц для MappedMulRequest, пусто - процедура выключена. Меняется только в ConfigureExecutor
+void SetMappedMatrixDir(std::string dir);
 
 } // namespace matrix_service
@@ -0,0 +1,207 @@
+#include "proto_matrix.hpp"
+#include "matrix_store.hpp"
+#include "procedures.hpp"
+
+#include "matrix_op/matrix_exception.hpp"
+#include "matrix_op/precision.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <limits>
+
+namespace matrix_service {
+
+namespace {
+
+// В хранилище лежат только FP32-матрицы
+void RejectHandle(const Matrix& m, Matrix::Encoding encoding)
+{
+    if (m.handle() != 0) [[unlikely]]
+        throw ProcedureError(std::format("Stored matrix (handle {}) is FP32, not {}", m.handle(), Matrix::Encoding_Name(encoding)));
+}
+
+// Элементы packed-кодировок (FP16/BF16/INT8) читаются из bytes на месте, без копирования
+template<typename T>
+matrix_op::BasicMatrixView<T> PackedViewFromProto(const Matrix& m, Matrix::Encoding encoding)
+{
+    RejectHandle(m, encoding);
+    if (m.encoding() != encoding) [[unlikely]]
+    {
+        throw ProcedureError(std::format("Unexpected matrix encoding: {} instead of {}",
+                                         Matrix::Encoding_Name(m.encoding()), Matrix::Encoding_Name(encoding)));
+    }
+
+    const std::string& packed = m.packed();
+    if (std::uint64_t(packed.size()) != std::uint64_t(m.rows()) * m.columns() * sizeof(T)) [[unlikely]]
+        throw ProcedureError(std::format("Invalid packed matrix size: {} bytes != {} x {} x {}", packed.size(), m.rows(), m.columns(), sizeof(T)));
+    // Буфер строки выделяется с выравниванием malloc, так что это не должно срабатывать
+    if (reinterpret_cast<std::uintptr_t>(packed.data()) % alignof(T) != 0) [[unlikely]]
+        throw ProcedureError("Misaligned packed matrix data");
+
+    const T* data = reinterpret_cast<const T*>(packed.data());
+    return matrix_op::BasicMatrixView<T>(m.rows(), m.columns(), data, data + packed.size() / sizeof(T));
+}
+
+template<typename T, typename ConvertT>
+void EncodePacked(matrix_op::MatrixView result, std::string& packed, ConvertT convert)
+{
+    packed.resize(std::size_t(result.Rows()) * result.Columns() * sizeof(T));
+    char* out = packed.data();
+    for (std::uint32_t r = 0; r < result.Rows(); r++)
+    {
+        for (float value : result[r])
+        {
+            const T encoded = convert(value);
+            std::memcpy(out, &encoded, sizeof(T));
+            out += sizeof(T);
+        }
+    }
+}
+
+} // namespace
+
+
+matrix_op::MatrixView ViewFromProto(const Matrix& m)
+{
+    if (m.handle() != 0)
+        return PinStoredMatrix(m.handle()).View();
+    if (m.encoding() != Matrix::FP32) [[unlikely]]
+        throw ProcedureError(std::format("Unexpected matrix encoding: {} instead of FP32", Matrix::Encoding_Name(m.encoding())));
+    if (std::uint64_t(m.content().size()) != std::uint64_t(m.rows()) * m.columns()) [[unlikely]]
+        throw ProcedureError(std::format("Invalid matrix content size: {} != {} x {}", m.content_size(), m.rows(), m.columns()));
+
+    return matrix_op::MatrixView(m.rows(), m.columns(), m.content().data(), m.content().data() + m.content().size());
+}
+
+matrix_op::Float16MatrixView Float16ViewFromProto(const Matrix& m)
+{
+    return PackedViewFromProto<matrix_op::Float16>(m, Matrix::FP16);
+}
+
+matrix_op::BFloat16MatrixView BFloat16ViewFromProto(const Matrix& m)
+{
+    return PackedViewFromProto<matrix_op::BFloat16>(m, Matrix::BF16);
+}
+
+matrix_op::QuantizedMatrixView QuantizedViewFromProto(const Matrix& m)
+{
+    if (m.zero_point() < -128 || m.zero_point() > 127 || !(m.scale() > 0)) [[unlikely]]
+        throw ProcedureError(std::format("Invalid quantization: scale {}, zero point {}", m.scale(), m.zero_point()));
+
+    return { PackedViewFromProto<std::int8_t>(m, Matrix::INT8), { m.scale(), m.zero_point() } };
+}
+
+bool IsSparse(Matrix::Encoding encoding)
+{
+    return encoding == Matrix::CSR || encoding == Matrix::CSC;
+}
+
+matrix_op::SparseMatrixView SparseViewFromProto(const Matrix& m)
+{
+    if (!IsSparse(m.encoding())) [[unlikely]]
+        throw ProcedureError(std::format("Unexpected matrix encoding: {} instead of CSR or CSC", Matrix::Encoding_Name(m.encoding())));
+
+    RejectHandle(m, m.encoding());
+
+    const matrix_op::SparseLayout layout = m.encoding() == Matrix::CSR ? matrix_op::SparseLayout::Csr : matrix_op::SparseLayout::Csc;
+    try
+    {
+        return matrix_op::SparseMatrixView(m.rows(), m.columns(), layout,
+                                           { m.offsets().data(), std::size_t(m.offsets_size()) },
+                                           { m.indices().data(), std::size_t(m.indices_size()) },
+                                           { m.content().data(), std::size_t(m.content_size()) });
+    }
+    catch (const matrix_op::MatrixCalcError& e)
+    {
+        // Некорректная структура - ошибка запроса, а не вычисления
+        throw ProcedureError(e.what());
+    }
+}
+
+void SparseToProto(matrix_op::SparseMatrixView sparse, Matrix& m)
+{
+    if (sparse.NonZeros() > std::size_t(std::numeric_limits<int>::max())) [[unlikely]]
+        throw matrix_op::MatrixCalcError(std::format("Result has too many non-zeros: {}", sparse.NonZeros()));
+
+    m.set_rows(sparse.Rows());
+    m.set_columns(sparse.Columns());
+    m.set_encoding(sparse.Layout() == matrix_op::SparseLayout::Csr ? Matrix::CSR : Matrix::CSC);
+    m.mutable_offsets()->Assign(sparse.Offsets().begin(), sparse.Offsets().end());
+    m.mutable_indices()->Assign(sparse.Indices().begin(), sparse.Indices().end());
+    m.mutable_content()->Assign(sparse.Values().begin(), sparse.Values().end());
+}
+
+void ValidateResultSize(std::uint32_t rows, std::uint32_t columns)
+{
+    const std::uint64_t size = std::uint64_t(rows) * columns;
+    if (size > std::uint64_t(std::numeric_limits<int>::max())) [[unlikely]]
+        throw matrix_op::MatrixCalcError(std::format("Result is too large: {} x {}", rows, columns));
+}
+
+void ValidateSparseSize(matrix_op::SparseMatrixView sparse)
+{
+    if (sparse.Rows() > MaxSparseDimension || sparse.Columns() > MaxSparseDimension) [[unlikely]]
+    {
+        throw matrix_op::MatrixCalcError(std::format("Sparse matrix is too large: {} x {}, at most {} per dimension",
+                                                     sparse.Rows(), sparse.Columns(), MaxSparseDimension));
+    }
+}
+
+matrix_op::MutableMatrixView ResultToProto(std::uint32_t rows, std::uint32_t columns, Matrix& m)
+{
+    ValidateResultSize(rows, columns);
+    const std::uint64_t size = std::uint64_t(rows) * columns;
+
+    m.set_rows(rows);
+    m.set_columns(columns);
+    auto* content = m.mutable_content();
+    content->Clear();
+    content->Reserve(size);
+    float* data = content->AddNAlreadyReserved(size);
+
+    return matrix_op::MutableMatrixView(rows, columns, columns, data);
+}
+
+void EncodeToProto(matrix_op::MatrixView result, Matrix::Encoding encoding, Matrix& m)
+{
+    if (IsSparse(encoding))
+    {
+        const matrix_op::SparseLayout layout = encoding == Matrix::CSR ? matrix_op::SparseLayout::Csr : matrix_op::SparseLayout::Csc;
+        return SparseToProto(matrix_op::SparseMatrix::FromDense(result, layout).View(), m);
+    }
+
+    m.set_rows(result.Rows());
+    m.set_columns(result.Columns());
+    m.set_encoding(encoding);
+
+    switch (encoding)
+    {
+    case Matrix::FP16:
+        EncodePacked<matrix_op::Float16>(result, *m.mutable_packed(), [](float v) { return matrix_op::ToFloat16(v); });
+        break;
+    case Matrix::BF16:
+        EncodePacked<matrix_op::BFloat16>(result, *m.mutable_packed(), [](float v) { return matrix_op::ToBFloat16(v); });
+        break;
+    case Matrix::INT8:
+    {
+        float min = 0, max = 0;
+        for (std::uint32_t r = 0; r < result.Rows(); r++)
+        {
+            const auto [row_min, row_max] = std::minmax_element(result[r].begin(), result[r].end());
+            min = std::min(min, *row_min);
+            max = std::max(max, *row_max);
+        }
+
+        const matrix_op::Quantization q = matrix_op::ChooseQuantization(min, max);
+        m.set_scale(q.scale);
+        m.set_zero_point(q.zero_point);
+        EncodePacked<std::int8_t>(result, *m.mutable_packed(), [q](float v) { return matrix_op::Quantize(v, q); });
+        break;
+    }
+    default:
+        throw ProcedureError(std::format("Unsupported result encoding: {}", (int) encoding));
+    }
+}
+
+} // namespace matrix_service
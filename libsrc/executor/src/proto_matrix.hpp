@@ -0,0 +1,50 @@
+#pragma once
+
+#include "matrix_service.pb.h"
+
+#include "matrix_op/matrix_view.hpp"
+#include "matrix_op/sparse.hpp"
+
+#include <cstdint>
+
+namespace matrix_service {
+
+// Данные протобуфа как MatrixView без копирования.
+// ProcedureError - если кодировка не FP32 или размер content не совпадает с rows x columns.
+// Для handle - матрица из хранилища, закрепленная до конца запроса (см. PinStoredMatrix),
+// MatrixCalcError - если ее там нет.
+matrix_op::MatrixView ViewFromProto(const Matrix& m);
+
+// То же для кодировок пониженной точности: элементы читаются прямо из packed.
+// ProcedureError - если кодировка другая или размер packed не совпадает с rows x columns.
+matrix_op::Float16MatrixView Float16ViewFromProto(const Matrix& m);
+matrix_op::BFloat16MatrixView BFloat16ViewFromProto(const Matrix& m);
+matrix_op::QuantizedMatrixView QuantizedViewFromProto(const Matrix& m);
+
+// CSR или CSC
+bool IsSparse(Matrix::Encoding encoding);
+
+// Разреженная матрица из offsets, indices и content без копирования.
+// ProcedureError - если кодировка не CSR/CSC или структура некорректна.
+matrix_op::SparseMatrixView SparseViewFromProto(const Matrix& m);
+
+// Копирует разреженную матрицу в протобуф в ее формате
+void SparseToProto(matrix_op::SparseMatrixView sparse, Matrix& m);
+
+// MatrixCalcError, если результат rows x columns не поместится в ответ
+void ValidateResultSize(std::uint32_t rows, std::uint32_t columns);
+
+// MatrixCalcError, если размер разреженного аргумента больше MaxSparseDimension. Его размеры
+// не ограничены данными запроса, а память ядер (аккумуляторы, смещения) растет с ними
+inline constexpr std::uint32_t MaxSparseDimension = 1u << 22;
+void ValidateSparseSize(matrix_op::SparseMatrixView sparse);
+
+// Выделяет в протобуфе место под результат rows x columns (без инициализации)
+// и возвращает его как view, чтобы ядро писало прямо в ответ.
+matrix_op::MutableMatrixView ResultToProto(std::uint32_t rows, std::uint32_t columns, Matrix& m);
+
+// Записывает посчитанный в fp32 результат в протобуф в кодировке пониженной точности
+// (FP16, BF16 или INT8 с параметрами квантования по диапазону значений) или разреженной (CSR, CSC)
+void EncodeToProto(matrix_op::MatrixView result, Matrix::Encoding encoding, Matrix& m);
+
+} // namespace matrix_service
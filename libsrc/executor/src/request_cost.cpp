@@ -0,0 +1,288 @@
+#include "request_cost.hpp"
+#include "matrix_store.hpp"
+
+#include "matrix_service.pb.h"
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace matrix_service {
+
+namespace {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+struct Shape
+{
+    std::uint64_t rows = 0;
+    std::uint64_t columns = 0;
+    std::uint64_t handle = 0; // Матрица из хранилища
+};
+
+// Стоимость с насыщением: огромный запрос должен оказаться самым дорогим, а не дешевым после переполнения
+std::uint64_t MulSaturated(std::uint64_t a, std::uint64_t b)
+{
+    std::uint64_t product = 0;
+    return __builtin_mul_overflow(a, b, &product) ? std::numeric_limits<std::uint64_t>::max() : product;
+}
+
+std::uint64_t AddSaturated(std::uint64_t a, std::uint64_t b)
+{
+    std::uint64_t sum = 0;
+    return __builtin_add_overflow(a, b, &sum) ? std::numeric_limits<std::uint64_t>::max() : sum;
+}
+
+bool IsField(std::uint32_t tag, int field, WireFormatLite::WireType type)
+{
+    return tag == WireFormatLite::MakeTag(field, type);
+}
+
+// Читает uint32-поле как одиночное или упакованное, для каждого значения вызывает on_value
+template<typename OnValue>
+bool ReadRepeatedVarint(CodedInputStream& input, std::uint32_t tag, OnValue on_value)
+{
+    std::uint32_t value = 0;
+    if (WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_VARINT)
+    {
+        if (!input.ReadVarint32(&value))
+            return false;
+        on_value(value);
+        return true;
+    }
+
+    std::uint32_t size = 0;
+    if (!input.ReadVarint32(&size))
+        return false;
+    const auto limit = input.PushLimit(size);
+    while (input.BytesUntilLimit() > 0)
+    {
+        if (!input.ReadVarint32(&value))
+            return false;
+        on_value(value);
+    }
+    input.PopLimit(limit);
+    return true;
+}
+
+// Вложенная Matrix: только rows и columns, для handle - размеры матрицы из хранилища.
+// Без resolve_handle хранилище не трогается (поиск в нем поднимает матрицу в LRU)
+bool ReadShape(CodedInputStream& input, Shape& shape, bool resolve_handle = true)
+{
+    std::uint32_t size = 0;
+    if (!input.ReadVarint32(&size))
+        return false;
+    const auto limit = input.PushLimit(size);
+    std::uint64_t handle = 0;
+    while (std::uint32_t tag = input.ReadTag())
+    {
+        std::uint32_t value = 0;
+        if (IsField(tag, Matrix::kHandleFieldNumber, WireFormatLite::WIRETYPE_VARINT))
+        {
+            if (!input.ReadVarint64(&handle))
+                return false;
+        }
+        else if (IsField(tag, Matrix::kRowsFieldNumber, WireFormatLite::WIRETYPE_VARINT))
+        {
+            if (!input.ReadVarint32(&value))
+                return false;
+            shape.rows = value;
+        }
+        else if (IsField(tag, Matrix::kColumnsFieldNumber, WireFormatLite::WIRETYPE_VARINT))
+        {
+            if (!input.ReadVarint32(&value))
+                return false;
+            shape.columns = value;
+        }
+        else if (!WireFormatLite::SkipField(&input, tag))
+            return false;
+    }
+    const bool consumed = input.ConsumedEntireMessage();
+    input.PopLimit(limit);
+
+    shape.handle = handle;
+    if (MatrixStore* store = ActiveMatrixStore(); resolve_handle && handle != 0 && store)
+    {
+        if (const auto stored = store->Find(handle))
+            shape = { stored->rows, stored->columns };
+    }
+    return consumed;
+}
+
+std::uint64_t MatrixOpCost(CodedInputStream& input)
+{
+    std::uint32_t op = MatrixOpRequest::MUL;
+    std::vector<Shape> args;
+    std::vector<bool> transpose;
+    while (std::uint32_t tag = input.ReadTag())
+    {
+        bool ok = true;
+        if (IsField(tag, MatrixOpRequest::kOpFieldNumber, WireFormatLite::WIRETYPE_VARINT))
+            ok = input.ReadVarint32(&op);
+        else if (IsField(tag, MatrixOpRequest::kArgsFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+            ok = ReadShape(input, args.emplace_back());
+        else if (WireFormatLite::GetTagFieldNumber(tag) == MatrixOpRequest::kTransposeFieldNumber)
+            ok = ReadRepeatedVarint(input, tag, [&](std::uint32_t flag) { transpose.push_back(flag != 0); });
+        else
+            ok = WireFormatLite::SkipField(&input, tag);
+        if (!ok)
+            return 0;
+    }
+
+    if (op == MatrixOpRequest::TRANSPOSE)
+        return args.size() == 1 ? args[0].rows * args[0].columns : 0;
+    if (args.size() != 2)
+        return 0;
+    for (std::size_t i = 0; i < transpose.size() && i < args.size(); i++)
+    {
+        if (transpose[i])
+            std::swap(args[i].rows, args[i].columns);
+    }
+    return MulSaturated(args[0].rows * args[0].columns, args[1].columns);
+}
+
+// Вложенный MatrixExprRequest.Node: только номера аргументов
+bool ReadNodeArgs(CodedInputStream& input, std::vector<std::uint32_t>& args)
+{
+    std::uint32_t size = 0;
+    if (!input.ReadVarint32(&size))
+        return false;
+    const auto limit = input.PushLimit(size);
+    while (std::uint32_t tag = input.ReadTag())
+    {
+        const bool ok = WireFormatLite::GetTagFieldNumber(tag) == MatrixExprRequest::Node::kArgsFieldNumber
+                        ? ReadRepeatedVarint(input, tag, [&](std::uint32_t arg) { args.push_back(arg); })
+                        : WireFormatLite::SkipField(&input, tag);
+        if (!ok)
+            return false;
+    }
+    const bool consumed = input.ConsumedEntireMessage();
+    input.PopLimit(limit);
+    return consumed;
+}
+
+// Цепочки узлов - слева направо, как их считает MultiplyChain в худшем случае
+std::uint64_t MatrixExprCost(CodedInputStream& input)
+{
+    std::vector<Shape> operands;
+    std::vector<std::vector<std::uint32_t>> nodes;
+    while (std::uint32_t tag = input.ReadTag())
+    {
+        bool ok = true;
+        if (IsField(tag, MatrixExprRequest::kInputsFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+            ok = ReadShape(input, operands.emplace_back());
+        else if (IsField(tag, MatrixExprRequest::kNodesFieldNumber, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+            ok = ReadNodeArgs(input, nodes.emplace_back());
+        else
+            ok = WireFormatLite::SkipField(&input, tag);
+        if (!ok)
+            return 0;
+    }
+
+    std::uint64_t cost = 0;
+    for (const auto& args : nodes)
+    {
+        if (args.empty() || std::any_of(args.begin(), args.end(), [&](std::uint32_t arg) { return arg >= operands.size(); }))
+            return cost;
+        Shape value = operands[args[0]];
+        for (std::size_t i = 1; i < args.size(); i++)
+        {
+            cost = AddSaturated(cost, MulSaturated(value.rows * value.columns, operands[args[i]].columns));
+            value.columns = operands[args[i]].columns;
+        }
+        // Узел из одного аргумента (например, TRANSPOSE) - проход по матрице
+        if (args.size() == 1)
+            cost = AddSaturated(cost, value.rows * value.columns);
+        operands.push_back(value);
+    }
+    return cost;
+}
+
+std::uint64_t BatchMulCost(CodedInputStream& input)
+{
+    std::uint32_t dims[4] = {}; // count, rows, inner, columns
+    while (std::uint32_t tag = input.ReadTag())
+    {
+        const int field = WireFormatLite::GetTagFieldNumber(tag);
+        bool ok = true;
+        if (field >= BatchMulRequest::kCountFieldNumber && field <= BatchMulRequest::kColumnsFieldNumber
+            && WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_VARINT)
+            ok = input.ReadVarint32(&dims[field - BatchMulRequest::kCountFieldNumber]);
+        else
+            ok = WireFormatLite::SkipField(&input, tag);
+        if (!ok)
+            return 0;
+    }
+    return MulSaturated(std::uint64_t(dims[0]) * dims[1], std::uint64_t(dims[2]) * dims[3]);
+}
+
+// Есть ли handle среди матриц в полях matrix_field сообщения. nested_field - вложенное сообщение
+// (эпилог MatrixOp), в котором матрица - поле nested_matrix_field. Некорректный payload - как с handle
+bool HasStoredMatrix(CodedInputStream& input, int matrix_field, int nested_field = 0, int nested_matrix_field = 0)
+{
+    while (std::uint32_t tag = input.ReadTag())
+    {
+        if (IsField(tag, matrix_field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+        {
+            Shape shape;
+            if (!ReadShape(input, shape, false) || shape.handle != 0)
+                return true;
+        }
+        else if (nested_field != 0 && IsField(tag, nested_field, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+        {
+            std::uint32_t size = 0;
+            if (!input.ReadVarint32(&size))
+                return true;
+            const auto limit = input.PushLimit(size);
+            if (HasStoredMatrix(input, nested_matrix_field) || !input.ConsumedEntireMessage())
+                return true;
+            input.PopLimit(limit);
+        }
+        else if (!WireFormatLite::SkipField(&input, tag))
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+
+bool ReferencesStoredMatrix(int proc_id, std::string_view payload)
+{
+    CodedInputStream input(reinterpret_cast<const std::uint8_t*>(payload.data()), payload.size());
+    switch (proc_id)
+    {
+    case ProcedureData::MATRIX_OP:
+        return HasStoredMatrix(input, MatrixOpRequest::kArgsFieldNumber,
+                               MatrixOpRequest::kEpilogueFieldNumber, MatrixOpRequest::Epilogue::kAddendFieldNumber);
+    case ProcedureData::MATRIX_EXPR:
+        return HasStoredMatrix(input, MatrixExprRequest::kInputsFieldNumber);
+    default:
+        return false;
+    }
+}
+
+std::uint64_t RequestCost(int proc_id, std::string_view payload)
+{
+    CodedInputStream input(reinterpret_cast<const std::uint8_t*>(payload.data()), payload.size());
+    switch (proc_id)
+    {
+    case ProcedureData::MATRIX_OP:
+        return MatrixOpCost(input);
+    case ProcedureData::MATRIX_EXPR:
+        return MatrixExprCost(input);
+    case ProcedureData::BATCH_MUL:
+        return BatchMulCost(input);
+    case ProcedureData::MAPPED_MUL:
+        // Размеры - в файлах, читать их здесь незачем: такие умножения заведомо дорогие
+        return std::numeric_limits<std::uint64_t>::max();
+    default:
+        return 0;
+    }
+}
+
+} // namespace matrix_service
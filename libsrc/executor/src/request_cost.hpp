@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace matrix_service {
+
+// Оценка стоимости запроса в умножениях-сложениях (rows * inner * columns для MUL) по размерам из
+// сериализованного payload процедуры proc_id. Разбирается только структура: содержимое матриц
+// пропускается целиком, без копирования. Разреженные матрицы оцениваются как плотные (сверху).
+// Размеры матриц по handle берутся из хранилища (неизвестный handle - пустая матрица).
+// Некорректный или незнакомый запрос стоит 0: он быстро завершится ошибкой.
+std::uint64_t RequestCost(int proc_id, std::string_view payload);
+
+// Ссылается ли запрос proc_id на матрицы хранилища по handle (аргументы MatrixOp и addend эпилога,
+// входы MatrixExpr). Разбирается так же, как в RequestCost; некорректный payload считается ссылающимся
+bool ReferencesStoredMatrix(int proc_id, std::string_view payload);
+
+} // namespace matrix_service
@@ -0,0 +1,68 @@
+#include "request_pool.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace matrix_service {
+
+RequestPool::RequestPool(std::uint32_t threads, bool pin)
+    : pinned_(pin)
+{
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (std::uint32_t i = 0; i < threads; i++)
+    {
+        workers_.emplace_back([this] { WorkerLoop(); });
+        if (pin)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % cores, &cpus);
+            // Неудача не мешает работе: поток просто остается незакрепленным
+            pthread_setaffinity_np(workers_.back().native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+}
+
+RequestPool::~RequestPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void RequestPool::Post(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void RequestPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty())
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
+
+} // namespace matrix_service
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace matrix_service {
+
+// Пул потоков для асинхронного исполнения запросов целиком (в отличие от fork/join пула matrix_op,
+// который делит одно умножение). Задачи берутся в порядке поступления.
+class RequestPool
+{
+public:
+    // pin: поток i закрепляется за ядром i (по кругу), чтобы исполнение не мигрировало между ядрами
+    explicit RequestPool(std::uint32_t threads, bool pin = false);
+    RequestPool(const RequestPool&) = delete;
+    RequestPool& operator=(const RequestPool&) = delete;
+    // Дорабатывает уже поставленные задачи
+    ~RequestPool();
+
+    std::uint32_t Threads() const { return workers_.size(); }
+    bool Pinned() const { return pinned_; }
+
+    // Задача не должна бросать исключений
+    void Post(std::function<void()> task);
+
+private:
+    void WorkerLoop();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stop_ = false;
+    bool pinned_ = false;
+
+    std::vector<std::thread> workers_;
+};
+
+} // namespace matrix_service
@@ -0,0 +1,90 @@
+#include "result_cache.hpp"
+
+#include <functional>
+
+namespace matrix_service {
+
+namespace {
+
+// Примерные накладные расходы на запись: узлы списка и хэш-таблицы, заголовки строк
+constexpr std::size_t EntryOverhead = 128;
+
+std::uint64_t RequestHash(std::string_view request)
+{
+    return std::hash<std::string_view>{}(request);
+}
+
+} // namespace
+
+
+ResultCache::ResultCache(std::size_t budget_bytes)
+    : shard_budget_(budget_bytes / ShardCount)
+{}
+
+std::size_t ResultCache::EntryBytes(const Entry& entry)
+{
+    return entry.request.size() + entry.response.size() + EntryOverhead;
+}
+
+void ResultCache::Erase(Shard& shard, std::list<Entry>::iterator it)
+{
+    shard.bytes -= EntryBytes(*it);
+    shard.index.erase(it->hash);
+    shard.lru.erase(it);
+}
+
+bool ResultCache::Find(std::string_view request, std::vector<char>& response)
+{
+    const std::uint64_t hash = RequestHash(request);
+    Shard& shard = ShardFor(hash);
+    {
+        std::lock_guard lock(shard.mutex);
+        auto found = shard.index.find(hash);
+        if (found != shard.index.end() && found->second->request == request)
+        {
+            shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            response.assign(found->second->response.begin(), found->second->response.end());
+            return true;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void ResultCache::Insert(std::string_view request, std::string_view response)
+{
+    const std::uint64_t hash = RequestHash(request);
+    Entry entry{hash, std::string(request), std::string(response)};
+    const std::size_t bytes = EntryBytes(entry);
+    if (bytes > shard_budget_)
+        return;
+
+    Shard& shard = ShardFor(hash);
+    std::lock_guard lock(shard.mutex);
+    // Тот же запрос мог посчитаться параллельно, а при коллизии хэшей новая запись вытесняет старую
+    if (auto found = shard.index.find(hash); found != shard.index.end())
+        Erase(shard, found->second);
+    while (shard.bytes + bytes > shard_budget_)
+        Erase(shard, std::prev(shard.lru.end()));
+
+    shard.lru.push_front(std::move(entry));
+    shard.index.emplace(hash, shard.lru.begin());
+    shard.bytes += bytes;
+}
+
+ResultCacheStats ResultCache::Stats() const
+{
+    ResultCacheStats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    for (const Shard& shard : shards_)
+    {
+        std::lock_guard lock(shard.mutex);
+        stats.entries += shard.lru.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
+
+} // namespace matrix_service
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "executor/executor.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace matrix_service {
+
+// LRU-кэш готовых ответов (вместе с префиксом размера) по сериализованному запросу: повторный запрос отдается без разбора и вычислений.
+// Ключ - хэш байтов запроса, но сам запрос хранится целиком и сравнивается при попадании,
+// поэтому коллизия хэшей не может вернуть чужой ответ. Доступ разбит на шарды со своими мьютексами.
+class ResultCache
+{
+public:
+    // budget_bytes - общий лимит на запросы и ответы всех записей, делится между шардами поровну
+    explicit ResultCache(std::size_t budget_bytes);
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // При попадании копирует ответ в response (его емкость переиспользуется)
+    bool Find(std::string_view request, std::vector<char>& response);
+    // Запись больше лимита шарда не сохраняется
+    void Insert(std::string_view request, std::string_view response);
+
+    ResultCacheStats Stats() const;
+
+private:
+    struct Entry
+    {
+        std::uint64_t hash;
+        std::string request;
+        std::string response;
+    };
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::list<Entry> lru; // Спереди - недавно использованные
+        std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+        std::size_t bytes = 0;
+    };
+
+    static constexpr std::size_t ShardCount = 16;
+
+    Shard& ShardFor(std::uint64_t hash) { return shards_[hash % ShardCount]; }
+    static std::size_t EntryBytes(const Entry& entry);
+    void Erase(Shard& shard, std::list<Entry>::iterator it);
+
+private:
+    std::size_t shard_budget_;
+    std::array<Shard, ShardCount> shards_;
+    std::atomic<std::uint64_t> hits_ = 0;
+    std::atomic<std::uint64_t> misses_ = 0;
+};
+
+} // namespace matrix_service
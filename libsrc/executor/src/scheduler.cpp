@@ -0,0 +1,135 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace matrix_service {
+
+RequestScheduler::RequestScheduler(const Config& conf)
+    : small_cost_(conf.small_cost),
+      aging_(conf.aging)
+{
+    small_.slots = std::max(1u, conf.small_slots);
+    large_.slots = std::max(1u, conf.large_slots);
+}
+
+void RequestScheduler::Schedule(std::uint64_t cost, Start start)
+{
+    std::vector<std::pair<Start, Lane>> to_start;
+    {
+        std::lock_guard lock(mutex_);
+        LaneState& lane = cost < small_cost_ ? small_ : large_;
+        lane.waiting.push_back({ cost, std::chrono::steady_clock::now(), std::move(start) });
+        Dispatch(to_start);
+    }
+    for (auto& [start_waiting, slot_lane] : to_start)
+        start_waiting(slot_lane);
+}
+
+void RequestScheduler::Release(Lane slot_lane)
+{
+    std::vector<std::pair<Start, Lane>> to_start;
+    {
+        std::lock_guard lock(mutex_);
+        (slot_lane == Lane::Small ? small_ : large_).busy--;
+        Dispatch(to_start);
+    }
+    for (auto& [start_waiting, lane] : to_start)
+        start_waiting(lane);
+}
+
+SchedulerStats RequestScheduler::Stats() const
+{
+    std::lock_guard lock(mutex_);
+    SchedulerStats stats;
+    stats.small_started = small_.started;
+    stats.large_started = large_.started;
+    stats.borrowed = borrowed_;
+    stats.small_waiting = small_.waiting.size();
+    stats.large_waiting = large_.waiting.size();
+    return stats;
+}
+
+void RequestScheduler::Dispatch(std::vector<std::pair<Start, Lane>>& to_start)
+{
+    const auto now = std::chrono::steady_clock::now();
+    while (true)
+    {
+        if (!large_.waiting.empty() && large_.busy < large_.slots)
+        {
+            large_.busy++;
+            large_.started++;
+            to_start.emplace_back(TakeBest(large_, now).start, Lane::Large);
+        }
+        else if (!small_.waiting.empty() && small_.busy < small_.slots)
+        {
+            small_.busy++;
+            small_.started++;
+            to_start.emplace_back(TakeBest(small_, now).start, Lane::Small);
+        }
+        else if (!small_.waiting.empty() && large_.busy < large_.slots)
+        {
+            // Дорогих в очереди нет (иначе место досталось бы им выше) - занимаем их место
+            large_.busy++;
+            small_.started++;
+            borrowed_++;
+            to_start.emplace_back(TakeBest(small_, now).start, Lane::Large);
+        }
+        else
+            break;
+    }
+}
+
+RequestScheduler::Waiting RequestScheduler::TakeBest(LaneState& lane, std::chrono::steady_clock::time_point now)
+{
+    auto effective_cost = [&](const Waiting& w)
+    {
+        if (aging_.count() == 0)
+            return w.cost;
+        const auto periods = std::min<std::int64_t>(63, (now - w.since) / aging_);
+        return w.cost >> periods;
+    };
+
+    // При равенстве - пришедший раньше
+    auto best = lane.waiting.begin();
+    std::uint64_t best_cost = effective_cost(*best);
+    for (auto it = std::next(best); it != lane.waiting.end(); ++it)
+    {
+        const std::uint64_t cost = effective_cost(*it);
+        if (cost < best_cost)
+        {
+            best = it;
+            best_cost = cost;
+        }
+    }
+
+    Waiting taken = std::move(*best);
+    lane.waiting.erase(best);
+    return taken;
+}
+
+
+ScheduledSlot::ScheduledSlot(RequestScheduler& scheduler, std::uint64_t cost)
+    : scheduler_(scheduler)
+{
+    Wait wait;
+    // Захватывается один указатель - std::function не выделяет память
+    scheduler_.Schedule(cost, [wait = &wait](RequestScheduler::Lane lane)
+    {
+        std::lock_guard lock(wait->mutex);
+        wait->lane = lane;
+        wait->ready = true;
+        wait->cv.notify_one();
+    });
+
+    std::unique_lock lock(wait.mutex);
+    wait.cv.wait(lock, [&wait] { return wait.ready; });
+    lane_ = wait.lane;
+}
+
+ScheduledSlot::~ScheduledSlot()
+{
+    scheduler_.Release(lane_);
+}
+
+} // namespace matrix_service
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "executor/executor.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace matrix_service {
+
+// Планировщик по оценке стоимости: дешевые и дорогие запросы исполняются в отдельных полосах
+// со своим числом мест, поэтому большие умножения не занимают все места и не задерживают мелкие.
+// Внутри полосы первым стартует самый дешевый ожидающий (SJF), а чтобы дорогие не голодали,
+// оценка ожидающего запроса уменьшается вдвое за каждый период aging ожидания.
+// Мелкий запрос может занять свободное место дорогой полосы, если там никто не ждет.
+class RequestScheduler
+{
+public:
+    enum class Lane
+    {
+        Small,
+        Large,
+    };
+
+    struct Config
+    {
+        std::uint64_t small_cost;       // Запросы дешевле - в полосу мелких
+        std::uint32_t small_slots;
+        std::uint32_t large_slots;
+        std::chrono::milliseconds aging; // 0 - без старения
+    };
+
+    // Вызывается, когда запросу досталось место: сразу в Schedule или позже в потоке, освободившем
+    // место, вне мьютекса. Полученную полосу места нужно вернуть в Release
+    using Start = std::function<void(Lane slot_lane)>;
+
+    explicit RequestScheduler(const Config& conf);
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    void Schedule(std::uint64_t cost, Start start);
+    void Release(Lane slot_lane);
+
+    SchedulerStats Stats() const;
+
+private:
+    struct Waiting
+    {
+        std::uint64_t cost;
+        std::chrono::steady_clock::time_point since;
+        Start start;
+    };
+
+    struct LaneState
+    {
+        std::uint32_t slots;
+        std::uint32_t busy = 0;
+        std::uint64_t started = 0;
+        std::vector<Waiting> waiting; // В порядке поступления
+    };
+
+    // Под мьютексом: раздает свободные места ожидающим, стартовать их нужно после разблокировки
+    void Dispatch(std::vector<std::pair<Start, Lane>>& to_start);
+    // Самый дешевый с учетом старения
+    Waiting TakeBest(LaneState& lane, std::chrono::steady_clock::time_point now);
+
+private:
+    const std::uint64_t small_cost_;
+    const std::chrono::milliseconds aging_;
+
+    mutable std::mutex mutex_;
+    LaneState small_;
+    LaneState large_;
+    std::uint64_t borrowed_ = 0;
+};
+
+
+// Место для синхронного исполнения: ждет в конструкторе, освобождает в деструкторе
+class ScheduledSlot
+{
+public:
+    ScheduledSlot(RequestScheduler& scheduler, std::uint64_t cost);
+    ScheduledSlot(const ScheduledSlot&) = delete;
+    ScheduledSlot& operator=(const ScheduledSlot&) = delete;
+    ~ScheduledSlot();
+
+private:
+    struct Wait
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool ready = false;
+        RequestScheduler::Lane lane = RequestScheduler::Lane::Small;
+    };
+
+    RequestScheduler& scheduler_;
+    RequestScheduler::Lane lane_;
+};
+
+} // namespace matrix_service
@@ -0,0 +1,35 @@
+#include "matrix_store.hpp"
+#include "procedures.hpp"
+#include "proto_matrix.hpp"
+
+#include "matrix_op/matrix_exception.hpp"
+
+namespace matrix_service {
+
+void RunProcedure(const StoreMatrixRequest& request, StoreMatrixResponse& resp)
+{
+    if (request.matrix().handle() != 0) [[unlikely]]
+        throw ProcedureError("StoreMatrixRequest must contain the matrix itself, not a handle");
+
+    try
+    {
+        MatrixStore* store = ActiveMatrixStore();
+        if (!store) [[unlikely]]
+            throw matrix_op::MatrixCalcError("Matrix store is disabled");
+
+        // Пустую матрицу отвергает сам MatrixView
+        resp.set_handle(store->Put(ViewFromProto(request.matrix())));
+    }
+    catch (const matrix_op::MatrixCalcError& e)
+    {
+        *resp.mutable_error() = e.what();
+    }
+}
+
+void RunProcedure(const ReleaseMatrixRequest& request, ReleaseMatrixResponse& resp)
+{
+    MatrixStore* store = ActiveMatrixStore();
+    resp.set_released(store && store->Release(request.handle()));
+}
+
+} // namespace matrix_service
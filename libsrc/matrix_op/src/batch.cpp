@@ -0,0 +1,142 @@
+#include "matrix_op/batch.hpp"
+#include "matrix_op/matrix_exception.hpp"
+#include "matrix_op/parallel.hpp"
+
+#include "gemm.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <format>
+
+namespace matrix_op {
+
+namespace {
+
+// Произведений в группе: по одному на SIMD-линию (8 - ширина AVX2 во float)
+constexpr std::uint32_t BatchLanes = 8;
+// Группами считаются матрицы со сторонами не больше этой; при columns >= BatchLanes
+// линии и так заполнены строкой результата - такие идут по одной через Gemm
+constexpr std::uint32_t MaxInterleavedSize = 16;
+// Произведений на задачу пула: меньше - fork/join дороже самих умножений
+constexpr std::uint32_t MinBatchTask = 4 * BatchLanes;
+
+bool Interleaved(const BatchShape& shape)
+{
+    return shape.columns < BatchLanes && shape.rows <= MaxInterleavedSize && shape.inner <= MaxInterleavedSize;
+}
+
+// BatchLanes произведений подряд: операнды перекладываются так, что элемент e всех
+// матриц группы лежит рядом ([e][lane]), и каждая операция идет сразу по всем линиям.
+// Порядок суммирования тот же, что и в наивном умножении каждой пары
+void MultiplyGroup(const BatchShape& shape, const float* a, const float* b, float* c)
+{
+    const std::uint32_t a_size = shape.rows * shape.inner;
+    const std::uint32_t b_size = shape.inner * shape.columns;
+    const std::uint32_t c_size = shape.rows * shape.columns;
+
+    alignas(64) float pa[MaxInterleavedSize * MaxInterleavedSize][BatchLanes];
+    alignas(64) float pb[MaxInterleavedSize * BatchLanes][BatchLanes];
+    for (std::uint32_t lane = 0; lane < BatchLanes; lane++)
+    {
+        for (std::uint32_t e = 0; e < a_size; e++)
+            pa[e][lane] = a[lane * a_size + e];
+        for (std::uint32_t e = 0; e < b_size; e++)
+            pb[e][lane] = b[lane * b_size + e];
+    }
+
+    for (std::uint32_t i = 0; i < shape.rows; i++)
+     for (std::uint32_t j = 0; j < shape.columns; j++)
+    {
+        float acc[BatchLanes] = {};
+        for (std::uint32_t p = 0; p < shape.inner; p++)
+        {
+            const float* av = pa[i * shape.inner + p];
+            const float* bv = pb[p * shape.columns + j];
+            for (std::uint32_t lane = 0; lane < BatchLanes; lane++)
+                acc[lane] += av[lane] * bv[lane];
+        }
+        for (std::uint32_t lane = 0; lane < BatchLanes; lane++)
+            c[lane * c_size + i * shape.columns + j] = acc[lane];
+    }
+}
+
+// Произведения [begin, end) пакета
+void MultiplyRange(const BatchShape& shape, const float* a, const float* b, float* c,
+                   std::uint32_t begin, std::uint32_t end)
+{
+    const std::size_t a_size = std::size_t(shape.rows) * shape.inner;
+    const std::size_t b_size = std::size_t(shape.inner) * shape.columns;
+    const std::size_t c_size = std::size_t(shape.rows) * shape.columns;
+
+    std::uint32_t idx = begin;
+    if (Interleaved(shape))
+    {
+        for (; idx + BatchLanes <= end; idx += BatchLanes)
+            MultiplyGroup(shape, a + idx * a_size, b + idx * b_size, c + idx * c_size);
+    }
+
+    // Остаток (или большие матрицы) - по одной
+    for (; idx < end; idx++)
+    {
+        detail::Gemm(shape.rows, shape.columns, shape.inner,
+                     detail::Operand{ a + idx * a_size, shape.inner },
+                     detail::Operand{ b + idx * b_size, shape.columns },
+                     c + idx * c_size, shape.columns);
+    }
+}
+
+} // namespace
+
+
+void ValidateBatch(const BatchShape& shape, std::span<const float> first, std::span<const float> another)
+{
+    if (shape.count == 0 || shape.rows == 0 || shape.inner == 0 || shape.columns == 0) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Empty batch: {} x ({} x {}) * ({} x {})",
+                                          shape.count, shape.rows, shape.inner, shape.inner, shape.columns));
+    }
+
+    // Полный объем не меньше любого из размеров ниже: если он не переполнился, то и они тоже
+    std::uint64_t volume = 0;
+    if (__builtin_mul_overflow(std::uint64_t(shape.count) * shape.rows, std::uint64_t(shape.inner) * shape.columns, &volume)) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Batch is too large: {} x ({} x {}) * ({} x {})",
+                                          shape.count, shape.rows, shape.inner, shape.inner, shape.columns));
+    }
+
+    const std::uint64_t count = shape.count;
+    if (first.size() != count * shape.rows * shape.inner || another.size() != count * shape.inner * shape.columns) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Batch data size {} and {} != {} x ({} x {}) and {} x ({} x {})",
+                                          first.size(), another.size(),
+                                          shape.count, shape.rows, shape.inner, shape.count, shape.inner, shape.columns));
+    }
+}
+
+void MultiplyBatch(const BatchShape& shape, std::span<const float> first, std::span<const float> another,
+                   std::span<float> result)
+{
+    ValidateBatch(shape, first, another);
+    if (result.size() != std::uint64_t(shape.count) * shape.rows * shape.columns) [[unlikely]]
+        throw MatrixCalcError(std::format("Batch result size {} != {} x ({} x {})", result.size(), shape.count, shape.rows, shape.columns));
+
+    const std::uint64_t volume = std::uint64_t(shape.count) * shape.rows * shape.inner * shape.columns;
+    std::shared_ptr<detail::ThreadPool> pool;
+    if (volume >= ParallelThreshold() && shape.count >= 2 * MinBatchTask)
+        pool = detail::SharedPool();
+    if (!pool || pool->Threads() == 1)
+        return MultiplyRange(shape, first.data(), another.data(), result.data(), 0, shape.count);
+
+    // Задачи кратны группе, чтобы остаток по одной был только в последней
+    const std::uint32_t per_task = std::max(MinBatchTask, (shape.count + 2 * pool->Threads() - 1) / (2 * pool->Threads()));
+    const std::uint32_t task_size = (per_task + BatchLanes - 1) / BatchLanes * BatchLanes;
+    const std::uint32_t tasks = (shape.count + task_size - 1) / task_size;
+
+    pool->ParallelFor(tasks, [&](std::size_t task)
+    {
+        const std::uint32_t begin = task * task_size;
+        MultiplyRange(shape, first.data(), another.data(), result.data(), begin, std::min(begin + task_size, shape.count));
+    });
+}
+
+} // namespace matrix_op
@@ -0,0 +1,181 @@
+#include "matrix_op/chain.hpp"
+#include "matrix_op/matrix_exception.hpp"
+
+#include <algorithm>
+#include <format>
+#include <limits>
+
+namespace matrix_op {
+
+namespace {
+
+std::uint32_t ChainSize(std::span<const std::uint32_t> dims)
+{
+    if (dims.size() < 2) [[unlikely]]
+        throw MatrixCalcError("Empty chain of matrices");
+    return dims.size() - 1;
+}
+
+} // namespace
+
+
+ChainOrder::ChainOrder(std::span<const std::uint32_t> dims)
+    : size_(ChainSize(dims)),
+      cost_(std::size_t(size_) * size_, 0),
+      split_(std::size_t(size_) * size_, 0)
+{
+    for (std::uint32_t len = 2; len <= size_; len++)
+    {
+        for (std::uint32_t i = 0; i + len <= size_; i++)
+        {
+            const std::uint32_t j = i + len - 1;
+            std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+            for (std::uint32_t k = i; k < j; k++)
+            {
+                const std::uint64_t cost = Cost(i, k) + Cost(k + 1, j)
+                                         + std::uint64_t(dims[i]) * dims[k + 1] * dims[j + 1];
+                if (cost < best)
+                {
+                    best = cost;
+                    split_[i * size_ + j] = k;
+                }
+            }
+            cost_[i * size_ + j] = best;
+        }
+    }
+}
+
+std::pair<std::uint32_t, std::uint32_t> LargestChainIntermediate(std::span<const std::uint32_t> dims)
+{
+    std::pair<std::uint32_t, std::uint32_t> largest = { 0, 0 };
+    // Одна или две матрицы - промежуточных нет
+    if (dims.size() < 4)
+        return largest;
+
+    const ChainOrder order(dims);
+    // Обход дерева разрезов без рекурсии; корень - сам результат
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges = { { 0, order.Size() - 1 } };
+    while (!ranges.empty())
+    {
+        const auto [i, j] = ranges.back();
+        ranges.pop_back();
+        const std::uint32_t k = order.Split(i, j);
+        for (const auto& [from, to] : { std::pair{ i, k }, std::pair{ k + 1, j } })
+        {
+            if (from == to)
+                continue;
+            if (std::uint64_t(dims[from]) * dims[to + 1] > std::uint64_t(largest.first) * largest.second)
+                largest = { dims[from], dims[to + 1] };
+            ranges.push_back({ from, to });
+        }
+    }
+    return largest;
+}
+
+
+AlignedBuffer BufferPool::Acquire(std::size_t size)
+{
+    // Наименьший подходящий
+    auto best = free_.end();
+    for (auto it = free_.begin(); it != free_.end(); ++it)
+    {
+        if (it->Size() >= size && (best == free_.end() || it->Size() < best->Size()))
+            best = it;
+    }
+
+    if (best == free_.end())
+        return AlignedBuffer(size);
+
+    AlignedBuffer buffer = std::move(*best);
+    free_.erase(best);
+    return buffer;
+}
+
+void BufferPool::Release(AlignedBuffer buffer)
+{
+    if (buffer.Size())
+        free_.push_back(std::move(buffer));
+}
+
+
+namespace {
+
+struct ChainEvaluator
+{
+    std::span<const MatrixView> factors;
+    const ChainOrder& order;
+    const MulOptions& options;
+    BufferPool& pool;
+
+    // Произведение factors[i..j] в result; эпилог options - только у итогового
+    void Evaluate(std::uint32_t i, std::uint32_t j, MutableMatrixView result, bool final)
+    {
+        const std::uint32_t k = order.Split(i, j);
+
+        AlignedBuffer left_buffer, right_buffer;
+        const MatrixView left = Operand(i, k, left_buffer);
+        const MatrixView right = Operand(k + 1, j, right_buffer);
+        MulOptions step = options;
+        if (!final)
+            step.epilogue = {};
+        Multiply(left, right, result, step);
+
+        pool.Release(std::move(left_buffer));
+        pool.Release(std::move(right_buffer));
+    }
+
+    // Одиночный множитель - как есть, иначе - промежуточное произведение в буфере из пула
+    MatrixView Operand(std::uint32_t i, std::uint32_t j, AlignedBuffer& buffer)
+    {
+        if (i == j)
+            return factors[i];
+
+        const std::uint32_t rows = factors[i].Rows();
+        const std::uint32_t columns = factors[j].Columns();
+        const std::size_t stride = LeadingDimension(columns);
+        buffer = pool.Acquire(stride * rows);
+
+        MutableMatrixView product(rows, columns, stride, buffer.Data());
+        Evaluate(i, j, product, false);
+        return product;
+    }
+};
+
+} // namespace
+
+void MultiplyChain(std::span<const MatrixView> factors, MutableMatrixView result,
+                   const MulOptions& options, BufferPool& pool)
+{
+    if (factors.empty()) [[unlikely]]
+        throw MatrixCalcError("Empty chain of matrices");
+
+    std::vector<std::uint32_t> dims;
+    dims.reserve(factors.size() + 1);
+    dims.push_back(factors.front().Rows());
+    for (std::size_t i = 0; i < factors.size(); i++)
+    {
+        if (i > 0)
+            ValidateMulShapes(factors[i - 1], factors[i]);
+        dims.push_back(factors[i].Columns());
+    }
+
+    if (result.Rows() != dims.front() || result.Columns() != dims.back()) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Invalid result shape for chain: ({} x {}) != ({} x {})",
+                                          result.Rows(), result.Columns(), dims.front(), dims.back()));
+    }
+
+    if (factors.size() == 1)
+    {
+        if (!options.epilogue.Trivial()) [[unlikely]]
+            throw MatrixCalcError("Epilogue needs at least two factors in a chain");
+        for (std::uint32_t r = 0; r < result.Rows(); r++)
+            std::copy(factors[0][r].begin(), factors[0][r].end(), result[r].begin());
+        return;
+    }
+
+    const ChainOrder order(dims);
+    ChainEvaluator{ factors, order, options, pool }.Evaluate(0, order.Size() - 1, result, true);
+}
+
+} // namespace matrix_op
@@ -0,0 +1,367 @@
+#include "gemm.hpp"
+#include "kernels.hpp"
+#include "small_gemm.hpp"
+#include "thread_pool.hpp"
+
+#include "matrix_op/parallel.hpp"
+#include "matrix_op/precision.hpp"
+#include "matrix_op/storage.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+namespace matrix_op::detail {
+
+namespace {
+
+// Буферы упаковки (выровненные, чтобы панели начинались с границы кэш-линии)
+// переиспользуются между вызовами в пределах потока
+struct PackBuffers
+{
+    AlignedBuffer a;
+    AlignedBuffer b;
+};
+
+void Reserve(AlignedBuffer& buffer, std::size_t size)
+{
+    if (buffer.Size() < size)
+        buffer = AlignedBuffer(size);
+}
+
+PackBuffers& ThreadPackBuffers(const MicroKernel& kernel)
+{
+    thread_local PackBuffers buffers;
+    // Размеры с запасом на дополнение неполных панелей до MR/NR
+    Reserve(buffers.a, (kernel.mc + kernel.mr) * kernel.kc);
+    Reserve(buffers.b, (kernel.nc + kernel.nr) * kernel.kc);
+    return buffers;
+}
+
+// Расширение элемента до fp32 при упаковке
+float Widen(float value) { return value; }
+float Widen(Float16 value) { return ToFloat(value); }
+float Widen(BFloat16 value) { return ToFloat(value); }
+
+// Упаковка блока op(B) (kc x nc) в панели по nr столбцов: панель - это kc строк по nr элементов подряд.
+// Неполная последняя панель дополняется нулями.
+template<typename T>
+void PackB(std::uint32_t kc, std::uint32_t nc, std::uint32_t panel_nr, BasicOperand<T> b, float* packed)
+{
+    for (std::uint32_t j = 0; j < nc; j += panel_nr)
+    {
+        const std::uint32_t nr = std::min(panel_nr, nc - j);
+        if (!b.trans)
+        {
+            for (std::uint32_t p = 0; p < kc; p++)
+            {
+                const T* src = b.data + p * b.ld + j;
+                std::uint32_t jj = 0;
+                for (; jj < nr; jj++)
+                    packed[jj] = Widen(src[jj]);
+                for (; jj < panel_nr; jj++)
+                    packed[jj] = 0.f;
+                packed += panel_nr;
+            }
+            continue;
+        }
+
+        // Столбец B^T - это строка B: читаем подряд, пишем в панель с шагом panel_nr
+        std::uint32_t jj = 0;
+        for (; jj < nr; jj++)
+        {
+            const T* src = b.data + (j + jj) * b.ld;
+            for (std::uint32_t p = 0; p < kc; p++)
+                packed[p * panel_nr + jj] = Widen(src[p]);
+        }
+        for (; jj < panel_nr; jj++)
+        {
+            for (std::uint32_t p = 0; p < kc; p++)
+                packed[p * panel_nr + jj] = 0.f;
+        }
+        packed += kc * panel_nr;
+    }
+}
+
+// Упаковка блока op(A) (mc x kc) в панели по mr строк: панель - это kc столбцов по mr элементов подряд.
+template<typename T>
+void PackA(std::uint32_t mc, std::uint32_t kc, std::uint32_t panel_mr, BasicOperand<T> a, float* packed)
+{
+    for (std::uint32_t i = 0; i < mc; i += panel_mr)
+    {
+        const std::uint32_t mr = std::min(panel_mr, mc - i);
+        for (std::uint32_t p = 0; p < kc; p++)
+        {
+            std::uint32_t ii = 0;
+            if (!a.trans)
+            {
+                for (; ii < mr; ii++)
+                    packed[ii] = Widen(a.data[(i + ii) * a.ld + p]);
+            }
+            else
+            {
+                // Столбец A^T - это строка A, читается подряд
+                const T* src = a.data + p * a.ld + i;
+                for (; ii < mr; ii++)
+                    packed[ii] = Widen(src[ii]);
+            }
+            for (; ii < panel_mr; ii++)
+                packed[ii] = 0.f;
+            packed += panel_mr;
+        }
+    }
+}
+
+// Проход микроядром по упакованным блокам A (mc x kc) и B (kc x nc)
+void MacroKernel(const MicroKernel& kernel,
+                 std::uint32_t mc, std::uint32_t nc, std::uint32_t kc,
+                 const float* packed_a, const float* packed_b,
+                 float* c, std::size_t ldc, const TileEpilogue& epilogue)
+{
+    for (std::uint32_t j = 0; j < nc; j += kernel.nr)
+    {
+        const std::uint32_t nr = std::min(kernel.nr, nc - j);
+        const float* b_panel = packed_b + j * kc;
+        TileEpilogue tile_epilogue = epilogue;
+        if (tile_epilogue.bias)
+            tile_epilogue.bias += j;
+
+        for (std::uint32_t i = 0; i < mc; i += kernel.mr)
+        {
+            const std::uint32_t mr = std::min(kernel.mr, mc - i);
+            const float* a_panel = packed_a + i * kc;
+            float* c_tile = c + i * ldc + j;
+
+            if (mr == kernel.mr && nr == kernel.nr) [[likely]]
+            {
+                kernel.run(kc, a_panel, b_panel, c_tile, ldc, tile_epilogue);
+                continue;
+            }
+
+            // Краевой тайл: считаем целиком во временный буфер, копируем нужную часть
+            alignas(64) float tmp[MaxKernelMR * MaxKernelNR];
+            kernel.run(kc, a_panel, b_panel, tmp, kernel.nr, {});
+            for (std::uint32_t ii = 0; ii < mr; ii++)
+             for (std::uint32_t jj = 0; jj < nr; jj++)
+                StoreWithEpilogue(tile_epilogue, tmp[ii * kernel.nr + jj], c_tile[ii * ldc + jj], jj);
+        }
+    }
+}
+
+// Последовательное умножение блока - каждая задача параллельного Gemm считает свой
+template<typename T>
+void GemmBlock(const MicroKernel& kernel,
+               std::uint32_t m, std::uint32_t n, std::uint32_t k,
+               BasicOperand<T> a, BasicOperand<T> b,
+               float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    PackBuffers& buffers = ThreadPackBuffers(kernel);
+
+    for (std::uint32_t jc = 0; jc < n; jc += kernel.nc)
+    {
+        const std::uint32_t nc = std::min(kernel.nc, n - jc);
+
+        for (std::uint32_t pc = 0; pc < k; pc += kernel.kc)
+        {
+            const std::uint32_t kc = std::min(kernel.kc, k - pc);
+            PackB(kc, nc, kernel.nr, b.Block(pc, jc), buffers.b.Data());
+
+            for (std::uint32_t ic = 0; ic < m; ic += kernel.mc)
+            {
+                const std::uint32_t mc = std::min(kernel.mc, m - ic);
+                PackA(mc, kc, kernel.mr, a.Block(ic, pc), buffers.a.Data());
+
+                MacroKernel(kernel, mc, nc, kc, buffers.a.Data(), buffers.b.Data(),
+                            c + ic * ldc + jc, ldc, BlockEpilogue(epilogue, pc, kc, k, jc));
+            }
+        }
+    }
+}
+
+std::uint32_t RoundUp(std::uint32_t value, std::uint32_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+std::uint32_t CeilDiv(std::uint32_t value, std::uint32_t divisor)
+{
+    return (value + divisor - 1) / divisor;
+}
+
+// Умножение на B, упакованную заранее: столбцы [j0, j0 + n) из b.n, c и bias эпилога - с j0-го столбца
+void GemmPackedBlock(const MicroKernel& kernel, std::uint32_t m, std::uint32_t j0, std::uint32_t n,
+                     Operand a, const PackedOperand& b, float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    PackBuffers& buffers = ThreadPackBuffers(kernel);
+    const std::size_t full_block = std::size_t(b.k) * RoundUp(kernel.nc, kernel.nr);
+
+    for (std::uint32_t jc = j0; jc < j0 + n;)
+    {
+        // Кусок не выходит за блок упаковки: внутри него панели лежат подряд
+        const std::uint32_t block = jc / kernel.nc;
+        const std::uint32_t block_start = block * kernel.nc;
+        const std::uint32_t block_width = RoundUp(std::min(kernel.nc, b.n - block_start), kernel.nr);
+        const std::uint32_t nc = std::min(block_start + kernel.nc, j0 + n) - jc;
+
+        for (std::uint32_t pc = 0; pc < b.k; pc += kernel.kc)
+        {
+            const std::uint32_t kc = std::min(kernel.kc, b.k - pc);
+            const float* packed_b = b.data + block * full_block + std::size_t(pc) * block_width
+                                  + std::size_t(jc - block_start) * kc;
+
+            for (std::uint32_t ic = 0; ic < m; ic += kernel.mc)
+            {
+                const std::uint32_t mc = std::min(kernel.mc, m - ic);
+                PackA(mc, kc, kernel.mr, a.Block(ic, pc), buffers.a.Data());
+
+                MacroKernel(kernel, mc, nc, kc, buffers.a.Data(), packed_b,
+                            c + ic * ldc + (jc - j0), ldc, BlockEpilogue(epilogue, pc, kc, b.k, jc - j0));
+            }
+        }
+        jc += nc;
+    }
+}
+
+// Нулевая внутренняя размерность: C = epilogue(0)
+void StoreEmpty(std::uint32_t m, std::uint32_t n, float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    const TileEpilogue empty = BlockEpilogue(epilogue, 0, 0, 0);
+    for (std::uint32_t i = 0; i < m; i++)
+     for (std::uint32_t j = 0; j < n; j++)
+        StoreWithEpilogue(empty, 0.f, c[i * ldc + j], j);
+}
+
+// Минимальная сторона тайла при разбиении: меньше - растут накладные расходы на упаковку
+constexpr std::uint32_t MinParallelTile = 64;
+
+// Пул для умножения m x k на k x n или nullptr, если оно не стоит разбиения
+std::shared_ptr<ThreadPool> ParallelPool(std::uint32_t m, std::uint32_t n, std::uint32_t k)
+{
+    const std::uint64_t volume = std::uint64_t(m) * n * k;
+    if (volume < ParallelThreshold() || (m < 2 * MinParallelTile && n < 2 * MinParallelTile))
+        return nullptr;
+
+    std::shared_ptr<ThreadPool> pool = SharedPool();
+    return pool->Threads() > 1 ? pool : nullptr;
+}
+
+// 2D-разбиение C на тайлы, в первую очередь по строкам (B пакуется заново в каждой
+// полосе строк, A - в каждой полосе столбцов). Разбиение по K не делаем: порядок
+// суммирования остается тем же, что и в последовательном варианте - результат
+// совпадает бит в бит при любом числе потоков.
+// Задач с запасом относительно потоков - пул общий на все запросы.
+struct TileGrid
+{
+    std::uint32_t tile_m;
+    std::uint32_t tile_n;
+    std::uint32_t grid_m;
+    std::uint32_t grid_n;
+};
+
+TileGrid SplitTiles(const MicroKernel& kernel, std::uint32_t m, std::uint32_t n, std::size_t threads)
+{
+    const std::uint32_t target_tasks = 2 * threads;
+    TileGrid grid;
+    grid.tile_m = RoundUp(std::max(CeilDiv(m, target_tasks), MinParallelTile), kernel.mr);
+    grid.grid_m = CeilDiv(m, grid.tile_m);
+    const std::uint32_t grid_n_target = std::max(1u, CeilDiv(target_tasks, grid.grid_m));
+    grid.tile_n = RoundUp(std::max(CeilDiv(n, grid_n_target), MinParallelTile), kernel.nr);
+    grid.grid_n = CeilDiv(n, grid.tile_n);
+    return grid;
+}
+
+} // namespace
+
+
+template<typename T>
+void Gemm(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+          BasicOperand<T> a, BasicOperand<T> b,
+          float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    if (m == 0 || n == 0)
+        return;
+    if (k == 0)
+        return StoreEmpty(m, n, c, ldc, epilogue);
+
+    // Маленькие матрицы фиксированных размеров - без упаковки и блокировки
+    if constexpr (std::is_same_v<T, float>)
+    {
+        if (const SmallGemmFn small = FindSmallGemm(m, n, k))
+            return small(a, b, c, ldc, epilogue);
+    }
+
+    const MicroKernel& kernel = ActiveKernel();
+
+    std::shared_ptr<ThreadPool> pool = ParallelPool(m, n, k);
+    if (!pool)
+        return GemmBlock(kernel, m, n, k, a, b, c, ldc, epilogue);
+
+    const TileGrid grid = SplitTiles(kernel, m, n, pool->Threads());
+    pool->ParallelFor(std::size_t(grid.grid_m) * grid.grid_n, [&](std::size_t task)
+    {
+        const std::uint32_t i = task / grid.grid_n * grid.tile_m;
+        const std::uint32_t j = task % grid.grid_n * grid.tile_n;
+        Epilogue tile_epilogue = epilogue;
+        if (tile_epilogue.bias)
+            tile_epilogue.bias += j;
+        GemmBlock(kernel, std::min(grid.tile_m, m - i), std::min(grid.tile_n, n - j), k,
+                  a.Block(i, 0), b.Block(0, j), c + i * ldc + j, ldc, tile_epilogue);
+    });
+}
+
+template void Gemm(std::uint32_t, std::uint32_t, std::uint32_t, BasicOperand<float>, BasicOperand<float>, float*, std::size_t, const Epilogue&);
+template void Gemm(std::uint32_t, std::uint32_t, std::uint32_t, BasicOperand<Float16>, BasicOperand<Float16>, float*, std::size_t, const Epilogue&);
+template void Gemm(std::uint32_t, std::uint32_t, std::uint32_t, BasicOperand<BFloat16>, BasicOperand<BFloat16>, float*, std::size_t, const Epilogue&);
+
+
+
+std::size_t PackedSize(const MicroKernel& kernel, std::uint32_t k, std::uint32_t n)
+{
+    const std::uint32_t full_blocks = n / kernel.nc;
+    const std::uint32_t tail = n % kernel.nc;
+    return std::size_t(k) * (std::size_t(full_blocks) * RoundUp(kernel.nc, kernel.nr) + RoundUp(tail, kernel.nr));
+}
+
+void PackOperand(const MicroKernel& kernel, std::uint32_t k, std::uint32_t n, Operand b, float* packed)
+{
+    for (std::uint32_t jc = 0; jc < n; jc += kernel.nc)
+    {
+        const std::uint32_t nc = std::min(kernel.nc, n - jc);
+        for (std::uint32_t pc = 0; pc < k; pc += kernel.kc)
+        {
+            const std::uint32_t kc = std::min(kernel.kc, k - pc);
+            PackB(kc, nc, kernel.nr, b.Block(pc, jc), packed);
+            packed += std::size_t(kc) * RoundUp(nc, kernel.nr);
+        }
+    }
+}
+
+void GemmPacked(std::uint32_t m, Operand a, const PackedOperand& b,
+                float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    const std::uint32_t n = b.n;
+    if (m == 0 || n == 0)
+        return;
+    if (b.k == 0)
+        return StoreEmpty(m, n, c, ldc, epilogue);
+
+    const MicroKernel& kernel = *b.kernel;
+
+    std::shared_ptr<ThreadPool> pool = ParallelPool(m, n, b.k);
+    if (!pool)
+        return GemmPackedBlock(kernel, m, 0, n, a, b, c, ldc, epilogue);
+
+    // Тайлы как в Gemm, но упакованная B общая для всех и не пакуется заново
+    const TileGrid grid = SplitTiles(kernel, m, n, pool->Threads());
+    pool->ParallelFor(std::size_t(grid.grid_m) * grid.grid_n, [&](std::size_t task)
+    {
+        const std::uint32_t i = task / grid.grid_n * grid.tile_m;
+        const std::uint32_t j = task % grid.grid_n * grid.tile_n;
+        Epilogue tile_epilogue = epilogue;
+        if (tile_epilogue.bias)
+            tile_epilogue.bias += j;
+        GemmPackedBlock(kernel, std::min(grid.tile_m, m - i), j, std::min(grid.tile_n, n - j),
+                        a.Block(i, 0), b, c + i * ldc + j, ldc, tile_epilogue);
+    });
+}
+
+} // namespace matrix_op::detail
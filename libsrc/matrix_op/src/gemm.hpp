@@ -0,0 +1,104 @@
+#pragma once
+
+#include "kernels.hpp"
+
+#include "matrix_op/epilogue.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace matrix_op::detail {
+
+// Операнд умножения op(X): row-major матрица X с шагом строк ld или, если trans, X^T.
+// Транспонирование не материализуется - его поглощает упаковка панелей в Gemm.
+template<typename T>
+struct BasicOperand
+{
+    const T* data;
+    std::size_t ld;
+    bool trans = false;
+
+    // Элемент op(X)[i][j]
+    const T& At(std::size_t i, std::size_t j) const { return trans ? data[j * ld + i] : data[i * ld + j]; }
+    // Подматрица op(X) с началом в (i, j)
+    BasicOperand Block(std::size_t i, std::size_t j) const { return { &At(i, j), ld, trans }; }
+};
+
+using Operand = BasicOperand<float>;
+
+// Блочное умножение C = A * B (схема Goto/BLIS):
+//  - B упаковывается в панели шириной NR столбцов, A - в панели высотой MR строк;
+//  - блоки KC x NC (B), MC x KC (A) подобраны под L1/L2/L3;
+//  - внутренний цикл - микроядро MR x NR, держащее кусок C в регистрах.
+// Микроядро и параметры блокировки берутся из ActiveKernel() (см. kernels.hpp).
+// Порядок суммирования фиксирован параметрами блокировки, поэтому результат
+// детерминирован (бит в бит) для одной и той же сборки и одного ядра (ISA).
+// Большие произведения (см. ParallelThreshold()) режутся на 2D-тайлы C и считаются
+// в общем пуле потоков, на результат это не влияет.
+//
+// C = op(A) * op(B): m x k на k x n. Все четыре варианта (NN, NT, TN, TT) идут через
+// одни и те же микроядра, отличается только упаковка.
+// T - float, Float16 или BFloat16: элементы пониженной точности расширяются до fp32
+// при упаковке, так что из памяти читается вдвое меньше, а считают те же fp32-микроядра.
+// fp32-произведения маленьких фиксированных размеров (см. small_gemm.hpp) идут мимо
+// всего этого в ядра, специализированные на этапе компиляции.
+// C row-major, ldc - шаг между строками в элементах. C = epilogue(op(A) * op(B)), эпилог
+// применяется микроядром при записи тайла (см. TileEpilogue); без beta C только пишется.
+template<typename T>
+void Gemm(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+          BasicOperand<T> a, BasicOperand<T> b,
+          float* c, std::size_t ldc, const Epilogue& epilogue = {});
+
+// op(B) (k x n), упакованная целиком заранее ядром kernel (см. PackedMatrix): блоки столбцов
+// [jc, jc + NC) идут подряд, внутри каждого - его блоки K в порядке pc, упакованные как в Gemm
+// (панели по NR столбцов). Повторные умножения на такой B идут без упаковки B.
+struct PackedOperand
+{
+    const MicroKernel* kernel;
+    std::uint32_t k;
+    std::uint32_t n;
+    const float* data;
+};
+
+// Размер упаковки op(B) (k x n) в элементах
+std::size_t PackedSize(const MicroKernel& kernel, std::uint32_t k, std::uint32_t n);
+void PackOperand(const MicroKernel& kernel, std::uint32_t k, std::uint32_t n, Operand b, float* packed);
+
+// C = epilogue(op(A) * B) для заранее упакованной B: m x b.k на b.k x b.n. Блокировка,
+// разбиение между потоками и порядок суммирования - как в Gemm с ядром b.kernel.
+void GemmPacked(std::uint32_t m, Operand a, const PackedOperand& b,
+                float* c, std::size_t ldc, const Epilogue& epilogue = {});
+
+// C = epilogue(scale * op(A) * op(B)) для int8: из элементов при упаковке вычитается zero_point,
+// произведения копятся в int32 внутри блока K (переполнения нет, см. Int8MicroKernel)
+// и масштабируются в fp32 при сложении в C.
+void GemmInt8(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+              BasicOperand<std::int8_t> a, std::int32_t a_zero_point,
+              BasicOperand<std::int8_t> b, std::int32_t b_zero_point,
+              float scale, float* c, std::size_t ldc, const Epilogue& epilogue = {});
+
+// Эпилог тайла для блока K [pc, pc + kc) из k, bias - с column-го столбца
+inline TileEpilogue BlockEpilogue(const Epilogue& epilogue, std::uint32_t pc, std::uint32_t kc, std::uint32_t k,
+                                  std::uint32_t column = 0)
+{
+    const bool last = pc + kc >= k;
+    return { epilogue.alpha,
+             pc == 0 ? epilogue.beta : 1.f,
+             last && epilogue.bias ? epilogue.bias + column : nullptr,
+             last && epilogue.activation == Activation::Relu };
+}
+
+// Запись одного элемента по эпилогу - для краевых тайлов и ядер без SIMD-эпилога
+inline void StoreWithEpilogue(const TileEpilogue& epilogue, float value, float& dst, std::uint32_t column)
+{
+    value *= epilogue.alpha;
+    if (epilogue.beta != 0)
+        value += epilogue.beta * dst;
+    if (epilogue.bias)
+        value += epilogue.bias[column];
+    if (epilogue.relu && !(value > 0))
+        value = 0;
+    dst = value;
+}
+
+} // namespace matrix_op::detail
@@ -0,0 +1,179 @@
+#include "gemm.hpp"
+#include "kernels.hpp"
+#include "thread_pool.hpp"
+
+#include "matrix_op/parallel.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace matrix_op::detail {
+
+namespace {
+
+// Блокировка по M и N; по K блок - Int8KC (ограничен переполнением int32)
+constexpr std::uint32_t Int8MC = 96;
+constexpr std::uint32_t Int8NC = 2048;
+
+struct Int8PackBuffers
+{
+    std::vector<std::int16_t> a;
+    std::vector<std::int16_t> b;
+};
+
+Int8PackBuffers& ThreadInt8PackBuffers(const Int8MicroKernel& kernel)
+{
+    thread_local Int8PackBuffers buffers;
+    // Размеры с запасом на дополнение неполных панелей до MR/NR
+    buffers.a.resize(std::max<std::size_t>(buffers.a.size(), (Int8MC + kernel.mr) * Int8KC));
+    buffers.b.resize(std::max<std::size_t>(buffers.b.size(), (Int8NC + kernel.nr) * Int8KC));
+    return buffers;
+}
+
+// Блок op(B) (kc x nc) в панели по nr столбцов из пар по k (см. Int8MicroKernelFn).
+// Из элементов вычитается zero_point, при нечетном kc последняя пара дополняется нулем.
+void PackInt8B(std::uint32_t kc, std::uint32_t nc, std::uint32_t panel_nr,
+               BasicOperand<std::int8_t> b, std::int32_t zero_point, std::int16_t* packed)
+{
+    for (std::uint32_t j = 0; j < nc; j += panel_nr)
+    {
+        const std::uint32_t nr = std::min(panel_nr, nc - j);
+        for (std::uint32_t p = 0; p < kc; p += 2)
+        {
+            std::uint32_t jj = 0;
+            for (; jj < nr; jj++)
+            {
+                packed[2 * jj] = std::int16_t(b.At(p, j + jj) - zero_point);
+                packed[2 * jj + 1] = p + 1 < kc ? std::int16_t(b.At(p + 1, j + jj) - zero_point) : 0;
+            }
+            for (; jj < panel_nr; jj++)
+                packed[2 * jj] = packed[2 * jj + 1] = 0;
+            packed += 2 * panel_nr;
+        }
+    }
+}
+
+// Блок op(A) (mc x kc) в панели по mr строк из пар по k
+void PackInt8A(std::uint32_t mc, std::uint32_t kc, std::uint32_t panel_mr,
+               BasicOperand<std::int8_t> a, std::int32_t zero_point, std::int16_t* packed)
+{
+    for (std::uint32_t i = 0; i < mc; i += panel_mr)
+    {
+        const std::uint32_t mr = std::min(panel_mr, mc - i);
+        for (std::uint32_t p = 0; p < kc; p += 2)
+        {
+            std::uint32_t ii = 0;
+            for (; ii < mr; ii++)
+            {
+                packed[2 * ii] = std::int16_t(a.At(i + ii, p) - zero_point);
+                packed[2 * ii + 1] = p + 1 < kc ? std::int16_t(a.At(i + ii, p + 1) - zero_point) : 0;
+            }
+            for (; ii < panel_mr; ii++)
+                packed[2 * ii] = packed[2 * ii + 1] = 0;
+            packed += 2 * panel_mr;
+        }
+    }
+}
+
+void Int8MacroKernel(const Int8MicroKernel& kernel,
+                     std::uint32_t mc, std::uint32_t nc, std::uint32_t kc,
+                     const std::int16_t* packed_a, const std::int16_t* packed_b,
+                     float scale, float* c, std::size_t ldc, const TileEpilogue& epilogue)
+{
+    const std::uint32_t kc2 = (kc + 1) / 2;
+    for (std::uint32_t j = 0; j < nc; j += kernel.nr)
+    {
+        const std::uint32_t nr = std::min(kernel.nr, nc - j);
+        const std::int16_t* b_panel = packed_b + std::size_t(j) * 2 * kc2;
+
+        for (std::uint32_t i = 0; i < mc; i += kernel.mr)
+        {
+            const std::uint32_t mr = std::min(kernel.mr, mc - i);
+            const std::int16_t* a_panel = packed_a + std::size_t(i) * 2 * kc2;
+
+            // Целочисленная сумма блока точна, в fp32 переводится только она
+            alignas(64) std::int32_t tmp[MaxInt8KernelMR * MaxInt8KernelNR];
+            kernel.run(kc2, a_panel, b_panel, tmp);
+
+            float* c_tile = c + i * ldc + j;
+            for (std::uint32_t ii = 0; ii < mr; ii++)
+             for (std::uint32_t jj = 0; jj < nr; jj++)
+                StoreWithEpilogue(epilogue, scale * float(tmp[ii * kernel.nr + jj]), c_tile[ii * ldc + jj], j + jj);
+        }
+    }
+}
+
+void GemmInt8Block(const Int8MicroKernel& kernel,
+                   std::uint32_t m, std::uint32_t n, std::uint32_t k,
+                   BasicOperand<std::int8_t> a, std::int32_t a_zero_point,
+                   BasicOperand<std::int8_t> b, std::int32_t b_zero_point,
+                   float scale, float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    Int8PackBuffers& buffers = ThreadInt8PackBuffers(kernel);
+
+    for (std::uint32_t jc = 0; jc < n; jc += Int8NC)
+    {
+        const std::uint32_t nc = std::min(Int8NC, n - jc);
+
+        for (std::uint32_t pc = 0; pc < k; pc += Int8KC)
+        {
+            const std::uint32_t kc = std::min(Int8KC, k - pc);
+            PackInt8B(kc, nc, kernel.nr, b.Block(pc, jc), b_zero_point, buffers.b.data());
+
+            for (std::uint32_t ic = 0; ic < m; ic += Int8MC)
+            {
+                const std::uint32_t mc = std::min(Int8MC, m - ic);
+                PackInt8A(mc, kc, kernel.mr, a.Block(ic, pc), a_zero_point, buffers.a.data());
+
+                Int8MacroKernel(kernel, mc, nc, kc, buffers.a.data(), buffers.b.data(),
+                                scale, c + ic * ldc + jc, ldc, BlockEpilogue(epilogue, pc, kc, k, jc));
+            }
+        }
+    }
+}
+
+// Минимальная высота полосы строк при разбиении между потоками
+constexpr std::uint32_t MinParallelRows = 64;
+
+} // namespace
+
+
+void GemmInt8(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+              BasicOperand<std::int8_t> a, std::int32_t a_zero_point,
+              BasicOperand<std::int8_t> b, std::int32_t b_zero_point,
+              float scale, float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    if (m == 0 || n == 0)
+        return;
+    if (k == 0)
+    {
+        const TileEpilogue empty = BlockEpilogue(epilogue, 0, 0, 0);
+        for (std::uint32_t i = 0; i < m; i++)
+         for (std::uint32_t j = 0; j < n; j++)
+            StoreWithEpilogue(empty, 0.f, c[i * ldc + j], j);
+        return;
+    }
+
+    const Int8MicroKernel& kernel = ActiveInt8Kernel();
+
+    const std::uint64_t volume = std::uint64_t(m) * n * k;
+    std::shared_ptr<ThreadPool> pool;
+    if (volume >= ParallelThreshold() && m >= 2 * MinParallelRows)
+        pool = SharedPool();
+    if (!pool || pool->Threads() == 1)
+        return GemmInt8Block(kernel, m, n, k, a, a_zero_point, b, b_zero_point, scale, c, ldc, epilogue);
+
+    // Только полосы строк: B пакуется в каждой заново, но int8-операнды вчетверо меньше fp32
+    const std::uint32_t rows_per_task = std::max(MinParallelRows, (m + 2 * pool->Threads() - 1) / (2 * pool->Threads()));
+    const std::uint32_t tile_m = (rows_per_task + kernel.mr - 1) / kernel.mr * kernel.mr;
+    const std::uint32_t tasks = (m + tile_m - 1) / tile_m;
+
+    pool->ParallelFor(tasks, [&](std::size_t task)
+    {
+        const std::uint32_t i = task * tile_m;
+        GemmInt8Block(kernel, std::min(tile_m, m - i), n, k,
+                      a.Block(i, 0), a_zero_point, b, b_zero_point, scale, c + i * ldc, ldc, epilogue);
+    });
+}
+
+} // namespace matrix_op::detail
@@ -0,0 +1,124 @@
+#include "matrix_op/isa.hpp"
+#include "matrix_op/matrix_exception.hpp"
+
+#include "kernels.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <format>
+
+namespace matrix_op {
+
+namespace {
+
+const detail::MicroKernel& KernelFor(Isa isa)
+{
+    switch (isa)
+    {
+#ifdef MATRIX_OP_X86_KERNELS
+        case Isa::Avx512: return detail::Avx512Kernel;
+        case Isa::Avx2:   return detail::Avx2Kernel;
+#endif
+        default:          return detail::ScalarKernel;
+    }
+}
+
+Isa Detect()
+{
+#ifdef MATRIX_OP_X86_KERNELS
+    // __builtin_cpu_supports учитывает и поддержку состояния регистров ОС (XGETBV)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return Isa::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return Isa::Avx2;
+#endif
+    return Isa::Scalar;
+}
+
+Isa InitialIsa()
+{
+    Isa isa = DetectedIsa();
+    Isa requested;
+    if (const char* env = std::getenv("MATRIX_OP_ISA"); env && ParseIsa(env, requested) && IsaSupported(requested))
+        isa = requested;
+    return isa;
+}
+
+std::atomic<const detail::MicroKernel*>& ActiveKernelPtr()
+{
+    static std::atomic<const detail::MicroKernel*> kernel = &KernelFor(InitialIsa());
+    return kernel;
+}
+
+} // namespace
+
+
+std::string_view IsaName(Isa isa)
+{
+    switch (isa)
+    {
+        case Isa::Scalar: return "scalar";
+        case Isa::Avx2:   return "avx2";
+        case Isa::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+bool ParseIsa(std::string_view name, Isa& isa)
+{
+    for (Isa candidate : { Isa::Scalar, Isa::Avx2, Isa::Avx512 })
+    {
+        if (IsaName(candidate) == name)
+        {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+Isa DetectedIsa()
+{
+    static const Isa detected = Detect();
+    return detected;
+}
+
+bool IsaSupported(Isa isa)
+{
+    return static_cast<std::uint8_t>(isa) <= static_cast<std::uint8_t>(DetectedIsa());
+}
+
+Isa ActiveIsa()
+{
+    return ActiveKernelPtr().load(std::memory_order_relaxed)->isa;
+}
+
+void ForceIsa(Isa isa)
+{
+    if (!IsaSupported(isa)) [[unlikely]]
+        throw MatrixCalcError(std::format("ISA '{}' is not supported on this host (best: '{}')", IsaName(isa), IsaName(DetectedIsa())));
+
+    ActiveKernelPtr().store(&KernelFor(isa), std::memory_order_relaxed);
+}
+
+
+namespace detail {
+
+const MicroKernel& ActiveKernel()
+{
+    return *ActiveKernelPtr().load(std::memory_order_relaxed);
+}
+
+const Int8MicroKernel& ActiveInt8Kernel()
+{
+#ifdef MATRIX_OP_X86_KERNELS
+    if (ActiveIsa() != Isa::Scalar)
+        return Avx2Int8Kernel;
+#endif
+    return ScalarInt8Kernel;
+}
+
+} // namespace detail
+
+} // namespace matrix_op
@@ -0,0 +1,104 @@
+// Собирается с -mavx2 -mfma, вызывается только после проверки CPUID
+#include "kernels.hpp"
+
+#include <immintrin.h>
+
+namespace matrix_op::detail {
+
+namespace {
+
+constexpr std::uint32_t MR = 6;
+constexpr std::uint32_t NR = 16;
+
+// 6 x 16: 12 аккумуляторов ymm + 2 под строку B + 1 под broadcast A
+void Avx2MicroKernel(std::uint32_t kc, const float* a, const float* b, float* c, std::size_t ldc, const TileEpilogue& epilogue)
+{
+    __m256 acc[MR][2];
+#pragma GCC unroll 6
+    for (std::uint32_t i = 0; i < MR; i++)
+        acc[i][0] = acc[i][1] = _mm256_setzero_ps();
+
+    for (std::uint32_t p = 0; p < kc; p++)
+    {
+        const __m256 b0 = _mm256_loadu_ps(b);
+        const __m256 b1 = _mm256_loadu_ps(b + 8);
+#pragma GCC unroll 6
+        for (std::uint32_t i = 0; i < MR; i++)
+        {
+            const __m256 av = _mm256_broadcast_ss(a + i);
+            acc[i][0] = _mm256_fmadd_ps(av, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(av, b1, acc[i][1]);
+        }
+        a += MR;
+        b += NR;
+    }
+
+    const __m256 alpha = _mm256_set1_ps(epilogue.alpha);
+    const __m256 beta = _mm256_set1_ps(epilogue.beta);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 bias0 = epilogue.bias ? _mm256_loadu_ps(epilogue.bias) : zero;
+    const __m256 bias1 = epilogue.bias ? _mm256_loadu_ps(epilogue.bias + 8) : zero;
+
+#pragma GCC unroll 6
+    for (std::uint32_t i = 0; i < MR; i++)
+    {
+        float* row = c + i * ldc;
+        __m256 r0 = _mm256_mul_ps(alpha, acc[i][0]);
+        __m256 r1 = _mm256_mul_ps(alpha, acc[i][1]);
+        if (epilogue.beta != 0)
+        {
+            r0 = _mm256_fmadd_ps(beta, _mm256_loadu_ps(row), r0);
+            r1 = _mm256_fmadd_ps(beta, _mm256_loadu_ps(row + 8), r1);
+        }
+        r0 = _mm256_add_ps(r0, bias0);
+        r1 = _mm256_add_ps(r1, bias1);
+        if (epilogue.relu)
+        {
+            r0 = _mm256_max_ps(r0, zero);
+            r1 = _mm256_max_ps(r1, zero);
+        }
+        _mm256_storeu_ps(row, r0);
+        _mm256_storeu_ps(row + 8, r1);
+    }
+}
+
+// int8 6 x 16: vpmaddwd перемножает пары int16 по k и складывает их в int32.
+// 12 аккумуляторов + 2 под пары строки B + 1 под broadcast пары A
+void Avx2Int8MicroKernel(std::uint32_t kc2, const std::int16_t* a, const std::int16_t* b, std::int32_t* c)
+{
+    __m256i acc[MR][2];
+#pragma GCC unroll 6
+    for (std::uint32_t i = 0; i < MR; i++)
+        acc[i][0] = acc[i][1] = _mm256_setzero_si256();
+
+    for (std::uint32_t p = 0; p < kc2; p++)
+    {
+        const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 16));
+#pragma GCC unroll 6
+        for (std::uint32_t i = 0; i < MR; i++)
+        {
+            std::int32_t pair;
+            __builtin_memcpy(&pair, a + 2 * i, sizeof(pair));
+            const __m256i av = _mm256_set1_epi32(pair);
+            acc[i][0] = _mm256_add_epi32(acc[i][0], _mm256_madd_epi16(av, b0));
+            acc[i][1] = _mm256_add_epi32(acc[i][1], _mm256_madd_epi16(av, b1));
+        }
+        a += 2 * MR;
+        b += 2 * NR;
+    }
+
+#pragma GCC unroll 6
+    for (std::uint32_t i = 0; i < MR; i++)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + i * NR), acc[i][0]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + i * NR + 8), acc[i][1]);
+    }
+}
+
+} // namespace
+
+const MicroKernel Avx2Kernel = { Isa::Avx2, MR, NR, 144, 256, 4096, &Avx2MicroKernel };
+const Int8MicroKernel Avx2Int8Kernel = { Isa::Avx2, MR, NR, &Avx2Int8MicroKernel };
+
+} // namespace matrix_op::detail
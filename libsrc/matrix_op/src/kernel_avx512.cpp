@@ -0,0 +1,70 @@
+// Собирается с -mavx512f -mfma, вызывается только после проверки CPUID
+#include "kernels.hpp"
+
+#include <immintrin.h>
+
+namespace matrix_op::detail {
+
+namespace {
+
+constexpr std::uint32_t MR = 12;
+constexpr std::uint32_t NR = 32;
+
+// 12 x 32: 24 аккумулятора zmm + 2 под строку B + broadcast A (из 32 регистров)
+void Avx512MicroKernel(std::uint32_t kc, const float* a, const float* b, float* c, std::size_t ldc, const TileEpilogue& epilogue)
+{
+    __m512 acc[MR][2];
+#pragma GCC unroll 12
+    for (std::uint32_t i = 0; i < MR; i++)
+        acc[i][0] = acc[i][1] = _mm512_setzero_ps();
+
+    for (std::uint32_t p = 0; p < kc; p++)
+    {
+        const __m512 b0 = _mm512_loadu_ps(b);
+        const __m512 b1 = _mm512_loadu_ps(b + 16);
+#pragma GCC unroll 12
+        for (std::uint32_t i = 0; i < MR; i++)
+        {
+            const __m512 av = _mm512_set1_ps(a[i]);
+            acc[i][0] = _mm512_fmadd_ps(av, b0, acc[i][0]);
+            acc[i][1] = _mm512_fmadd_ps(av, b1, acc[i][1]);
+        }
+        a += MR;
+        b += NR;
+    }
+
+    const __m512 alpha = _mm512_set1_ps(epilogue.alpha);
+    const __m512 beta = _mm512_set1_ps(epilogue.beta);
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 bias0 = epilogue.bias ? _mm512_loadu_ps(epilogue.bias) : zero;
+    const __m512 bias1 = epilogue.bias ? _mm512_loadu_ps(epilogue.bias + 16) : zero;
+
+#pragma GCC unroll 12
+    for (std::uint32_t i = 0; i < MR; i++)
+    {
+        float* row = c + i * ldc;
+        __m512 r0 = _mm512_mul_ps(alpha, acc[i][0]);
+        __m512 r1 = _mm512_mul_ps(alpha, acc[i][1]);
+        if (epilogue.beta != 0)
+        {
+            r0 = _mm512_fmadd_ps(beta, _mm512_loadu_ps(row), r0);
+            r1 = _mm512_fmadd_ps(beta, _mm512_loadu_ps(row + 16), r1);
+        }
+        r0 = _mm512_add_ps(r0, bias0);
+        r1 = _mm512_add_ps(r1, bias1);
+        if (epilogue.relu)
+        {
+            // maskz-вариант: _mm512_max_ps в GCC 12 дает ложное maybe-uninitialized
+            r0 = _mm512_maskz_max_ps(0xFFFF, r0, zero);
+            r1 = _mm512_maskz_max_ps(0xFFFF, r1, zero);
+        }
+        _mm512_storeu_ps(row, r0);
+        _mm512_storeu_ps(row + 16, r1);
+    }
+}
+
+} // namespace
+
+const MicroKernel Avx512Kernel = { Isa::Avx512, MR, NR, 144, 256, 4096, &Avx512MicroKernel };
+
+} // namespace matrix_op::detail
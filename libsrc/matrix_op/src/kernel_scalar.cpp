@@ -0,0 +1,65 @@
+#include "kernels.hpp"
+
+namespace matrix_op::detail {
+
+namespace {
+
+constexpr std::uint32_t MR = 4;
+constexpr std::uint32_t NR = 8;
+
+void ScalarMicroKernel(std::uint32_t kc, const float* a, const float* b, float* c, std::size_t ldc, const TileEpilogue& epilogue)
+{
+    float acc[MR][NR] = {};
+    for (std::uint32_t p = 0; p < kc; p++)
+    {
+        for (std::uint32_t i = 0; i < MR; i++)
+        {
+            const float av = a[i];
+            for (std::uint32_t j = 0; j < NR; j++)
+                acc[i][j] += av * b[j];
+        }
+        a += MR;
+        b += NR;
+    }
+
+    for (std::uint32_t i = 0; i < MR; i++)
+     for (std::uint32_t j = 0; j < NR; j++)
+    {
+        float value = epilogue.alpha * acc[i][j];
+        if (epilogue.beta != 0)
+            value += epilogue.beta * c[i * ldc + j];
+        if (epilogue.bias)
+            value += epilogue.bias[j];
+        if (epilogue.relu && !(value > 0))
+            value = 0;
+        c[i * ldc + j] = value;
+    }
+}
+
+void ScalarInt8MicroKernel(std::uint32_t kc2, const std::int16_t* a, const std::int16_t* b, std::int32_t* c)
+{
+    std::int32_t acc[MR][NR] = {};
+    for (std::uint32_t p = 0; p < kc2; p++)
+    {
+        for (std::uint32_t i = 0; i < MR; i++)
+        {
+            const std::int32_t a0 = a[2 * i];
+            const std::int32_t a1 = a[2 * i + 1];
+            for (std::uint32_t j = 0; j < NR; j++)
+                acc[i][j] += a0 * b[2 * j] + a1 * b[2 * j + 1];
+        }
+        a += 2 * MR;
+        b += 2 * NR;
+    }
+
+    for (std::uint32_t i = 0; i < MR; i++)
+     for (std::uint32_t j = 0; j < NR; j++)
+        c[i * NR + j] = acc[i][j];
+}
+
+} // namespace
+
+const MicroKernel ScalarKernel = { Isa::Scalar, MR, NR, 128, 256, 4096, &ScalarMicroKernel };
+const Int8MicroKernel ScalarInt8Kernel = { Isa::Scalar, MR, NR, &ScalarInt8MicroKernel };
+
+} // namespace matrix_op::detail
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "matrix_op/epilogue.hpp"
+#include "matrix_op/isa_kind.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// ВНИМАНИЕ: заголовок подключается в единицы трансляции, собранные с -mavx2/-mavx512f,
+// поэтому не должен тянуть inline-код стандартной библиотеки (иначе линковщик может
+// выбрать его AVX-версию для всей программы).
+
+namespace matrix_op::detail {
+
+// Запись тайла микроядром: C = act(alpha * AB + beta * C + bias), где AB - сумма по панелям.
+// Блочное умножение задает его по блокам K: первый блок - beta эпилога (0 - C не читается),
+// следующие - beta = 1; bias и активация - только в последнем.
+struct TileEpilogue
+{
+    float alpha = 1;
+    float beta = 0;
+    const float* bias = nullptr; // nr элементов - столбцы тайла
+    bool relu = false;
+};
+
+// Микроядро: C[mr x nr] = epilogue(A_panel * B_panel), где
+//  - A_panel - kc столбцов по mr элементов подряд,
+//  - B_panel - kc строк по nr элементов подряд.
+// Сумма копится с нуля в регистрах и сводится с C только в конце, так что полный
+// и краевой тайл считаются одинаково.
+using MicroKernelFn = void (*)(std::uint32_t kc, const float* a, const float* b,
+                               float* c, std::size_t ldc, const TileEpilogue& epilogue);
+
+struct MicroKernel
+{
+    Isa isa;
+    std::uint32_t mr;
+    std::uint32_t nr;
+
+    // Блокировка под кэши: MC x KC блок A ~ L2, KC x NR панель B ~ L1, KC x NC блок B ~ L3
+    std::uint32_t mc;
+    std::uint32_t kc;
+    std::uint32_t nc;
+
+    MicroKernelFn run;
+};
+
+inline constexpr std::uint32_t MaxKernelMR = 12;
+inline constexpr std::uint32_t MaxKernelNR = 32;
+
+extern const MicroKernel ScalarKernel;
+#ifdef MATRIX_OP_X86_KERNELS
+extern const MicroKernel Avx2Kernel;
+extern const MicroKernel Avx512Kernel;
+#endif
+
+// Ядро, выбранное для текущего процесса (см. ActiveIsa())
+const MicroKernel& ActiveKernel();
+
+
+// int8-микроядро: C[mr x nr] = A_panel * B_panel в int32, C - плотный тайл (перезаписывается).
+// Значения (q - zero_point) лежат в панелях как int16 парами по k:
+//  - A_panel - kc2 групп по mr пар: (i, 2p), (i, 2p + 1),
+//  - B_panel - kc2 групп по nr пар: (2p, j), (2p + 1, j).
+// |q - zero_point| <= 255, поэтому сумма по блоку до Int8KC значений k помещается в int32.
+using Int8MicroKernelFn = void (*)(std::uint32_t kc2, const std::int16_t* a, const std::int16_t* b, std::int32_t* c);
+
+struct Int8MicroKernel
+{
+    Isa isa;
+    std::uint32_t mr;
+    std::uint32_t nr;
+
+    Int8MicroKernelFn run;
+};
+
+inline constexpr std::uint32_t Int8KC = 256; // 256 * 255 * 255 < 2^31
+inline constexpr std::uint32_t MaxInt8KernelMR = 6;
+inline constexpr std::uint32_t MaxInt8KernelNR = 16;
+
+extern const Int8MicroKernel ScalarInt8Kernel;
+#ifdef MATRIX_OP_X86_KERNELS
+extern const Int8MicroKernel Avx2Int8Kernel;
+#endif
+
+// int8-ядро для текущего ActiveIsa(): отдельного AVX-512 варианта нет (нужен AVX512BW),
+// на таких процессорах используется AVX2
+const Int8MicroKernel& ActiveInt8Kernel();
+
+} // namespace matrix_op::detail
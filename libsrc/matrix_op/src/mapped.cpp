@@ -0,0 +1,340 @@
+#include "matrix_op/mapped.hpp"
+#include "matrix_op/matrix.hpp"
+#include "matrix_op/matrix_exception.hpp"
+
+#include "gemm.hpp"
+#include "kernels.hpp"
+
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <utility>
+
+namespace matrix_op {
+
+namespace {
+
+MatrixCalcError SystemError(std::string_view action, const std::string& path)
+{
+    return MatrixCalcError(std::format("{} '{}': {}", action, path, std::strerror(errno)));
+}
+
+// Открывает path внутри root (см. MappedMatrix) или, если root пуст, как обычно
+int OpenIn(const std::string& root, const std::string& path, int flags, mode_t mode = 0)
+{
+    if (root.empty())
+        return open(path.c_str(), flags, mode);
+
+    const int root_fd = open(root.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) [[unlikely]]
+        return -1;
+    open_how how = {};
+    how.flags = flags;
+    how.mode = mode;
+    how.resolve = RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS;
+    const int fd = int(syscall(SYS_openat2, root_fd, path.c_str(), &how, sizeof(how)));
+    const int saved_errno = errno;
+    close(root_fd);
+    errno = saved_errno;
+    return fd;
+}
+
+std::size_t FileSize(std::uint32_t rows, std::uint32_t columns)
+{
+    return sizeof(MappedMatrixHeader) + std::size_t(rows) * columns * sizeof(float);
+}
+
+// Подсказка ОС о диапазоне [begin, end) отображения. WILLNEED расширяется до целых страниц,
+// DONTNEED - только целые страницы внутри, чтобы не отпустить соседние нужные данные.
+// Ошибки не важны: это только подсказка
+void Advise(const float* begin, const float* end, int advice)
+{
+    static const std::uintptr_t page = sysconf(_SC_PAGESIZE);
+    std::uintptr_t from = reinterpret_cast<std::uintptr_t>(begin);
+    std::uintptr_t to = reinterpret_cast<std::uintptr_t>(end);
+    if (advice == MADV_DONTNEED)
+    {
+        from = (from + page - 1) / page * page;
+        to = to / page * page;
+    }
+    else
+    {
+        from = from / page * page;
+        to = (to + page - 1) / page * page;
+    }
+    if (from < to)
+        madvise(reinterpret_cast<void*>(from), to - from, advice);
+}
+
+} // namespace
+
+
+MappedMatrix::MappedMatrix(int fd, bool writable)
+    : fd_(fd), writable_(writable)
+{}
+
+MappedMatrix::MappedMatrix(MappedMatrix&& another) noexcept
+    : fd_(std::exchange(another.fd_, -1)),
+      mapping_(std::exchange(another.mapping_, nullptr)),
+      size_(std::exchange(another.size_, 0)),
+      writable_(another.writable_),
+      rows_(another.rows_),
+      columns_(another.columns_),
+      file_dev_(another.file_dev_),
+      file_ino_(another.file_ino_),
+      dir_fd_(std::exchange(another.dir_fd_, -1)),
+      temp_name_(std::move(another.temp_name_)),
+      name_(std::move(another.name_))
+{
+    another.temp_name_.clear();
+}
+
+MappedMatrix& MappedMatrix::operator=(MappedMatrix&& another) noexcept
+{
+    if (this != &another)
+    {
+        Close();
+        fd_ = std::exchange(another.fd_, -1);
+        mapping_ = std::exchange(another.mapping_, nullptr);
+        size_ = std::exchange(another.size_, 0);
+        writable_ = another.writable_;
+        rows_ = another.rows_;
+        columns_ = another.columns_;
+        file_dev_ = another.file_dev_;
+        file_ino_ = another.file_ino_;
+        dir_fd_ = std::exchange(another.dir_fd_, -1);
+        temp_name_ = std::exchange(another.temp_name_, {});
+        name_ = std::move(another.name_);
+    }
+    return *this;
+}
+
+MappedMatrix::~MappedMatrix()
+{
+    Close();
+}
+
+void MappedMatrix::Close()
+{
+    if (mapping_)
+        munmap(mapping_, size_);
+    if (fd_ >= 0)
+        close(fd_);
+    // Созданная без Commit: недописанный результат не остается на диске
+    if (!temp_name_.empty())
+        unlinkat(dir_fd_, temp_name_.c_str(), 0);
+    if (dir_fd_ >= 0)
+        close(dir_fd_);
+    mapping_ = nullptr;
+    fd_ = -1;
+    dir_fd_ = -1;
+    temp_name_.clear();
+}
+
+void MappedMatrix::Map(const std::string& path, std::size_t size)
+{
+    void* mapping = mmap(nullptr, size, writable_ ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) [[unlikely]]
+        throw SystemError("Cannot map matrix file", path);
+    mapping_ = mapping;
+    size_ = size;
+}
+
+MappedMatrix MappedMatrix::Open(const std::string& path, const std::string& root)
+{
+    const int fd = OpenIn(root, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) [[unlikely]]
+        throw SystemError("Cannot open matrix file", path);
+    MappedMatrix matrix(fd, false);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) [[unlikely]]
+        throw SystemError("Cannot stat matrix file", path);
+    matrix.file_dev_ = st.st_dev;
+    matrix.file_ino_ = st.st_ino;
+    if (std::size_t(st.st_size) < sizeof(MappedMatrixHeader)) [[unlikely]]
+        throw MatrixCalcError(std::format("Not a matrix file '{}': {} bytes", path, st.st_size));
+    matrix.Map(path, st.st_size);
+
+    MappedMatrixHeader header;
+    std::memcpy(&header, matrix.mapping_, sizeof(header));
+    if (header.magic != MappedMatrixMagic || header.version != MappedMatrixVersion) [[unlikely]]
+        throw MatrixCalcError(std::format("Not a matrix file '{}': magic {:#x}, version {}", path, header.magic, header.version));
+    if (header.rows == 0 || header.columns == 0 || FileSize(header.rows, header.columns) != matrix.size_) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Invalid matrix file '{}': {} bytes for {} x {}",
+                                          path, matrix.size_, header.rows, header.columns));
+    }
+    matrix.rows_ = header.rows;
+    matrix.columns_ = header.columns;
+
+    // Вдвое больший шаг упреждающего чтения: файл проходится слоями подряд
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return matrix;
+}
+
+MappedMatrix MappedMatrix::Create(const std::string& path, std::uint32_t rows, std::uint32_t columns,
+                                  const std::string& root)
+{
+    if (rows == 0 || columns == 0) [[unlikely]]
+        throw MatrixCalcError(std::format("Cannot create empty matrix file '{}': {} x {}", path, rows, columns));
+
+    const std::filesystem::path file_path(path);
+    const std::string name = file_path.filename().string();
+    if (name.empty() || name == "." || name == "..") [[unlikely]]
+        throw MatrixCalcError(std::format("Invalid matrix file name '{}'", path));
+    const std::string dir = file_path.has_parent_path() ? file_path.parent_path().string() : ".";
+    // Дальше все - внутри этого каталога, имена без путей: файлы-ссылки не разыменовываются
+    const int dir_fd = OpenIn(root, dir, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) [[unlikely]]
+        throw SystemError("Cannot open directory of matrix file", path);
+
+    // Временное имя уникально в процессе (счетчик) и между процессами (pid, O_EXCL)
+    static std::atomic<std::uint64_t> temp_counter = 0;
+    std::string temp_name;
+    int fd = -1;
+    while (fd < 0)
+    {
+        temp_name = std::format(".{}.{}.{}.tmp", name, getpid(), temp_counter++);
+        fd = openat(dir_fd, temp_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+        if (fd < 0 && errno != EEXIST) [[unlikely]]
+        {
+            const MatrixCalcError error = SystemError("Cannot create matrix file", path);
+            close(dir_fd);
+            throw error;
+        }
+    }
+    MappedMatrix matrix(fd, true);
+    matrix.dir_fd_ = dir_fd;
+    matrix.temp_name_ = std::move(temp_name);
+    matrix.name_ = name;
+
+    // Заменяемый файл: Replaces сравнивает с ним аргументы
+    struct stat st;
+    if (fstatat(dir_fd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0)
+    {
+        matrix.file_dev_ = st.st_dev;
+        matrix.file_ino_ = st.st_ino;
+    }
+
+    // Файл без выделенных блоков: нули, место занимают только записанные страницы
+    const std::size_t size = FileSize(rows, columns);
+    if (ftruncate(fd, size) != 0) [[unlikely]]
+        throw SystemError("Cannot resize matrix file", path);
+    matrix.Map(path, size);
+
+    MappedMatrixHeader header = {};
+    header.magic = MappedMatrixMagic;
+    header.version = MappedMatrixVersion;
+    header.rows = rows;
+    header.columns = columns;
+    std::memcpy(matrix.mapping_, &header, sizeof(header));
+    matrix.rows_ = rows;
+    matrix.columns_ = columns;
+    return matrix;
+}
+
+bool MappedMatrix::Replaces(const MappedMatrix& another) const
+{
+    return !temp_name_.empty() && file_ino_ != 0 && file_dev_ == another.file_dev_ && file_ino_ == another.file_ino_;
+}
+
+void MappedMatrix::Commit()
+{
+    if (temp_name_.empty()) [[unlikely]]
+        throw MatrixCalcError("Only a created matrix file can be committed, and only once");
+    // rename заменяет запись каталога: отображения старого файла видят прежние данные
+    if (renameat(dir_fd_, temp_name_.c_str(), dir_fd_, name_.c_str()) != 0) [[unlikely]]
+        throw SystemError("Cannot replace matrix file", name_);
+    temp_name_.clear();
+}
+
+MatrixView MappedMatrix::View() const
+{
+    const float* data = reinterpret_cast<const float*>(static_cast<const char*>(mapping_) + sizeof(MappedMatrixHeader));
+    return MatrixView(rows_, columns_, columns_, data);
+}
+
+MutableMatrixView MappedMatrix::MutableView()
+{
+    if (!writable_) [[unlikely]]
+        throw MatrixCalcError("Matrix file is mapped read-only");
+    float* data = reinterpret_cast<float*>(static_cast<char*>(mapping_) + sizeof(MappedMatrixHeader));
+    return MutableMatrixView(rows_, columns_, columns_, data);
+}
+
+
+void MultiplyOutOfCore(const MappedMatrix& first, const MappedMatrix& another, MappedMatrix& result,
+                       const OutOfCoreOptions& options)
+{
+    ValidateMulShapes(first.View(), another.View());
+    if (result.Rows() != first.Rows() || result.Columns() != another.Columns()) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Invalid result shape: ({} x {}) * ({} x {}) -> ({} x {})",
+                                          first.Rows(), first.Columns(), another.Rows(), another.Columns(),
+                                          result.Rows(), result.Columns()));
+    }
+
+    const std::uint32_t m = first.Rows();
+    const std::uint32_t k = first.Columns();
+    const std::uint32_t n = another.Columns();
+    const float* a = first.View().Data();
+    const float* b = another.View().Data();
+    float* c = result.MutableView().Data();
+
+    // Слой B (kc-кратный) - до четверти окна, с упреждающим следующим - половина;
+    // остальное - полоса A (tm x k) вместе с полосой C (tm x n)
+    const detail::MicroKernel& kernel = detail::ActiveKernel();
+    const std::size_t budget = options.working_set_bytes / sizeof(float);
+    std::size_t tk = std::max<std::size_t>(kernel.kc, budget / 4 / n / kernel.kc * kernel.kc);
+    tk = std::min<std::size_t>(tk, k);
+    const std::size_t slabs_size = 2 * tk * n;
+    const std::size_t panel_budget = budget > slabs_size ? budget - slabs_size : 0;
+    std::size_t tm = std::clamp<std::size_t>(panel_budget / (std::size_t(k) + n), 1, m);
+    if (tm > kernel.mr)
+        tm = tm / kernel.mr * kernel.mr;
+
+    for (std::size_t i = 0; i < m; i += tm)
+    {
+        const std::size_t rows = std::min<std::size_t>(tm, m - i);
+        const float* a_panel = a + i * k;
+        float* c_panel = c + i * n;
+        Advise(a_panel, a_panel + rows * k, MADV_WILLNEED);
+
+        for (std::size_t p = 0; p < k; p += tk)
+        {
+            const std::size_t depth = std::min<std::size_t>(tk, k - p);
+            const float* b_slab = b + p * n;
+            // Весь B в окне - держим его для всех полос, иначе заранее просим следующий слой
+            if (tk < k)
+            {
+                const std::size_t next = p + tk < k ? p + tk : 0;
+                Advise(b + next * n, b + std::min<std::size_t>(next + tk, k) * n, MADV_WILLNEED);
+            }
+
+            // Первый слой пишет C, следующие накапливают
+            Epilogue epilogue;
+            epilogue.beta = p == 0 ? 0.f : 1.f;
+            detail::Gemm<float>(rows, n, depth, { a_panel + p, k }, { b_slab, n }, c_panel, n, epilogue);
+
+            if (tk < k)
+                Advise(b_slab, b_slab + depth * n, MADV_DONTNEED);
+        }
+
+        // Грязные страницы C остаются в page cache и пишутся в файл ОС
+        Advise(a_panel, a_panel + rows * k, MADV_DONTNEED);
+        Advise(c_panel, c_panel + rows * n, MADV_DONTNEED);
+    }
+}
+
+} // namespace matrix_op
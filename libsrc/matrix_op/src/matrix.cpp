@@ -1,27 +1,165 @@
 #include "matrix_op/matrix.hpp"
 #include "matrix_op/matrix_exception.hpp"
 
+#include "gemm.hpp"
+#include "strassen.hpp"
+
+#include "matrix_op/storage.hpp"
+
 namespace matrix_op {
 
-Matrix operator*(const Matrix& first, const Matrix& another)
+namespace {
+
+// Размеры op(X)
+template<typename T>
+std::uint32_t OpRows(BasicMatrixView<T> m, Trans trans) { return trans == Trans::Yes ? m.Columns() : m.Rows(); }
+template<typename T>
+std::uint32_t OpColumns(BasicMatrixView<T> m, Trans trans) { return trans == Trans::Yes ? m.Rows() : m.Columns(); }
+
+template<typename T>
+detail::BasicOperand<T> ToOperand(BasicMatrixView<T> m, Trans trans)
+{
+    return { m.Data(), m.Stride(), trans == Trans::Yes };
+}
+
+// Проверка размеров аргументов и результата op(first) * op(another)
+template<typename T>
+void ValidateMul(BasicMatrixView<T> first, Trans first_trans, BasicMatrixView<T> another, Trans another_trans,
+                 MutableMatrixView result)
 {
-    if (first.columns_ != another.rows_) [[unlikely]]
+    ValidateMulShapes(first, first_trans, another, another_trans);
+
+    const std::uint32_t rows = OpRows(first, first_trans);
+    const std::uint32_t columns = OpColumns(another, another_trans);
+    if (result.Rows() != rows || result.Columns() != columns) [[unlikely]]
     {
-        throw MatrixCalcError(std::format("Cannot multiply matrices: ({} x {}) * ({} x {}): c1 != r2",
-                                              first.rows_, first.columns_, another.rows_, another.columns_));
+        throw MatrixCalcError(std::format("Invalid result shape: ({} x {}) * ({} x {}) -> ({} x {})",
+                                          rows, OpColumns(first, first_trans),
+                                          OpRows(another, another_trans), columns,
+                                          result.Rows(), result.Columns()));
     }
+}
 
-    Matrix result(first.rows_, another.columns_);
-    for (std::uint32_t r = 0; r < first.rows_; r++)
-     for (std::uint32_t c = 0; c < another.columns_; c++)
+template<typename T>
+void MultiplyReduced(BasicMatrixView<T> first, Trans first_trans, BasicMatrixView<T> another, Trans another_trans,
+                     MutableMatrixView result, const MulOptions& options)
+{
+    ValidateMul(first, first_trans, another, another_trans, result);
+    detail::Gemm(result.Rows(), result.Columns(), OpColumns(first, first_trans),
+                 ToOperand(first, first_trans), ToOperand(another, another_trans),
+                 result.Data(), result.Stride(), options.epilogue);
+}
+
+// Штрассен складывает промежуточные в result, поэтому эпилог - отдельным проходом
+// по произведению из временного буфера
+void StrassenWithEpilogue(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+                          detail::Operand a, detail::Operand b,
+                          MutableMatrixView result, const MulOptions& options)
+{
+    if (options.epilogue.Trivial())
+        return detail::StrassenGemm(m, n, k, a, b, result.Data(), result.Stride(), options.strassen_cutoff);
+
+    const std::size_t stride = LeadingDimension(n);
+    AlignedBuffer product(stride * m);
+    detail::StrassenGemm(m, n, k, a, b, product.Data(), stride, options.strassen_cutoff);
+
+    const detail::TileEpilogue epilogue = detail::BlockEpilogue(options.epilogue, 0, k, k);
+    for (std::uint32_t i = 0; i < m; i++)
+     for (std::uint32_t j = 0; j < n; j++)
+        detail::StoreWithEpilogue(epilogue, product.Data()[i * stride + j], result[i][j], j);
+}
+
+void MultiplyUnchecked(MatrixView first, Trans first_trans, MatrixView another, Trans another_trans,
+                       MutableMatrixView result, const MulOptions& options)
+{
+    const std::uint32_t m = OpRows(first, first_trans);
+    const std::uint32_t n = OpColumns(another, another_trans);
+    const std::uint32_t k = OpColumns(first, first_trans);
+
+    if (options.algorithm == MulAlgorithm::Strassen)
     {
-        float sum = 0;
-        for (std::uint32_t i = 0; i < first.columns_; i++)
-            sum += first[r][i] * another[i][c];
-        result[{r, c}] = sum;
+        StrassenWithEpilogue(m, n, k, ToOperand(first, first_trans), ToOperand(another, another_trans),
+                             result, options);
     }
+    else
+    {
+        detail::Gemm(m, n, k,
+                     ToOperand(first, first_trans), ToOperand(another, another_trans),
+                     result.Data(), result.Stride(), options.epilogue);
+    }
+}
+
+} // namespace
+
+
+void ValidateMulShapes(MatrixView first, MatrixView another)
+{
+    ValidateMulShapes(first, Trans::No, another, Trans::No);
+}
+
+template<typename T>
+void ValidateMulShapes(BasicMatrixView<T> first, Trans first_trans, BasicMatrixView<T> another, Trans another_trans)
+{
+    if (OpColumns(first, first_trans) != OpRows(another, another_trans)) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Cannot multiply matrices: ({} x {}){} * ({} x {}){}: c1 != r2",
+                                          first.Rows(), first.Columns(), first_trans == Trans::Yes ? "^T" : "",
+                                          another.Rows(), another.Columns(), another_trans == Trans::Yes ? "^T" : ""));
+    }
+}
+
+template void ValidateMulShapes(MatrixView, Trans, MatrixView, Trans);
+template void ValidateMulShapes(Float16MatrixView, Trans, Float16MatrixView, Trans);
+template void ValidateMulShapes(BFloat16MatrixView, Trans, BFloat16MatrixView, Trans);
+template void ValidateMulShapes(BasicMatrixView<std::int8_t>, Trans, BasicMatrixView<std::int8_t>, Trans);
+
+Matrix Multiply(const Matrix& first, const Matrix& another, const MulOptions& options)
+{
+    ValidateMulShapes(first.View(), another.View());
+    if (options.epilogue.beta != 0) [[unlikely]]
+        throw MatrixCalcError("Epilogue with beta needs an initialized result");
+
+    Matrix result(first.rows_, another.columns_);
+    MultiplyUnchecked(first.View(), Trans::No, another.View(), Trans::No,
+                      MutableMatrixView(result.rows_, result.columns_, result.stride_, result.storage_.Data()),
+                      options);
 
     return result;
 }
 
+void Multiply(MatrixView first, MatrixView another, MutableMatrixView result, const MulOptions& options)
+{
+    Multiply(first, Trans::No, another, Trans::No, result, options);
+}
+
+void Multiply(MatrixView first, Trans first_trans, MatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options)
+{
+    ValidateMul(first, first_trans, another, another_trans, result);
+    MultiplyUnchecked(first, first_trans, another, another_trans, result, options);
+}
+
+void Multiply(Float16MatrixView first, Trans first_trans, Float16MatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options)
+{
+    MultiplyReduced(first, first_trans, another, another_trans, result, options);
+}
+
+void Multiply(BFloat16MatrixView first, Trans first_trans, BFloat16MatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options)
+{
+    MultiplyReduced(first, first_trans, another, another_trans, result, options);
+}
+
+void Multiply(QuantizedMatrixView first, Trans first_trans, QuantizedMatrixView another, Trans another_trans,
+              MutableMatrixView result, const MulOptions& options)
+{
+    ValidateMul(first.values, first_trans, another.values, another_trans, result);
+    detail::GemmInt8(result.Rows(), result.Columns(), OpColumns(first.values, first_trans),
+                     ToOperand(first.values, first_trans), first.quantization.zero_point,
+                     ToOperand(another.values, another_trans), another.quantization.zero_point,
+                     first.quantization.scale * another.quantization.scale,
+                     result.Data(), result.Stride(), options.epilogue);
+}
+
 } // namespace matrix_op
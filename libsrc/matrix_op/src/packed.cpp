@@ -0,0 +1,50 @@
+#include "matrix_op/packed.hpp"
+#include "matrix_op/matrix_exception.hpp"
+
+#include "gemm.hpp"
+#include "kernels.hpp"
+
+#include <format>
+
+namespace matrix_op {
+
+PackedMatrix::PackedMatrix(MatrixView matrix, Trans trans)
+    : kernel_(&detail::ActiveKernel()),
+      rows_(trans == Trans::Yes ? matrix.Columns() : matrix.Rows()),
+      columns_(trans == Trans::Yes ? matrix.Rows() : matrix.Columns()),
+      data_(detail::PackedSize(*kernel_, rows_, columns_))
+{
+    detail::PackOperand(*kernel_, rows_, columns_, { matrix.Data(), matrix.Stride(), trans == Trans::Yes },
+                        data_.Data());
+}
+
+void ValidateMulShapes(MatrixView first, Trans first_trans, const PackedMatrix& another)
+{
+    const std::uint32_t inner = first_trans == Trans::Yes ? first.Rows() : first.Columns();
+    if (inner != another.Rows()) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Cannot multiply matrices: ({} x {}){} * ({} x {}) packed: c1 != r2",
+                                          first.Rows(), first.Columns(), first_trans == Trans::Yes ? "^T" : "",
+                                          another.Rows(), another.Columns()));
+    }
+}
+
+void Multiply(MatrixView first, Trans first_trans, const PackedMatrix& another,
+              MutableMatrixView result, const MulOptions& options)
+{
+    ValidateMulShapes(first, first_trans, another);
+
+    const std::uint32_t rows = first_trans == Trans::Yes ? first.Columns() : first.Rows();
+    if (result.Rows() != rows || result.Columns() != another.Columns()) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Invalid result shape: ({} x {}) * ({} x {}) -> ({} x {})",
+                                          rows, another.Rows(), another.Rows(), another.Columns(),
+                                          result.Rows(), result.Columns()));
+    }
+
+    detail::GemmPacked(rows, { first.Data(), first.Stride(), first_trans == Trans::Yes },
+                       { another.kernel_, another.rows_, another.columns_, another.data_.Data() },
+                       result.Data(), result.Stride(), options.epilogue);
+}
+
+} // namespace matrix_op
@@ -0,0 +1,111 @@
+#include "small_gemm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace matrix_op::detail {
+
+namespace {
+
+// Стороны, для которых инстанцированы ядра. Все сочетания - 125 ядер: больше
+// раздувает код, а на промежуточных размерах блочное умножение проигрывает мало
+constexpr std::uint32_t SmallSizes[] = { 2, 3, 4, 8, 16 };
+constexpr std::size_t SmallCount = std::size(SmallSizes);
+constexpr std::uint32_t MaxSmallSize = 16;
+
+// Номер стороны в SmallSizes по ее значению, SmallCount - ядра нет
+constexpr std::array<std::uint8_t, MaxSmallSize + 1> SizeIndex = []
+{
+    std::array<std::uint8_t, MaxSmallSize + 1> index;
+    index.fill(SmallCount);
+    for (std::size_t i = 0; i < SmallCount; i++)
+        index[SmallSizes[i]] = i;
+    return index;
+}();
+
+// op(X) размера R x C в плотный массив на стеке
+template<std::uint32_t R, std::uint32_t C>
+void Load(Operand x, float (&dst)[R][C])
+{
+    if (x.trans)
+    {
+        for (std::uint32_t i = 0; i < R; i++)
+        {
+#pragma GCC unroll 16
+            for (std::uint32_t j = 0; j < C; j++)
+                dst[i][j] = x.data[j * x.ld + i];
+        }
+    }
+    else
+    {
+        for (std::uint32_t i = 0; i < R; i++)
+        {
+#pragma GCC unroll 16
+            for (std::uint32_t j = 0; j < C; j++)
+                dst[i][j] = x.data[i * x.ld + j];
+        }
+    }
+}
+
+template<std::uint32_t M, std::uint32_t N, std::uint32_t K>
+void SmallGemm(Operand a, Operand b, float* c, std::size_t ldc, const Epilogue& epilogue)
+{
+    float sa[M][K];
+    float sb[K][N];
+    Load(a, sa);
+    Load(b, sb);
+
+    const bool trivial = epilogue.Trivial();
+    const TileEpilogue tile_epilogue = BlockEpilogue(epilogue, 0, K, K);
+
+    // Строка C копится как сумма строк B с весами из строки A: внутренний цикл по N векторизуется
+    for (std::uint32_t i = 0; i < M; i++)
+    {
+        float row[N] = {};
+#pragma GCC unroll 16
+        for (std::uint32_t p = 0; p < K; p++)
+        {
+            const float av = sa[i][p];
+#pragma GCC unroll 16
+            for (std::uint32_t j = 0; j < N; j++)
+                row[j] += av * sb[p][j];
+        }
+        if (trivial)
+        {
+            std::copy(row, row + N, c + i * ldc);
+            continue;
+        }
+        for (std::uint32_t j = 0; j < N; j++)
+            StoreWithEpilogue(tile_epilogue, row[j], c[i * ldc + j], j);
+    }
+}
+
+// Таблица ядер с индексом (m, n, k) в SmallSizes: (im * SmallCount + in) * SmallCount + ik
+template<std::size_t... I>
+constexpr std::array<SmallGemmFn, sizeof...(I)> MakeSmallGemmTable(std::index_sequence<I...>)
+{
+    return { &SmallGemm<SmallSizes[I / (SmallCount * SmallCount)],
+                        SmallSizes[I / SmallCount % SmallCount],
+                        SmallSizes[I % SmallCount]>... };
+}
+
+constexpr auto SmallGemmTable = MakeSmallGemmTable(std::make_index_sequence<SmallCount * SmallCount * SmallCount>{});
+
+} // namespace
+
+
+SmallGemmFn FindSmallGemm(std::uint32_t m, std::uint32_t n, std::uint32_t k)
+{
+    if (m > MaxSmallSize || n > MaxSmallSize || k > MaxSmallSize)
+        return nullptr;
+
+    const std::size_t im = SizeIndex[m];
+    const std::size_t in = SizeIndex[n];
+    const std::size_t ik = SizeIndex[k];
+    if (im == SmallCount || in == SmallCount || ik == SmallCount)
+        return nullptr;
+    return SmallGemmTable[(im * SmallCount + in) * SmallCount + ik];
+}
+
+} // namespace matrix_op::detail
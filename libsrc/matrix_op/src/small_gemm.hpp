@@ -0,0 +1,18 @@
+#pragma once
+
+#include "gemm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace matrix_op::detail {
+
+// Ядро для фиксированного размера: C = op(A) * op(B), m x k на k x n.
+// Размеры - параметры шаблона: циклы развернуты, операнды копируются на стек,
+// нет ни упаковки панелей, ни выбора ядра, ни пула потоков. Эпилог - при записи строк C.
+using SmallGemmFn = void (*)(Operand a, Operand b, float* c, std::size_t ldc, const Epilogue& epilogue);
+
+// Ядро из таблицы (любое сочетание сторон 2, 3, 4, 8, 16) или nullptr
+SmallGemmFn FindSmallGemm(std::uint32_t m, std::uint32_t n, std::uint32_t k);
+
+} // namespace matrix_op::detail
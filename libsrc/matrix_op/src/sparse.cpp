@@ -0,0 +1,487 @@
+#include "matrix_op/sparse.hpp"
+#include "matrix_op/matrix_exception.hpp"
+#include "matrix_op/parallel.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <optional>
+
+namespace matrix_op {
+
+namespace {
+
+void ValidateStructure(std::uint32_t rows, std::uint32_t columns, SparseLayout layout,
+                       std::span<const std::uint32_t> offsets,
+                       std::span<const std::uint32_t> indices,
+                       std::span<const float> values)
+{
+    if (rows == 0 || columns == 0) [[unlikely]]
+        throw MatrixCalcError(std::format("Empty sparse matrix: {} (r) x {} (c)", rows, columns));
+
+    const std::uint32_t lines = layout == SparseLayout::Csr ? rows : columns;
+    const std::uint32_t width = layout == SparseLayout::Csr ? columns : rows;
+    if (offsets.size() != std::size_t(lines) + 1) [[unlikely]]
+        throw MatrixCalcError(std::format("Invalid sparse offsets size: {} != {} + 1", offsets.size(), lines));
+    if (indices.size() != values.size()) [[unlikely]]
+        throw MatrixCalcError(std::format("Sparse indices and values differ in size: {} != {}", indices.size(), values.size()));
+    if (offsets.front() != 0 || offsets.back() != indices.size()) [[unlikely]]
+        throw MatrixCalcError(std::format("Sparse offsets must span [0, {}]", indices.size()));
+
+    for (std::uint32_t l = 0; l < lines; l++)
+    {
+        if (offsets[l] > offsets[l + 1]) [[unlikely]]
+            throw MatrixCalcError(std::format("Sparse offsets decrease at line {}", l));
+    }
+    for (std::uint32_t index : indices)
+    {
+        if (index >= width) [[unlikely]]
+            throw MatrixCalcError(std::format("Sparse index {} is out of range [0, {})", index, width));
+    }
+}
+
+void ValidateInner(std::uint32_t first_rows, std::uint32_t first_columns, std::uint32_t another_rows, std::uint32_t another_columns)
+{
+    if (first_columns != another_rows) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Cannot multiply matrices: ({} x {}) * ({} x {}): c1 != r2",
+                                          first_rows, first_columns, another_rows, another_columns));
+    }
+}
+
+void ValidateResult(std::uint32_t rows, std::uint32_t columns, MutableMatrixView result)
+{
+    if (result.Rows() != rows || result.Columns() != columns) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Invalid result shape: ({} x {}) expected, ({} x {}) given",
+                                          rows, columns, result.Rows(), result.Columns()));
+    }
+}
+
+
+// Полосы линий [bounds[t], bounds[t + 1]) для обработки в общем пуле потоков
+struct Bands
+{
+    std::shared_ptr<detail::ThreadPool> pool;
+    std::vector<std::uint32_t> bounds;
+
+    std::size_t Count() const { return bounds.size() - 1; }
+
+    // body(band, begin, end)
+    template<typename BodyT>
+    void Run(BodyT&& body) const
+    {
+        if (Count() == 1)
+            return body(std::size_t(0), bounds[0], bounds[1]);
+        pool->ParallelFor(Count(), [&](std::size_t band) { body(band, bounds[band], bounds[band + 1]); });
+    }
+};
+
+// Делит lines линий на полосы с примерно равным весом, prefix(l) - суммарный вес линий [0, l).
+// Одна полоса, если работы (work) меньше ParallelThreshold() или в пуле один поток.
+template<typename PrefixT>
+Bands SplitLines(std::uint32_t lines, std::uint64_t work, PrefixT prefix)
+{
+    Bands bands;
+    bands.bounds = { 0 };
+    if (work >= ParallelThreshold() && lines > 1)
+        bands.pool = detail::SharedPool();
+
+    if (bands.pool && bands.pool->Threads() > 1)
+    {
+        // Полос с запасом относительно потоков - пул общий на все запросы
+        const std::uint64_t count = 2 * bands.pool->Threads();
+        const std::uint64_t total = prefix(lines);
+        std::uint64_t band = 1;
+        for (std::uint32_t l = 1; l < lines && band < count; l++)
+        {
+            if (prefix(l) >= total * band / count)
+            {
+                bands.bounds.push_back(l);
+                band++;
+            }
+        }
+    }
+
+    bands.bounds.push_back(lines);
+    return bands;
+}
+
+// Вес CSR-строки для разбиения: ее ненулевые элементы плюс постоянная часть
+Bands SplitRows(SparseMatrixView csr, std::uint64_t work)
+{
+    const auto offsets = csr.Offsets();
+    return SplitLines(csr.Rows(), work, [&](std::uint32_t l) { return std::uint64_t(offsets[l]) + l; });
+}
+
+
+// Строки [begin, end) произведения CSR-матрицы на плотную
+void SparseDenseRows(SparseMatrixView a, MatrixView b, MutableMatrixView c, std::uint32_t begin, std::uint32_t end)
+{
+    const auto offsets = a.Offsets();
+    const auto indices = a.Indices();
+    const auto values = a.Values();
+    const std::uint32_t n = b.Columns();
+
+    for (std::uint32_t i = begin; i < end; i++)
+    {
+        float* c_row = c[i].data();
+        if (n == 1)
+        {
+            // SpMV: скалярное произведение строки на вектор
+            float sum = 0;
+            for (std::uint32_t p = offsets[i]; p < offsets[i + 1]; p++)
+                sum += values[p] * b.Data()[indices[p] * b.Stride()];
+            c_row[0] = sum;
+            continue;
+        }
+
+        std::fill(c_row, c_row + n, 0.f);
+        for (std::uint32_t p = offsets[i]; p < offsets[i + 1]; p++)
+        {
+            const float v = values[p];
+            const float* b_row = b.Data() + indices[p] * b.Stride();
+#pragma GCC ivdep
+            for (std::uint32_t j = 0; j < n; j++)
+                c_row[j] += v * b_row[j];
+        }
+    }
+}
+
+// Строки [begin, end) произведения плотной матрицы на разреженную
+void DenseSparseRows(MatrixView a, SparseMatrixView b, MutableMatrixView c, std::uint32_t begin, std::uint32_t end)
+{
+    const auto offsets = b.Offsets();
+    const auto indices = b.Indices();
+    const auto values = b.Values();
+
+    for (std::uint32_t i = begin; i < end; i++)
+    {
+        const auto a_row = a[i];
+        const auto c_row = c[i];
+
+        if (b.Layout() == SparseLayout::Csc)
+        {
+            // Скалярные произведения строки A со столбцами B
+            for (std::uint32_t j = 0; j < b.Columns(); j++)
+            {
+                float sum = 0;
+                for (std::uint32_t p = offsets[j]; p < offsets[j + 1]; p++)
+                    sum += a_row[indices[p]] * values[p];
+                c_row[j] = sum;
+            }
+            continue;
+        }
+
+        // Разброс строк B с весами из строки A
+        std::fill(c_row.begin(), c_row.end(), 0.f);
+        for (std::uint32_t k = 0; k < b.Rows(); k++)
+        {
+            const float av = a_row[k];
+            if (av == 0.f)
+                continue;
+            for (std::uint32_t p = offsets[k]; p < offsets[k + 1]; p++)
+                c_row[indices[p]] += av * values[p];
+        }
+    }
+}
+
+
+// Результат полосы строк разреженного произведения
+struct SparseBand
+{
+    std::vector<std::uint32_t> row_sizes;
+    std::vector<std::uint32_t> indices;
+    std::vector<float> values;
+};
+
+// Строки [begin, end) произведения CSR-матриц по Густавсону: строка C - сумма строк B
+// с весами из строки A, копится в плотном аккумуляторе длины n с отметками занятых столбцов
+void SparseSparseRows(SparseMatrixView a, SparseMatrixView b, std::uint32_t begin, std::uint32_t end, SparseBand& out)
+{
+    const auto a_offsets = a.Offsets();
+    const auto a_indices = a.Indices();
+    const auto a_values = a.Values();
+    const auto b_offsets = b.Offsets();
+    const auto b_indices = b.Indices();
+    const auto b_values = b.Values();
+
+    constexpr std::uint32_t Untouched = std::numeric_limits<std::uint32_t>::max();
+    std::vector<float> accumulator(b.Columns());
+    std::vector<std::uint32_t> marker(b.Columns(), Untouched); // Строка, в которой столбец последний раз занят
+    std::vector<std::uint32_t> touched;
+
+    out.row_sizes.reserve(end - begin);
+    for (std::uint32_t i = begin; i < end; i++)
+    {
+        touched.clear();
+        for (std::uint32_t p = a_offsets[i]; p < a_offsets[i + 1]; p++)
+        {
+            const std::uint32_t k = a_indices[p];
+            const float av = a_values[p];
+            for (std::uint32_t q = b_offsets[k]; q < b_offsets[k + 1]; q++)
+            {
+                const std::uint32_t j = b_indices[q];
+                if (marker[j] != i)
+                {
+                    marker[j] = i;
+                    accumulator[j] = 0.f;
+                    touched.push_back(j);
+                }
+                accumulator[j] += av * b_values[q];
+            }
+        }
+
+        std::sort(touched.begin(), touched.end());
+        for (std::uint32_t j : touched)
+        {
+            out.indices.push_back(j);
+            out.values.push_back(accumulator[j]);
+        }
+        out.row_sizes.push_back(touched.size());
+    }
+}
+
+} // namespace
+
+
+SparseMatrixView::SparseMatrixView(std::uint32_t rows, std::uint32_t columns, SparseLayout layout,
+                                   std::span<const std::uint32_t> offsets,
+                                   std::span<const std::uint32_t> indices,
+                                   std::span<const float> values)
+    : SparseMatrixView(Unchecked{}, rows, columns, layout, offsets, indices, values)
+{
+    ValidateStructure(rows, columns, layout, offsets, indices, values);
+}
+
+SparseMatrixView::SparseMatrixView(Unchecked, std::uint32_t rows, std::uint32_t columns, SparseLayout layout,
+                                   std::span<const std::uint32_t> offsets,
+                                   std::span<const std::uint32_t> indices,
+                                   std::span<const float> values)
+    : rows_(rows),
+      columns_(columns),
+      layout_(layout),
+      offsets_(offsets),
+      indices_(indices),
+      values_(values)
+{}
+
+SparseMatrixView SparseMatrixView::Transposed() const
+{
+    const SparseLayout layout = layout_ == SparseLayout::Csr ? SparseLayout::Csc : SparseLayout::Csr;
+    return SparseMatrixView(Unchecked{}, columns_, rows_, layout, offsets_, indices_, values_);
+}
+
+
+SparseMatrix::SparseMatrix(std::uint32_t rows, std::uint32_t columns, SparseLayout layout,
+                           std::vector<std::uint32_t> offsets,
+                           std::vector<std::uint32_t> indices,
+                           std::vector<float> values)
+    : rows_(rows),
+      columns_(columns),
+      layout_(layout),
+      offsets_(std::move(offsets)),
+      indices_(std::move(indices)),
+      values_(std::move(values))
+{
+    ValidateStructure(rows_, columns_, layout_, offsets_, indices_, values_);
+}
+
+SparseMatrix SparseMatrix::FromDense(MatrixView dense, SparseLayout layout)
+{
+    std::vector<std::uint32_t> offsets = { 0 };
+    std::vector<std::uint32_t> indices;
+    std::vector<float> values;
+
+    offsets.reserve(dense.Rows() + 1);
+    for (std::uint32_t i = 0; i < dense.Rows(); i++)
+    {
+        const auto row = dense[i];
+        for (std::uint32_t j = 0; j < dense.Columns(); j++)
+        {
+            if (row[j] != 0.f)
+            {
+                indices.push_back(j);
+                values.push_back(row[j]);
+            }
+        }
+        if (indices.size() > std::numeric_limits<std::uint32_t>::max()) [[unlikely]]
+            throw MatrixCalcError("Too many non-zeros for a sparse matrix");
+        offsets.push_back(indices.size());
+    }
+
+    SparseMatrix csr(dense.Rows(), dense.Columns(), SparseLayout::Csr, std::move(offsets), std::move(indices), std::move(values));
+    return layout == SparseLayout::Csr ? csr : Convert(csr.View(), layout);
+}
+
+SparseMatrixView SparseMatrix::View() const
+{
+    return SparseMatrixView(rows_, columns_, layout_, offsets_, indices_, values_);
+}
+
+
+SparseMatrix Convert(SparseMatrixView matrix, SparseLayout layout)
+{
+    // Переупаковка в тот же формат - через другой, чтобы индексы в линиях были упорядочены
+    if (layout == matrix.Layout())
+        return Convert(Convert(matrix, layout == SparseLayout::Csr ? SparseLayout::Csc : SparseLayout::Csr).View(), layout);
+
+    const auto offsets = matrix.Offsets();
+    const auto indices = matrix.Indices();
+    const auto values = matrix.Values();
+    const std::uint32_t lines = matrix.Lines();
+    const std::uint32_t width = layout == SparseLayout::Csr ? matrix.Rows() : matrix.Columns();
+
+    // Подсчет размеров новых линий, затем разброс: старые линии идут по порядку,
+    // поэтому индексы в новых линиях получаются отсортированными
+    std::vector<std::uint32_t> new_offsets(std::size_t(width) + 1, 0);
+    for (std::uint32_t index : indices)
+        new_offsets[index + 1]++;
+    for (std::uint32_t l = 0; l < width; l++)
+        new_offsets[l + 1] += new_offsets[l];
+
+    std::vector<std::uint32_t> new_indices(indices.size());
+    std::vector<float> new_values(values.size());
+    std::vector<std::uint32_t> position(new_offsets.begin(), new_offsets.end() - 1);
+    for (std::uint32_t l = 0; l < lines; l++)
+    {
+        for (std::uint32_t p = offsets[l]; p < offsets[l + 1]; p++)
+        {
+            const std::uint32_t dst = position[indices[p]]++;
+            new_indices[dst] = l;
+            new_values[dst] = values[p];
+        }
+    }
+
+    return SparseMatrix(matrix.Rows(), matrix.Columns(), layout,
+                        std::move(new_offsets), std::move(new_indices), std::move(new_values));
+}
+
+void ToDense(SparseMatrixView matrix, MutableMatrixView result)
+{
+    ValidateResult(matrix.Rows(), matrix.Columns(), result);
+
+    for (std::uint32_t i = 0; i < result.Rows(); i++)
+        std::fill(result[i].begin(), result[i].end(), 0.f);
+
+    const auto offsets = matrix.Offsets();
+    const auto indices = matrix.Indices();
+    const auto values = matrix.Values();
+    const bool csr = matrix.Layout() == SparseLayout::Csr;
+    for (std::uint32_t l = 0; l < matrix.Lines(); l++)
+    {
+        for (std::uint32_t p = offsets[l]; p < offsets[l + 1]; p++)
+        {
+            // Повторяющиеся индексы складываются, как и в умножении
+            float& dst = csr ? result[l][indices[p]] : result[indices[p]][l];
+            dst += values[p];
+        }
+    }
+}
+
+
+void ValidateMulShapes(SparseMatrixView first, MatrixView another)
+{
+    ValidateInner(first.Rows(), first.Columns(), another.Rows(), another.Columns());
+}
+
+void ValidateMulShapes(MatrixView first, SparseMatrixView another)
+{
+    ValidateInner(first.Rows(), first.Columns(), another.Rows(), another.Columns());
+}
+
+void ValidateMulShapes(SparseMatrixView first, SparseMatrixView another)
+{
+    ValidateInner(first.Rows(), first.Columns(), another.Rows(), another.Columns());
+}
+
+void Multiply(SparseMatrixView first, MatrixView another, MutableMatrixView result)
+{
+    ValidateMulShapes(first, another);
+    ValidateResult(first.Rows(), another.Columns(), result);
+
+    // По столбцам строки результата не разделить между потоками - переупаковка O(nnz)
+    // дешевле самого умножения O(nnz * columns)
+    if (first.Layout() == SparseLayout::Csc)
+        return Multiply(Convert(first, SparseLayout::Csr).View(), another, result);
+
+    const Bands bands = SplitRows(first, std::uint64_t(first.NonZeros()) * another.Columns());
+    bands.Run([&](std::size_t, std::uint32_t begin, std::uint32_t end)
+    {
+        SparseDenseRows(first, another, result, begin, end);
+    });
+}
+
+void Multiply(MatrixView first, SparseMatrixView another, MutableMatrixView result)
+{
+    ValidateMulShapes(first, another);
+    ValidateResult(first.Rows(), another.Columns(), result);
+
+    // Работа на строку A одинакова - полосы поровну
+    const std::uint64_t work = std::uint64_t(first.Rows()) * (another.NonZeros() + another.Lines());
+    const Bands bands = SplitLines(first.Rows(), work, [](std::uint32_t l) { return std::uint64_t(l); });
+    bands.Run([&](std::size_t, std::uint32_t begin, std::uint32_t end)
+    {
+        DenseSparseRows(first, another, result, begin, end);
+    });
+}
+
+SparseMatrix Multiply(SparseMatrixView first, SparseMatrixView another)
+{
+    ValidateMulShapes(first, another);
+
+    // Густавсон идет по строкам обоих операндов
+    std::optional<SparseMatrix> first_csr, another_csr;
+    if (first.Layout() == SparseLayout::Csc)
+        first = first_csr.emplace(Convert(first, SparseLayout::Csr)).View();
+    if (another.Layout() == SparseLayout::Csc)
+        another = another_csr.emplace(Convert(another, SparseLayout::Csr)).View();
+
+    // Число умножений по строкам - и оценка работы, и веса для разбиения на полосы
+    const auto a_offsets = first.Offsets();
+    const auto a_indices = first.Indices();
+    const auto b_offsets = another.Offsets();
+    std::vector<std::uint64_t> flops(std::size_t(first.Rows()) + 1, 0);
+    for (std::uint32_t i = 0; i < first.Rows(); i++)
+    {
+        std::uint64_t row_flops = 1;
+        for (std::uint32_t p = a_offsets[i]; p < a_offsets[i + 1]; p++)
+            row_flops += b_offsets[a_indices[p] + 1] - b_offsets[a_indices[p]];
+        flops[i + 1] = flops[i] + row_flops;
+    }
+
+    const Bands bands = SplitLines(first.Rows(), flops.back(), [&](std::uint32_t l) { return flops[l]; });
+    std::vector<SparseBand> results(bands.Count());
+    bands.Run([&](std::size_t band, std::uint32_t begin, std::uint32_t end)
+    {
+        SparseSparseRows(first, another, begin, end, results[band]);
+    });
+
+    // Склейка полос
+    std::size_t non_zeros = 0;
+    for (const SparseBand& band : results)
+        non_zeros += band.indices.size();
+    if (non_zeros > std::numeric_limits<std::uint32_t>::max()) [[unlikely]]
+        throw MatrixCalcError(std::format("Too many non-zeros in sparse product: {}", non_zeros));
+
+    std::vector<std::uint32_t> offsets = { 0 };
+    std::vector<std::uint32_t> indices;
+    std::vector<float> values;
+    offsets.reserve(std::size_t(first.Rows()) + 1);
+    indices.reserve(non_zeros);
+    values.reserve(non_zeros);
+    for (const SparseBand& band : results)
+    {
+        for (std::uint32_t size : band.row_sizes)
+            offsets.push_back(offsets.back() + size);
+        indices.insert(indices.end(), band.indices.begin(), band.indices.end());
+        values.insert(values.end(), band.values.begin(), band.values.end());
+    }
+
+    return SparseMatrix(first.Rows(), another.Columns(), SparseLayout::Csr,
+                        std::move(offsets), std::move(indices), std::move(values));
+}
+
+} // namespace matrix_op
@@ -0,0 +1,105 @@
+#include "matrix_op/storage.hpp"
+
+#include <sys/mman.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace matrix_op {
+
+namespace {
+
+constexpr std::size_t HugePageSize = 2u << 20;
+
+// Читается на каждом выделении - без мьютекса
+struct StorageState
+{
+    std::atomic<bool> pad_leading_dimension = StorageOptions{}.pad_leading_dimension;
+    std::atomic<std::size_t> hugepage_threshold = StorageOptions{}.hugepage_threshold;
+};
+
+StorageState& State()
+{
+    static StorageState state;
+    return state;
+}
+
+float* Allocate(std::size_t size)
+{
+    const std::size_t hugepage_threshold = GetStorageOptions().hugepage_threshold;
+
+    std::size_t bytes = size * sizeof(float);
+    const bool hugepages = bytes >= hugepage_threshold;
+    const std::size_t alignment = hugepages ? HugePageSize : RowAlignment;
+    bytes = (bytes + alignment - 1) / alignment * alignment; // aligned_alloc требует кратности
+
+    void* ptr = std::aligned_alloc(alignment, bytes);
+    if (!ptr) [[unlikely]]
+        throw std::bad_alloc();
+
+#ifdef MADV_HUGEPAGE
+    // Только подсказка: при выключенном THP вызов просто ничего не даст
+    if (hugepages)
+        madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+
+    return static_cast<float*>(ptr);
+}
+
+} // namespace
+
+
+void SetStorageOptions(const StorageOptions& options)
+{
+    State().pad_leading_dimension = options.pad_leading_dimension;
+    State().hugepage_threshold = options.hugepage_threshold;
+}
+
+StorageOptions GetStorageOptions()
+{
+    return { State().pad_leading_dimension, State().hugepage_threshold };
+}
+
+std::size_t LeadingDimension(std::uint32_t columns)
+{
+    constexpr std::size_t row_floats = RowAlignment / sizeof(float);
+    constexpr std::size_t aliasing_period = 4096 / sizeof(float);
+
+    // Узкие матрицы храним плотно: выровнять их строки можно только ценой кратного перерасхода памяти
+    if (columns < row_floats)
+        return columns;
+
+    std::size_t ld = (columns + row_floats - 1) / row_floats * row_floats;
+    if (ld % aliasing_period == 0 && GetStorageOptions().pad_leading_dimension)
+        ld += row_floats;
+    return ld;
+}
+
+
+AlignedBuffer::AlignedBuffer(std::size_t size)
+    : data_(size ? Allocate(size) : nullptr),
+      size_(size)
+{}
+
+AlignedBuffer::AlignedBuffer(const AlignedBuffer& another)
+    : AlignedBuffer(another.size_)
+{
+    if (size_)
+        std::memcpy(data_.get(), another.data_.get(), size_ * sizeof(float));
+}
+
+AlignedBuffer& AlignedBuffer::operator=(const AlignedBuffer& another)
+{
+    if (this != &another)
+        *this = AlignedBuffer(another);
+    return *this;
+}
+
+void AlignedBuffer::Deleter::operator()(float* ptr) const
+{
+    std::free(ptr);
+}
+
+} // namespace matrix_op
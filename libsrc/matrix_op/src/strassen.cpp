@@ -0,0 +1,189 @@
+#include "strassen.hpp"
+#include "gemm.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace matrix_op::detail {
+
+namespace {
+
+// Поэлементные операции над блоками: c = a + b / c = a - b.
+// c может совпадать с a или b (операция на месте), но не перекрываться с ними со сдвигом.
+// Транспонированные входы читаются поэлементно через At - это O(n^2) на фоне умножений.
+void Add(std::uint32_t m, std::uint32_t n, Operand a, Operand b, float* c, std::size_t ldc)
+{
+    if (a.trans || b.trans)
+    {
+        for (std::uint32_t i = 0; i < m; i++)
+         for (std::uint32_t j = 0; j < n; j++)
+            c[i * ldc + j] = a.At(i, j) + b.At(i, j);
+        return;
+    }
+
+    for (std::uint32_t i = 0; i < m; i++)
+    {
+        const float* a_row = a.data + i * a.ld;
+        const float* b_row = b.data + i * b.ld;
+        float* c_row = c + i * ldc;
+#pragma GCC ivdep
+        for (std::uint32_t j = 0; j < n; j++)
+            c_row[j] = a_row[j] + b_row[j];
+    }
+}
+
+void Sub(std::uint32_t m, std::uint32_t n, Operand a, Operand b, float* c, std::size_t ldc)
+{
+    if (a.trans || b.trans)
+    {
+        for (std::uint32_t i = 0; i < m; i++)
+         for (std::uint32_t j = 0; j < n; j++)
+            c[i * ldc + j] = a.At(i, j) - b.At(i, j);
+        return;
+    }
+
+    for (std::uint32_t i = 0; i < m; i++)
+    {
+        const float* a_row = a.data + i * a.ld;
+        const float* b_row = b.data + i * b.ld;
+        float* c_row = c + i * ldc;
+#pragma GCC ivdep
+        for (std::uint32_t j = 0; j < n; j++)
+            c_row[j] = a_row[j] - b_row[j];
+    }
+}
+
+bool NeedRecursion(std::uint32_t m, std::uint32_t n, std::uint32_t k, std::uint32_t cutoff)
+{
+    return std::min({ m, n, k }) / 2 >= std::max(cutoff, 1u);
+}
+
+// Размер буфера под временные матрицы всех уровней рекурсии
+std::size_t WorkspaceSize(std::uint32_t m, std::uint32_t n, std::uint32_t k, std::uint32_t cutoff)
+{
+    if (!NeedRecursion(m, n, k, cutoff))
+        return 0;
+
+    const std::size_t m2 = m / 2, n2 = n / 2, k2 = k / 2;
+    const std::size_t x_size = m2 * std::max(k2, n2); // S1..S4 и P1
+    const std::size_t y_size = k2 * n2;               // T1..T4
+    return x_size + y_size + WorkspaceSize(m2, n2, k2, cutoff);
+}
+
+void Strassen(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+              Operand a, Operand b,
+              float* c, std::size_t ldc,
+              std::uint32_t cutoff, float* workspace)
+{
+    if (!NeedRecursion(m, n, k, cutoff))
+        return Gemm(m, n, k, a, b, c, ldc);
+
+    const std::uint32_t m2 = m / 2, n2 = n / 2, k2 = k / 2;
+
+    const Operand a11 = a;
+    const Operand a12 = a.Block(0, k2);
+    const Operand a21 = a.Block(m2, 0);
+    const Operand a22 = a.Block(m2, k2);
+
+    const Operand b11 = b;
+    const Operand b12 = b.Block(0, n2);
+    const Operand b21 = b.Block(k2, 0);
+    const Operand b22 = b.Block(k2, n2);
+
+    float* c11 = c;
+    float* c12 = c + n2;
+    float* c21 = c + m2 * ldc;
+    float* c22 = c21 + n2;
+
+    // Временные этого уровня, остаток буфера - для следующих
+    const std::size_t ldx = std::max(k2, n2);
+    float* x = workspace;
+    float* y = x + std::size_t(m2) * ldx;
+    const std::size_t ldy = n2;
+    float* next = y + std::size_t(k2) * n2;
+
+    // Временные и блоки C как входы следующих операций
+    const Operand xs{ x, ldx }, ys{ y, ldy };
+    const Operand c11s{ c11, ldc }, c12s{ c12, ldc }, c21s{ c21, ldc }, c22s{ c22, ldc };
+
+    auto mul = [&](Operand lhs, Operand rhs, float* out, std::size_t ldo)
+    {
+        Strassen(m2, n2, k2, lhs, rhs, out, ldo, cutoff, next);
+    };
+
+    Sub(m2, k2, a11, a21, x, ldx);          // S3 = A11 - A21
+    Sub(k2, n2, b22, b12, y, ldy);          // T3 = B22 - B12
+    mul(xs, ys, c21, ldc);                  // P7 = S3 * T3      -> C21
+    Add(m2, k2, a21, a22, x, ldx);          // S1 = A21 + A22
+    Sub(k2, n2, b12, b11, y, ldy);          // T1 = B12 - B11
+    mul(xs, ys, c22, ldc);                  // P5 = S1 * T1      -> C22
+    Sub(m2, k2, xs, a11, x, ldx);           // S2 = S1 - A11
+    Sub(k2, n2, b22, ys, y, ldy);           // T2 = B22 - T1
+    mul(xs, ys, c12, ldc);                  // P6 = S2 * T2      -> C12
+    Sub(m2, k2, a12, xs, x, ldx);           // S4 = A12 - S2
+    mul(xs, b22, c11, ldc);                 // P3 = S4 * B22     -> C11
+    mul(a11, b11, x, ldx);                  // P1 = A11 * B11    -> X
+    Add(m2, n2, xs, c12s, c12, ldc);        // U2 = P1 + P6      -> C12
+    Add(m2, n2, c12s, c21s, c21, ldc);      // U3 = U2 + P7      -> C21
+    Add(m2, n2, c12s, c22s, c12, ldc);      // U4 = U2 + P5      -> C12
+    Add(m2, n2, c21s, c22s, c22, ldc);      // U7 = U3 + P5      -> C22 (итог)
+    Add(m2, n2, c12s, c11s, c12, ldc);      // U5 = U4 + P3      -> C12 (итог)
+    Sub(k2, n2, ys, b21, y, ldy);           // T4 = T2 - B21
+    mul(a22, ys, c11, ldc);                 // P4 = A22 * T4     -> C11
+    Sub(m2, n2, c21s, c11s, c21, ldc);      // U6 = U3 - P4      -> C21 (итог)
+    mul(a12, b21, c11, ldc);                // P2 = A12 * B21    -> C11
+    Add(m2, n2, xs, c11s, c11, ldc);        // U1 = P1 + P2      -> C11 (итог)
+
+    // Отщепленные при нечетных размерах строка/столбец. Это O(n^2) работы, поэтому
+    // простыми циклами: блочному ядру пришлось бы дополнять их до MR/NR нулями.
+    const std::uint32_t me = 2 * m2, ne = 2 * n2, ke = 2 * k2;
+    if (ke != k)
+    {
+        // C[:me, :ne] += A[:me, k-1] * B[k-1, :ne]
+        for (std::uint32_t i = 0; i < me; i++)
+        {
+            const float av = a.At(i, ke);
+            float* c_row = c + i * ldc;
+            for (std::uint32_t j = 0; j < ne; j++)
+                c_row[j] += av * b.At(ke, j);
+        }
+    }
+    if (ne != n)
+    {
+        // C[:, n-1] = A * B[:, n-1]
+        for (std::uint32_t i = 0; i < m; i++)
+        {
+            float sum = 0;
+            for (std::uint32_t p = 0; p < k; p++)
+                sum += a.At(i, p) * b.At(p, ne);
+            c[i * ldc + ne] = sum;
+        }
+    }
+    if (me != m)
+    {
+        // C[m-1, :ne] = A[m-1, :] * B[:, :ne]
+        float* c_row = c + me * ldc;
+        std::fill(c_row, c_row + ne, 0.f);
+        for (std::uint32_t p = 0; p < k; p++)
+        {
+            const float av = a.At(me, p);
+            for (std::uint32_t j = 0; j < ne; j++)
+                c_row[j] += av * b.At(p, j);
+        }
+    }
+}
+
+} // namespace
+
+
+void StrassenGemm(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+                  Operand a, Operand b,
+                  float* c, std::size_t ldc,
+                  std::uint32_t cutoff)
+{
+    // Одно выделение на весь вызов, уровни рекурсии нарезают его между собой
+    std::unique_ptr<float[]> workspace(new float[WorkspaceSize(m, n, k, cutoff)]);
+    Strassen(m, n, k, a, b, c, ldc, cutoff, workspace.get());
+}
+
+} // namespace matrix_op::detail
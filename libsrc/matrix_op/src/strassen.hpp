@@ -0,0 +1,20 @@
+#pragma once
+
+#include "gemm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace matrix_op::detail {
+
+// C = op(A) * op(B) по схеме Штрассена-Винограда (7 умножений и 15 сложений на уровень).
+// Рекурсия идет, пока половины не меньше cutoff, ниже - обычный блочный Gemm.
+// Нечетные размеры обрабатываются отщеплением последней строки/столбца.
+// Временные матрицы берутся из одного выделяемого на весь вызов буфера,
+// по расписанию с двумя временными на уровень (Boyer, Dumas, Pernet, Zhou).
+void StrassenGemm(std::uint32_t m, std::uint32_t n, std::uint32_t k,
+                  Operand a, Operand b,
+                  float* c, std::size_t ldc,
+                  std::uint32_t cutoff);
+
+} // namespace matrix_op::detail
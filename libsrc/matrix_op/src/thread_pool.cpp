@@ -0,0 +1,187 @@
+#include "thread_pool.hpp"
+
+#include "matrix_op/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+namespace matrix_op::detail {
+
+struct ThreadPool::Job
+{
+    const std::function<void(std::size_t)>* task;
+    std::size_t count;
+
+    std::atomic<std::size_t> next = 0;
+    std::atomic<std::size_t> finished = 0;
+
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::exception_ptr error;
+
+    // Берет задачи, пока они есть
+    void Work()
+    {
+        for (std::size_t idx = next++; idx < count; idx = next++)
+        {
+            try
+            {
+                (*task)(idx);
+            }
+            catch (...)
+            {
+                std::lock_guard lock(mutex);
+                if (!error)
+                    error = std::current_exception();
+            }
+
+            if (++finished == count)
+            {
+                std::lock_guard lock(mutex);
+                done_cv.notify_all();
+            }
+        }
+    }
+};
+
+
+ThreadPool::ThreadPool(std::uint32_t threads)
+{
+    for (std::uint32_t i = 1; i < threads; i++)
+        workers_.emplace_back([this] { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& task)
+{
+    if (count == 0)
+        return;
+
+    auto job = std::make_shared<Job>();
+    job->task = &task;
+    job->count = count;
+
+    if (count > 1 && !workers_.empty())
+    {
+        {
+            std::lock_guard lock(mutex_);
+            jobs_.push_back(job);
+        }
+        cv_.notify_all();
+    }
+
+    job->Work();
+
+    {
+        std::unique_lock lock(job->mutex);
+        job->done_cv.wait(lock, [&job] { return job->finished.load() == job->count; });
+    }
+
+    if (job->error)
+        std::rethrow_exception(job->error);
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (stop_)
+                return;
+            job = jobs_.front();
+        }
+
+        job->Work();
+
+        // Все индексы разобраны - убираем работу из очереди (если этого еще не сделал другой поток)
+        std::lock_guard lock(mutex_);
+        if (!jobs_.empty() && jobs_.front() == job)
+            jobs_.pop_front();
+    }
+}
+
+
+namespace {
+
+std::uint32_t HardwareThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+struct SharedPoolState
+{
+    std::mutex mutex;
+    std::shared_ptr<ThreadPool> pool;
+    std::atomic<std::uint64_t> threshold = DefaultParallelThreshold;
+};
+
+SharedPoolState& PoolState()
+{
+    static SharedPoolState state;
+    return state;
+}
+
+} // namespace
+
+std::shared_ptr<ThreadPool> SharedPool()
+{
+    auto& state = PoolState();
+    std::lock_guard lock(state.mutex);
+    if (!state.pool)
+        state.pool = std::make_shared<ThreadPool>(HardwareThreads());
+    return state.pool;
+}
+
+} // namespace matrix_op::detail
+
+
+namespace matrix_op {
+
+void SetParallelism(std::uint32_t threads)
+{
+    if (threads == 0)
+        threads = detail::HardwareThreads();
+
+    auto& state = detail::PoolState();
+    std::shared_ptr<detail::ThreadPool> old_pool;
+    {
+        std::lock_guard lock(state.mutex);
+        if (state.pool && state.pool->Threads() == threads)
+            return;
+        // Старый пул доработает текущие операции и будет разрушен последним владельцем
+        old_pool = std::exchange(state.pool, std::make_shared<detail::ThreadPool>(threads));
+    }
+}
+
+std::uint32_t Parallelism()
+{
+    return detail::SharedPool()->Threads();
+}
+
+void SetParallelThreshold(std::uint64_t volume)
+{
+    detail::PoolState().threshold = volume;
+}
+
+std::uint64_t ParallelThreshold()
+{
+    return detail::PoolState().threshold;
+}
+
+} // namespace matrix_op
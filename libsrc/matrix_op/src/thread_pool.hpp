@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace matrix_op::detail {
+
+// Пул для fork/join внутри одной операции.
+// Вызывающий ParallelFor поток сам тоже берет задачи, поэтому вложенные и
+// одновременные (из разных потоков запросов) вызовы не приводят к дедлоку.
+class ThreadPool
+{
+public:
+    // threads - полное число исполнителей, включая вызывающий поток
+    explicit ThreadPool(std::uint32_t threads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    std::uint32_t Threads() const { return workers_.size() + 1; }
+
+    // Исполняет task(0) ... task(count - 1), возвращается после завершения всех.
+    // Первое исключение из задач пробрасывается вызывающему.
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& task);
+
+private:
+    struct Job;
+
+    void WorkerLoop();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    bool stop_ = false;
+
+    std::vector<std::thread> workers_;
+};
+
+// Общий пул процесса, размер - Parallelism()
+std::shared_ptr<ThreadPool> SharedPool();
+
+} // namespace matrix_op::detail
@@ -0,0 +1,62 @@
+#include "matrix_op/matrix.hpp"
+#include "matrix_op/matrix_exception.hpp"
+
+#include <format>
+
+namespace matrix_op {
+
+namespace {
+
+// Лист рекурсии: блок 32 x 32 float-ов источника и результата (по 4 КБ) целиком в L1
+constexpr std::uint32_t TransposeLeaf = 32;
+
+// dst[j][i] = src[i][j] для блока rows x columns.
+// Кэш-независимо: большая сторона делится пополам, пока блок не станет листом, поэтому
+// и чтение, и запись идут по кэш-линиям без подбора параметров под конкретный кэш.
+void TransposeBlock(std::uint32_t rows, std::uint32_t columns,
+                    const float* src, std::size_t lds, float* dst, std::size_t ldd)
+{
+    if (rows <= TransposeLeaf && columns <= TransposeLeaf)
+    {
+        for (std::uint32_t i = 0; i < rows; i++)
+         for (std::uint32_t j = 0; j < columns; j++)
+            dst[j * ldd + i] = src[i * lds + j];
+        return;
+    }
+
+    if (rows >= columns)
+    {
+        const std::uint32_t half = rows / 2;
+        TransposeBlock(half, columns, src, lds, dst, ldd);
+        TransposeBlock(rows - half, columns, src + half * lds, lds, dst + half, ldd);
+    }
+    else
+    {
+        const std::uint32_t half = columns / 2;
+        TransposeBlock(rows, half, src, lds, dst, ldd);
+        TransposeBlock(rows, columns - half, src + half, lds, dst + half * ldd, ldd);
+    }
+}
+
+} // namespace
+
+
+void Transpose(MatrixView matrix, MutableMatrixView result)
+{
+    if (result.Rows() != matrix.Columns() || result.Columns() != matrix.Rows()) [[unlikely]]
+    {
+        throw MatrixCalcError(std::format("Invalid result shape for transpose: ({} x {})^T -> ({} x {})",
+                                          matrix.Rows(), matrix.Columns(), result.Rows(), result.Columns()));
+    }
+
+    TransposeBlock(matrix.Rows(), matrix.Columns(), matrix.Data(), matrix.Stride(), result.Data(), result.Stride());
+}
+
+Matrix Transpose(const Matrix& matrix)
+{
+    Matrix result(matrix.columns_, matrix.rows_);
+    Transpose(matrix.View(), MutableMatrixView(result.rows_, result.columns_, result.stride_, result.storage_.Data()));
+    return result;
+}
+
+} // namespace matrix_op
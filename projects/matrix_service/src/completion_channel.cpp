@@ -0,0 +1,64 @@
+#include "completion_channel.hpp"
+#include "utility.hpp"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace matrix_service {
+
+CompletionChannel::CompletionChannel()
+{
+    VALIDATE_LINUX_CALL(event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+}
+
+CompletionChannel::~CompletionChannel()
+{
+    for (Node* node = head_.load(std::memory_order_acquire); node;)
+        delete std::exchange(node, node->next);
+    close(event_fd_);
+}
+
+void CompletionChannel::Push(Completion completion)
+{
+    Node* node = new Node{std::move(completion)};
+    // После публикации узел может быть уже забран и удален циклом: прежнюю голову держим отдельно
+    Node* next = head_.load(std::memory_order_relaxed);
+    do
+    {
+        node->next = next;
+    } while (!head_.compare_exchange_weak(next, node, std::memory_order_release, std::memory_order_relaxed));
+
+    // Цикл еще не забрал прежние завершения - значит, уже разбужен
+    if (!next)
+    {
+        const std::uint64_t one = 1;
+        VALIDATE_LINUX_CALL(int(write(event_fd_, &one, sizeof(one))));
+    }
+}
+
+void CompletionChannel::Wake()
+{
+    const std::uint64_t one = 1;
+    [[maybe_unused]] auto res = write(event_fd_, &one, sizeof(one));
+}
+
+void CompletionChannel::TakeAll(std::vector<Completion>& out)
+{
+    std::uint64_t counter = 0;
+    // EAGAIN - счетчик уже сброшен прошлым вызовом, это не ошибка
+    [[maybe_unused]] auto res = read(event_fd_, &counter, sizeof(counter));
+
+    // Стек отдает завершения от новых к старым, возвращаем порядок поступления
+    out.clear();
+    for (Node* node = head_.exchange(nullptr, std::memory_order_acquire); node;)
+    {
+        out.push_back(std::move(node->completion));
+        delete std::exchange(node, node->next);
+    }
+    std::reverse(out.begin(), out.end());
+}
+
+} // namespace matrix_service
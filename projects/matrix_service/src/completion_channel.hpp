@@ -0,0 +1,49 @@
+#pragma once
+
+#include "executor/executor.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace matrix_service {
+
+// Доставка результатов SubmitProcedure в поток цикла событий: потоки пула кладут результат
+// в очередь и будят цикл через eventfd, который тот слушает в epoll вместе с сокетами.
+// Очередь без блокировок: писатели добавляют в стек, цикл забирает его целиком одной операцией.
+class CompletionChannel
+{
+public:
+    struct Completion
+    {
+        int client_socket;
+        std::uint64_t client_id; // Сокет мог закрыться и достаться новому клиенту, пока шло исполнение
+        AsyncProcedure procedure;
+    };
+
+    CompletionChannel();
+    CompletionChannel(const CompletionChannel&) = delete;
+    CompletionChannel& operator=(const CompletionChannel&) = delete;
+    ~CompletionChannel();
+
+    int Fd() const { return event_fd_; }
+
+    // Из любого потока
+    void Push(Completion completion);
+    // Будит цикл без завершений (например, для остановки). Можно из обработчика сигнала
+    void Wake();
+    // В потоке цикла по событию на Fd(): забирает накопленное (out очищается)
+    void TakeAll(std::vector<Completion>& out);
+
+private:
+    struct Node
+    {
+        Completion completion;
+        Node* next = nullptr;
+    };
+
+    int event_fd_ = -1;
+    std::atomic<Node*> head_ = nullptr;
+};
+
+} // namespace matrix_service
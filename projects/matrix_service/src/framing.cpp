@@ -0,0 +1,31 @@
+#include "framing.hpp"
+
+#include <cstring>
+
+namespace matrix_service {
+
+std::optional<std::uint64_t> ReadRequestId(const char* frame)
+{
+    std::uint32_t raw_size = 0;
+    std::memcpy(&raw_size, frame, sizeof(raw_size));
+    if (!HasRequestId(raw_size))
+        return std::nullopt;
+
+    std::uint64_t request_id = 0;
+    std::memcpy(&request_id, frame + FrameSizeBytes, sizeof(request_id));
+    return request_id;
+}
+
+void TagResponse(std::vector<char>& framed_response, std::uint64_t request_id)
+{
+    // Сдвиг содержимого на 8 байт дешев рядом с исполнением запроса
+    const char* id_bytes = reinterpret_cast<const char*>(&request_id);
+    framed_response.insert(framed_response.begin() + FrameSizeBytes, id_bytes, id_bytes + RequestIdBytes);
+
+    std::uint32_t raw_size = 0;
+    std::memcpy(&raw_size, framed_response.data(), sizeof(raw_size));
+    raw_size |= RequestIdFlag;
+    std::memcpy(framed_response.data(), &raw_size, sizeof(raw_size));
+}
+
+} // namespace matrix_service
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace matrix_service {
+
+// Кадр запроса и ответа: 4 байта размера содержимого, затем содержимое (ProcedureData).
+// Старший бит размера - кадр с номером запроса: между размером и содержимым лежит 8 байт номера.
+// Ответ на такой запрос несет тот же номер. С keepalive клиент может слать кадры с номерами,
+// не дожидаясь ответов: сервер исполняет их параллельно и отвечает по готовности, в любом порядке.
+// Кадр без номера, как и раньше, - следующий запрос читается только после ответа на него.
+inline constexpr std::uint32_t RequestIdFlag = 0x80000000u;
+inline constexpr std::size_t FrameSizeBytes = sizeof(std::uint32_t);
+inline constexpr std::size_t RequestIdBytes = sizeof(std::uint64_t);
+
+// Сколько запросов одного соединения может исполняться и ждать отправки одновременно
+inline constexpr std::size_t MaxPipelinedRequests = 64;
+
+inline bool HasRequestId(std::uint32_t raw_size)
+{
+    return raw_size & RequestIdFlag;
+}
+
+inline std::uint32_t ContentSize(std::uint32_t raw_size)
+{
+    return raw_size & ~RequestIdFlag;
+}
+
+// Размер заголовка кадра: префикс размера и, если есть, номер запроса
+inline std::size_t FrameHeaderSize(std::uint32_t raw_size)
+{
+    return FrameSizeBytes + (HasRequestId(raw_size) ? RequestIdBytes : 0);
+}
+
+// Номер запроса из заголовка кадра (начало кадра)
+std::optional<std::uint64_t> ReadRequestId(const char* frame);
+
+// Вставляет номер запроса в ответ ExecuteProcedure (префикс размера уже записан в начале)
+void TagResponse(std::vector<char>& framed_response, std::uint64_t request_id);
+
+} // namespace matrix_service
@@ -2,6 +2,8 @@
 #include "st_blocking_server.hpp"
 #include "mt_blocking_server.hpp"
 #include "st_nonblocking_server.hpp"
+#include "mr_nonblocking_server.hpp"
+#include "uring_server.hpp"
 
 #include "cxxopts.hpp"
 
@@ -28,11 +30,13 @@ int main(int argc, char* argv[])
     using namespace std::string_literals;
 
     static constexpr int ArgErrorExitCode = 1;
-    constexpr std::string_view AllowedServerType = "st_blocking, st_nonblocking";
+    constexpr std::string_view AllowedServerType = "st_blocking, mt_blocking, st_nonblocking, mr_nonblocking, hybrid, uring";
 
     matrix_service::Server::Config conf;
 
     std::string server_type;
+    std::size_t result_cache_mb = 0;
+    std::size_t matrix_store_mb = 0;
     cxxopts::Options opts(argv[0], "- options for matrix server");
     opts.add_options()
         ("h,help", "show help")
@@ -40,7 +44,31 @@ int main(int argc, char* argv[])
         ("a,address", "the listening address", cxxopts::value<std::string>(conf.listening_address)->default_value("0.0.0.0"s))
         ("p,port", "the port for app", cxxopts::value<std::uint16_t>(conf.port)->default_value("8080"s))
         ("k,keepalive", "should server support keepalive mode", cxxopts::value<bool>(conf.keepalive)->default_value("false"s))
-        ("t,threads", "thread limit for MtBlockingServer", cxxopts::value<std::uint16_t>(conf.thread_limit)->default_value("2"s));
+        ("t,threads", "thread limit for mt_blocking server, event loops of mr_nonblocking and hybrid servers (0 - by the number of cores)", cxxopts::value<std::uint16_t>(conf.thread_limit)->default_value("2"s))
+        ("work_stealing", "per-thread connection queues of mt_blocking server with stealing between them",
+            cxxopts::value<bool>(conf.work_stealing)->default_value("false"s))
+        ("c,compute_threads", "threads for a single multiplication, 0 - by the number of cores",
+            cxxopts::value<std::uint16_t>(conf.executor.compute_threads)->default_value("0"s))
+        ("parallel_threshold", "min rows * inner * columns of a multiplication to run it in parallel",
+            cxxopts::value<std::uint64_t>(conf.executor.parallel_threshold)->default_value(std::to_string(conf.executor.parallel_threshold)))
+        ("request_threads", "threads executing requests of st_nonblocking, hybrid and uring servers, 0 - by the number of cores",
+            cxxopts::value<std::uint16_t>(conf.executor.request_threads)->default_value("0"s))
+        ("small_request_slots", "concurrent requests cheaper than small_request_cost, 0 in both slot options - no scheduler",
+            cxxopts::value<std::uint16_t>(conf.executor.small_request_slots)->default_value("0"s))
+        ("large_request_slots", "concurrent requests at least as expensive as small_request_cost",
+            cxxopts::value<std::uint16_t>(conf.executor.large_request_slots)->default_value("0"s))
+        ("small_request_cost", "max rows * inner * columns of a small request",
+            cxxopts::value<std::uint64_t>(conf.executor.small_request_cost)->default_value(std::to_string(conf.executor.small_request_cost)))
+        ("request_aging_ms", "waiting time that halves the estimated cost of a queued request",
+            cxxopts::value<std::uint32_t>(conf.executor.request_aging_ms)->default_value(std::to_string(conf.executor.request_aging_ms)))
+        ("coalesce_window_us", "how long concurrent multiplications by the same matrix wait for each other, 0 - no coalescing",
+            cxxopts::value<std::uint32_t>(conf.executor.coalesce_window_us)->default_value("0"s))
+        ("result_cache_mb", "memory limit of the cache of responses to repeated requests, 0 - no cache",
+            cxxopts::value<std::size_t>(result_cache_mb)->default_value("0"s))
+        ("matrix_store_mb", "memory limit of matrices uploaded once and referenced by handle, 0 - no store",
+            cxxopts::value<std::size_t>(matrix_store_mb)->default_value("0"s))
+        ("mapped_matrix_dir", "directory of matrix files multiplied without loading into memory, empty - disabled",
+            cxxopts::value<std::string>(conf.executor.mapped_matrix_dir)->default_value(""s));
 
     try
     {
@@ -58,12 +86,32 @@ int main(int argc, char* argv[])
         return ArgErrorExitCode;
     }
 
+    conf.executor.result_cache_bytes = result_cache_mb << 20;
+    conf.executor.matrix_store_bytes = matrix_store_mb << 20;
+    // Вычислительный пул гибрида закреплен за ядрами, циклы ввода-вывода - нет
+    conf.executor.pin_request_threads = server_type == "hybrid";
+    matrix_service::ConfigureExecutor(conf.executor);
+
     if (server_type == "st_blocking")
         g_server = std::make_unique<matrix_service::StBlockingServer>(std::move(conf));
     else if (server_type == "mt_blocking")
         g_server = std::make_unique<matrix_service::MtBlockingServer>(std::move(conf));
     else if (server_type == "st_nonblocking")
         g_server = std::make_unique<matrix_service::StNonblockingServer>(std::move(conf));
+    else if (server_type == "mr_nonblocking")
+        g_server = std::make_unique<matrix_service::MultiReactorServer>(std::move(conf), true);
+    else if (server_type == "hybrid")
+        g_server = std::make_unique<matrix_service::MultiReactorServer>(std::move(conf), false);
+    else if (server_type == "uring")
+    {
+        if (matrix_service::Uring::Supported())
+            g_server = std::make_unique<matrix_service::UringServer>(std::move(conf));
+        else
+        {
+            std::cerr << "io_uring is not supported by the kernel, falling back to st_nonblocking" << std::endl;
+            g_server = std::make_unique<matrix_service::StNonblockingServer>(std::move(conf));
+        }
+    }
     else
     {
         std::cerr << "Unknown type of server: '" << server_type << "', allowed: " << AllowedServerType << std::endl;
@@ -0,0 +1,69 @@
+#include "mr_nonblocking_server.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+
+namespace matrix_service
+{
+    namespace
+    {
+        // Поток цикла не мигрирует между ядрами: кэши и очереди сетевой карты остаются своими
+        void PinToCore(std::thread &thread, unsigned core)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(core, &cpus);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+
+    MultiReactorServer::MultiReactorServer(Config conf, bool execute_inline)
+        : Server(std::move(conf)), execute_inline_(execute_inline)
+    {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        const unsigned count = Cfg().thread_limit != 0 ? Cfg().thread_limit : cores;
+
+        StNonblockingServer::LoopOptions options;
+        options.reuse_port = true;
+        options.execute_inline = execute_inline_;
+
+        reactors_.reserve(count);
+        for (unsigned i = 0; i < count; ++i)
+            reactors_.push_back(std::make_unique<StNonblockingServer>(Cfg(), options));
+    }
+
+    MultiReactorServer::~MultiReactorServer()
+    {
+        OnStop();
+    }
+
+    void MultiReactorServer::Run()
+    {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+        // Все циклы - в своих потоках, цикл i на ядре i % cores. Вызывающий поток только ждет их:
+        // его закрепление унаследовали бы все потоки, которые он создаст потом
+        std::vector<std::thread> threads;
+        threads.reserve(reactors_.size());
+        for (std::size_t i = 0; i < reactors_.size(); ++i)
+        {
+            threads.emplace_back([reactor = reactors_[i].get()]
+                                 { reactor->Run(); });
+            // В гибриде ядра отданы вычислительному пулу, циклы ввода-вывода планирует ОС
+            if (execute_inline_)
+                PinToCore(threads.back(), i % cores);
+        }
+
+        for (auto &thread : threads)
+            thread.join();
+    }
+
+    void MultiReactorServer::OnStop()
+    {
+        // Только пробуждение циклов: безопасно в обработчике сигнала
+        for (auto &reactor : reactors_)
+            reactor->Stop();
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "server.hpp"
+#include "st_nonblocking_server.hpp"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace matrix_service
+{
+
+    // Несколько независимых циклов событий. Каждый слушает порт своим сокетом с SO_REUSEPORT,
+    // и ядро ОС само распределяет между ними соединения; соединение живет в одном цикле.
+    //  - execute_inline: циклы по одному на ядро исполняют запросы сами, у них нет общих очередей и блокировок;
+    //  - иначе (гибрид): циклы только читают кадры и пишут ответы, запросы исполняет пул SubmitProcedure
+    //    (см. ExecutorConfig::pin_request_threads), ответы возвращаются в свой цикл через его eventfd.
+    //    Медленные клиенты не занимают вычислительные потоки, а тяжелые запросы не задерживают ввод-вывод.
+    class MultiReactorServer : public Server
+    {
+    public:
+        // Число циклов - conf.thread_limit, 0 - по числу ядер
+        MultiReactorServer(Config conf, bool execute_inline);
+        ~MultiReactorServer();
+
+        void Run() override;
+
+    private:
+        void OnStop() override;
+
+        bool execute_inline_;
+        std::vector<std::unique_ptr<StNonblockingServer>> reactors_;
+    };
+}
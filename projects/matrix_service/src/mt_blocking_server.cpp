@@ -1,8 +1,12 @@
 #include "mt_blocking_server.hpp"
+#include "framing.hpp"
 #include "utility.hpp"
 #include "executor/executor.hpp"
 
+#include <cstdint>
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 namespace matrix_service
 {
@@ -23,49 +27,60 @@ namespace matrix_service
 
         constexpr std::uint32_t queue_size = 5;
         listen(server_socket_, queue_size);
-        thread_limit_ = Cfg().thread_limit;
+
+        const std::size_t workers = Cfg().thread_limit != 0 ? Cfg().thread_limit
+                                                            : std::max(1u, std::thread::hardware_concurrency());
+        const std::size_t queues = Cfg().work_stealing ? workers : 1;
+        const std::size_t queue_capacity = std::max<std::size_t>(SocketQueueCapacity / queues, 1);
+        for (std::size_t i = 0; i < queues; ++i)
+            queues_.push_back(std::make_unique<BoundedMpmcQueue<int>>(queue_capacity));
+        free_slots_.release(queue_capacity * queues);
+
+        workers_.reserve(workers);
+        for (std::size_t i = 0; i < workers; ++i)
+            workers_.emplace_back([this, i]
+                                  { WorkerLoop(i); });
     }
 
     MtBlockingServer::~MtBlockingServer()
     {
         OnStop();
-        JoinCompletedThreads();
-        for (auto &[id, thread] : active_threads_)
+        for (auto &worker : workers_)
         {
-            if (thread.joinable())
-            {
-                thread.join();
-            }
+            worker.join();
+        }
+
+        // Соединения, до которых не дошла очередь
+        for (auto &queue : queues_)
+        {
+            int client_socket = -1;
+            while (queue->TryPop(client_socket))
+                close(client_socket);
         }
     }
 
     void MtBlockingServer::OnStop()
     {
-        stop_requested_ = true;
+        if (stop_requested_.exchange(true))
+            return;
+
         shutdown(server_socket_, SHUT_RDWR);
         close(server_socket_);
 
-        std::unique_lock<std::mutex> lock(mutex_);
-        cv_.notify_all();
+        // Будим всех ждущих: потоки-обработчики и Run, если очереди полны
+        queued_.release(workers_.size());
+        free_slots_.release();
     }
 
     void MtBlockingServer::Run()
     {
         while (!stop_requested_)
         {
+            // Очереди полны: не принимаем, соединения ждут в очереди listen
+            free_slots_.acquire();
+            if (stop_requested_)
             {
-                std::unique_lock<std::mutex> lock(mutex_);
-                if (active_threads_.size() >= thread_limit_)
-                {
-                    cv_.wait(lock, [this]
-                             { return !finished_threads_.empty() || stop_requested_; });
-                    JoinCompletedThreads();
-                }
-
-                if (stop_requested_)
-                {
-                    break;
-                }
+                break;
             }
 
             int client_socket = accept(server_socket_, nullptr, nullptr);
@@ -78,76 +93,103 @@ namespace matrix_service
                 break;
             }
 
-            std::thread client_thread(
-                [this, client_socket]
-                {
-                    HandleClient(client_socket);
-                    {
-                        std::unique_lock<std::mutex> lock(mutex_);
-                        finished_threads_.push(std::this_thread::get_id());
-                        cv_.notify_all();
-                    } 
-                }
-            );
+            Dispatch(client_socket);
+        }
+    }
 
-            {
-                std::unique_lock<std::mutex> lock(mutex_);
-                active_threads_.emplace(client_thread.get_id(), std::move(client_thread));
-            }
+    void MtBlockingServer::Dispatch(int client_socket)
+    {
+        // Свободное место гарантировано free_slots_, но не обязательно в очереди очередного потока
+        while (!queues_[next_queue_]->TryPush(client_socket))
+            next_queue_ = (next_queue_ + 1) % queues_.size();
+        next_queue_ = (next_queue_ + 1) % queues_.size();
+        queued_.release();
+    }
+
+    int MtBlockingServer::TakeSocket(std::size_t worker)
+    {
+        // Сокет гарантирован queued_: начинаем со своей очереди, затем забираем у соседей
+        const std::size_t own = worker % queues_.size();
+        int client_socket = -1;
+        for (std::size_t i = own;; i = (i + 1) % queues_.size())
+        {
+            if (queues_[i]->TryPop(client_socket))
+                return client_socket;
         }
     }
 
-    void MtBlockingServer::JoinCompletedThreads()
+    void MtBlockingServer::WorkerLoop(std::size_t worker)
     {
-        while (!finished_threads_.empty())
+        while (true)
         {
-            auto id = finished_threads_.front();
-            finished_threads_.pop();
+            queued_.acquire();
+            if (stop_requested_)
+            {
+                break;
+            }
 
-            auto it = active_threads_.find(id);
-            if (it != active_threads_.end())
+            const int client_socket = TakeSocket(worker);
+            free_slots_.release();
+            try
             {
-                if (it->second.joinable())
-                {
-                    it->second.join();
-                }
-                active_threads_.erase(it);
+                HandleClient(client_socket);
+            }
+            catch (const std::exception &e)
+            {
+                // Ошибка одного соединения не должна останавливать поток пула
+                std::cerr << e.what() << std::endl;
+                close(client_socket);
             }
         }
     }
 
     void MtBlockingServer::HandleClient(int client_socket)
     {
+        // Буферы переиспользуются между запросами соединения
+        std::vector<char> request;
+        std::vector<char> response;
+
         while (!stop_requested_)
         {
-            int content_size = 0;
-            if (!TryIOEnough(client_socket, sizeof(content_size), (char *)&content_size, &read))
+            std::uint32_t raw_size = 0;
+            if (!TryIOEnough(client_socket, sizeof(raw_size), (char *)&raw_size, &read))
+            {
+                break;
+            }
+
+            // Номер запроса (см. framing.hpp) только возвращается с ответом: здесь ответы и так по порядку
+            std::uint64_t request_id = 0;
+            if (HasRequestId(raw_size) && !TryIOEnough(client_socket, sizeof(request_id), (char *)&request_id, &read))
             {
                 break;
             }
 
+            const std::uint32_t content_size = ContentSize(raw_size);
+
             if (content_size == 0)
             {
                 continue;
             }
 
-            std::string request(content_size, '\0');
-            if (!TryIOEnough(client_socket, content_size, &request[0], &read))
+            request.resize(content_size);
+            if (!TryIOEnough(client_socket, content_size, request.data(), &read))
             {
                 break;
             }
 
-            auto result = ExecuteProcedure(request);
-
-            content_size = result.first.size();
-            if (!TryIOEnough(client_socket, sizeof(content_size), (char *)&content_size, &write) ||
-                !TryIOEnough(client_socket, content_size, result.first.data(), &write))
+            // Ответ уже с префиксом размера
+            const bool succeeded = ExecuteProcedure(std::string_view(request.data(), request.size()), response);
+            if (HasRequestId(raw_size))
+            {
+                TagResponse(response, request_id);
+            }
+            if (!TryIOEnough(client_socket, response.size(), response.data(), &write))
             {
                 break;
             }
 
             // Если пакет битый или нет keepalive, то не нужно читать дальше
-            if (!result.second || !Cfg().keepalive)
+            if (!succeeded || !Cfg().keepalive)
             {
                 break;
             }
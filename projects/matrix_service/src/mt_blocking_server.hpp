@@ -1,25 +1,27 @@
 #pragma once
 
 #include "server.hpp"
+#include "socket_queue.hpp"
 
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
-#include <map>
 #include <thread>
-#include <optional>
-#include <mutex>
-#include <condition_variable>
+#include <memory>
+#include <semaphore>
 #include <atomic>
 #include <algorithm>
 #include <cassert>
-#include <queue>
+#include <vector>
 
 namespace matrix_service
 {
 
+    // Потоки-обработчики создаются заранее и берут принятые сокеты из очередей без блокировок:
+    // одной общей или, с Config::work_stealing, своей, забирая работу у соседей, когда она пуста.
+    // Каждое соединение обслуживается одним потоком до закрытия.
     class MtBlockingServer : public Server
     {
     public:
@@ -29,18 +31,23 @@ namespace matrix_service
         void OnStop() override;
 
     private:
+        void WorkerLoop(std::size_t worker);
+        int TakeSocket(std::size_t worker);
+        void Dispatch(int client_socket);
         void HandleClient(int client_socket);
-        void RunThread(int client_socket);
-        void JoinCompletedThreads();
         template <typename IOFunc>
         bool TryIOEnough(int client_socket, std::size_t required_size, char *buff, IOFunc io_func);
 
-        std::size_t thread_limit_;
-        std::mutex mutex_;
-        std::condition_variable cv_;
-        std::map<std::thread::id, std::thread> active_threads_;
-        std::queue<std::thread::id> finished_threads_;
+        // Принятые, но еще не взятые потоками соединения - на все очереди вместе
+        static constexpr std::size_t SocketQueueCapacity = 1024;
+
+        std::vector<std::unique_ptr<BoundedMpmcQueue<int>>> queues_;
+        std::size_t next_queue_ = 0;
+        // Число сокетов в очередях и свободных мест в них: потоки спят, а не крутятся на пустой очереди
+        std::counting_semaphore<> queued_{0};
+        std::counting_semaphore<> free_slots_{0};
+        std::vector<std::thread> workers_;
         std::atomic<bool> stop_requested_;
         int server_socket_ = -1;
     };
-}
\ No newline at end of file
+}
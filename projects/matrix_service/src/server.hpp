@@ -1,5 +1,8 @@
 #pragma once
 
+#include "executor/executor.hpp"
+
+#include <atomic>
 #include <cstdint>
 #include <string>
 
@@ -16,6 +19,11 @@ public:
         // Держать ли соединение с клиентами, ожидая новых запросов, или закрыть сразу после отправки ответа?
         bool keepalive = false;
         std::uint16_t thread_limit;
+        // mt_blocking: у каждого потока своя очередь соединений, опустевшая берет работу из чужих
+        bool work_stealing = false;
+
+        // Настройки исполнения, общие для всех режимов сервера
+        ExecutorConfig executor;
     };
 
 public:
@@ -49,7 +57,7 @@ public:
 protected:
     void Swap(Server& another)
     {
-        std::swap(stop_required_, another.stop_required_);
+        stop_required_ = another.stop_required_.exchange(stop_required_);
         std::swap(cfg_, another.cfg_);
     }
     bool StopRequired() const { return stop_required_; }
@@ -58,7 +66,8 @@ protected:
 
 private:
     Config cfg_;
-    bool stop_required_ = false;
+    // Stop() зовется из обработчика сигнала, а циклы могут работать в других потоках
+    std::atomic<bool> stop_required_ = false;
 };
 
 } // namespace matrix_service
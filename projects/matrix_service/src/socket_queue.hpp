@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+namespace matrix_service
+{
+
+    // Ограниченная очередь без блокировок для многих писателей и читателей (схема Вьюкова):
+    // у каждой ячейки свой счетчик поколения, писатели и читатели соревнуются только за свой индекс.
+    template <typename T>
+    class BoundedMpmcQueue
+    {
+    public:
+        // Емкость округляется вверх до степени двойки
+        explicit BoundedMpmcQueue(std::size_t capacity)
+            : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+              cells_(std::make_unique<Cell[]>(mask_ + 1))
+        {
+            for (std::size_t i = 0; i <= mask_; ++i)
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        BoundedMpmcQueue(const BoundedMpmcQueue &) = delete;
+        BoundedMpmcQueue &operator=(const BoundedMpmcQueue &) = delete;
+
+        // false, если очередь полна
+        bool TryPush(T value)
+        {
+            std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell &cell = cells_[pos & mask_];
+                const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos);
+                if (diff == 0)
+                {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = std::move(value);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false; // Ячейку еще не освободил читатель прошлого круга
+                }
+                else
+                {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // false, если очередь пуста
+        bool TryPop(T &value)
+        {
+            std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            while (true)
+            {
+                Cell &cell = cells_[pos & mask_];
+                const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const auto diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        value = std::move(cell.value);
+                        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        const std::size_t mask_;
+        std::unique_ptr<Cell[]> cells_;
+        // Позиции писателей и читателей в разных кэш-линиях
+        alignas(64) std::atomic<std::size_t> enqueue_pos_ = 0;
+        alignas(64) std::atomic<std::size_t> dequeue_pos_ = 0;
+    };
+}
@@ -1,4 +1,5 @@
 #include "st_blocking_server.hpp"
+#include "framing.hpp"
 #include "utility.hpp"
 
 #include "executor/executor.hpp"
@@ -9,8 +10,10 @@
 #include <sys/socket.h>
 
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <utility>
+#include <vector>
 
 namespace matrix_service {
 
@@ -83,6 +86,10 @@ bool StBlockingServer::TryIOEnough(std::size_t required_size, char* buff, IOFunc
 
 void StBlockingServer::Run()
 {
+    // Буферы переиспользуются между запросами
+    std::vector<char> request;
+    std::vector<char> response;
+
     while (!StopRequired())
     {
         // 1. Прием соединения
@@ -106,32 +113,35 @@ void StBlockingServer::Run()
             // - При Stop() последний запрос не исполняется, в случае записи данных - запись обрывается
             // - При посылке ошибочного ProcedureData - закрываем соединение
             // TODO: Не копируйте это место из класса в класс - постарайтесь обобщить!
-            int content_size = 0;
-            if (!TryIOEnough(sizeof(content_size), (char*) &content_size, &read))
+            // - Кадр с номером запроса (см. framing.hpp): ответы здесь и так по порядку, номер только возвращается
+            std::uint32_t raw_size = 0;
+            if (!TryIOEnough(sizeof(raw_size), (char*) &raw_size, &read))
+                break;
+            std::uint64_t request_id = 0;
+            if (HasRequestId(raw_size) && !TryIOEnough(sizeof(request_id), (char*) &request_id, &read))
                 break;
+            const std::uint32_t content_size = ContentSize(raw_size);
             if (content_size == 0)
                 continue;
 
             // Если был shutdown() со стороны клиента, то просто еще раз получим 0
-            std::string request(content_size, '\0');
-            if (!TryIOEnough(content_size, &request[0], &read))
+            request.resize(content_size);
+            if (!TryIOEnough(content_size, request.data(), &read))
                 break;
 
 
             // 3. Исполнение
-            auto result = ExecuteProcedure(request);
+            const bool succeeded = ExecuteProcedure(std::string_view(request.data(), request.size()), response);
+            if (HasRequestId(raw_size))
+                TagResponse(response, request_id);
 
 
-            // 4. Запись ответа
-            content_size = result.first.size();
-            if (!TryIOEnough(sizeof(content_size), (char*) &content_size, &write) ||
-                !TryIOEnough(content_size, result.first.data(), &write))
-            {
+            // 4. Запись ответа: префикс размера уже в начале response
+            if (!TryIOEnough(response.size(), response.data(), &write))
                 break;
-            }
 
             // 5. Нужно ли читать следующий запрос?
-            if (!result.second || client_send_shutdown_)
+            if (!succeeded || client_send_shutdown_)
                 need_read_next = false;
             else
                 need_read_next = Cfg().keepalive;
@@ -1,22 +1,31 @@
 #include "st_nonblocking_server.hpp"
 #include "utility.hpp"
 
+#include <cstring>
+
 
 namespace matrix_service
 {
 
     StNonblockingServer::StNonblockingServer(Config conf)
-        : Server(std::move(conf))
+        : StNonblockingServer(std::move(conf), LoopOptions{})
+    {
+    }
+
+    StNonblockingServer::StNonblockingServer(Config conf, LoopOptions options)
+        : Server(std::move(conf)), options_(options)
     {
         VALIDATE_LINUX_CALL(server_socket_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0));
 
         int reuse = 1;
         VALIDATE_LINUX_CALL(setsockopt(server_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)));
+        if (options_.reuse_port)
+            VALIDATE_LINUX_CALL(setsockopt(server_socket_, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)));
 
         sockaddr_in server_address = {};
         server_address.sin_family = AF_INET;
-        VALIDATE_LINUX_CALL(inet_pton(AF_INET, conf.listening_address.c_str(), &server_address.sin_addr));
-        server_address.sin_port = htons(conf.port);
+        VALIDATE_LINUX_CALL(inet_pton(AF_INET, Cfg().listening_address.c_str(), &server_address.sin_addr));
+        server_address.sin_port = htons(Cfg().port);
 
         VALIDATE_LINUX_CALL(bind(server_socket_, (struct sockaddr *)&server_address, sizeof(server_address)));
         VALIDATE_LINUX_CALL(listen(server_socket_, 5));
@@ -26,6 +35,11 @@ namespace matrix_service
 
     StNonblockingServer::~StNonblockingServer()
     {
+        for (auto &client : clients_)
+        {
+            shutdown(client.first, SHUT_RDWR);
+            close(client.first);
+        }
         if (server_socket_ != -1)
         {
             shutdown(server_socket_, SHUT_RDWR);
@@ -46,6 +60,12 @@ namespace matrix_service
         event.data.fd = server_socket_;
         if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_socket_, &event) == -1)
             RaiseLinuxCallError(__LINE__, __FILE__, "epoll_ctl", "failed to add server socket to epoll");
+
+        completions_ = std::make_shared<CompletionChannel>();
+        event.events = EPOLLIN;
+        event.data.fd = completions_->Fd();
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, completions_->Fd(), &event) == -1)
+            RaiseLinuxCallError(__LINE__, __FILE__, "epoll_ctl", "failed to add completion channel to epoll");
     }
 
     void StNonblockingServer::Run()
@@ -55,25 +75,9 @@ namespace matrix_service
 
     void StNonblockingServer::OnStop()
     {
-        for (auto &client : clients_)
-        {
-            if (client.first != -1)
-            {
-                shutdown(client.first, SHUT_RDWR);
-                close(client.first);
-            }
-        }
-
-        if (epoll_fd_ != -1)
-        {
-            close(epoll_fd_);
-        }
-
-        if (server_socket_ != -1)
-        {
-            shutdown(server_socket_, SHUT_RDWR);
-            close(server_socket_);
-        }
+        // Цикл может работать в другом потоке: сокеты закрываются в деструкторе, после выхода из него
+        if (completions_)
+            completions_->Wake();
     }
 
     void StNonblockingServer::ProcessEvents()
@@ -97,23 +101,16 @@ namespace matrix_service
 
                 if (client_socket == server_socket_)
                 {
-                    int new_client = accept(server_socket_, nullptr, nullptr);
-                    if (new_client == -1)
-                        continue;
-
-                    int flags = fcntl(new_client, F_GETFL, 0);
-                    fcntl(new_client, F_SETFL, flags | O_NONBLOCK);
-
-                    epoll_event event = {};
-                    event.events = EPOLLIN;
-                    event.data.fd = new_client;
-                    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, new_client, &event) == -1)
-                    {
-                        close(new_client);
-                        continue;
-                    }
-
-                    clients_[new_client] = {};
+                    AcceptClients();
+                }
+                else if (client_socket == completions_->Fd())
+                {
+                    HandleCompletions();
+                }
+                else if (!(events[i].events & (EPOLLIN | EPOLLOUT)))
+                {
+                    // EPOLLHUP/EPOLLERR приходят и для сокета без подписки (клиент с исполняемым запросом)
+                    CloseClient(client_socket);
                 }
                 else
                 {
@@ -130,106 +127,269 @@ namespace matrix_service
         }
     }
 
-    void StNonblockingServer::HandleClientRead(int client_socket)
+    void StNonblockingServer::AcceptClients()
     {
-        auto &state = clients_[client_socket];
+        // Слушающий сокет в EPOLLET: событие одно на всю пачку соединений, принимаем до EAGAIN
+        while (true)
+        {
+            int new_client = accept4(server_socket_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (new_client == -1)
+                return;
 
-        if (state.read_buffer.empty())
-            state.read_buffer.resize(4);
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = new_client;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, new_client, &event) == -1)
+            {
+                close(new_client);
+                continue;
+            }
 
-        auto io_func = [](int sock, char *buffer, std::size_t size) -> int
+            clients_[new_client] = {};
+            clients_[new_client].id = next_client_id_++;
+        }
+    }
+
+    void StNonblockingServer::HandleClientRead(int client_socket)
+    {
+        auto it = clients_.find(client_socket);
+        if (it == clients_.end())
+            return;
+        auto &state = it->second;
+
+        auto io_func = [&state](int sock, char *buffer, std::size_t size) -> int
         {
-            return read(sock, buffer, size);
+            const int res = read(sock, buffer, size);
+            state.read_closed = state.read_closed || res == 0;
+            return res;
         };
 
-        if (!TryIOEnough(client_socket, state.read_buffer.size(), state.read_buffer.data(), io_func, state.read_offset))
+        // С конвейером в сокете может лежать несколько кадров подряд
+        while (WantsRead(state))
+        {
+            if (state.read_buffer.empty())
+                state.read_buffer.resize(FrameSizeBytes);
+
+            if (!TryIOEnough(client_socket, state.read_buffer.size(), state.read_buffer.data(), io_func, state.read_offset))
+            {
+                // Конец потока - не ошибка: клиент мог закрыть свою сторону, дожидаясь ответов
+                if (!state.read_closed)
+                {
+                    CloseClient(client_socket);
+                    return;
+                }
+                break;
+            }
+
+            if (state.read_offset < FrameSizeBytes)
+                break;
+
+            if (state.read_buffer.size() == FrameSizeBytes)
+            {
+                std::uint32_t raw_size = 0;
+                std::memcpy(&raw_size, state.read_buffer.data(), sizeof(raw_size));
+                state.read_buffer.resize(FrameHeaderSize(raw_size) + ContentSize(raw_size));
+            }
+
+            if (!TryIOEnough(client_socket, state.read_buffer.size(), state.read_buffer.data(), io_func, state.read_offset))
+            {
+                if (!state.read_closed)
+                {
+                    CloseClient(client_socket);
+                    return;
+                }
+                break;
+            }
+
+            if (state.read_offset < state.read_buffer.size())
+                break;
+
+            if (!DispatchFrame(client_socket, state))
+                return;
+        }
+
+        // Недочитанный кадр после конца потока уже не придет. Ответы на принятые еще отправятся,
+        // после них соединение закроет HandleClientWrite
+        if (state.read_closed && state.in_flight == 0 && state.write_buffer.empty())
         {
             CloseClient(client_socket);
             return;
         }
+        UpdateEvents(client_socket, state);
+    }
 
-        if (state.read_offset < 4)
-            return;
+    bool StNonblockingServer::DispatchFrame(int client_socket, ClientState &state)
+    {
+        std::uint32_t raw_size = 0;
+        std::memcpy(&raw_size, state.read_buffer.data(), sizeof(raw_size));
+        const std::size_t header_size = FrameHeaderSize(raw_size);
+        // Кадр с номером не ждет ответа на себя: следующий читается сразу
+        state.pipelining = HasRequestId(raw_size) && Cfg().keepalive;
+        state.read_offset = 0;
+
+        if (options_.execute_inline)
+        {
+            std::vector<char> response = std::move(state.spare_buffer);
+            bool succeeded = false;
+            try
+            {
+                succeeded = ExecuteProcedure(std::string_view(state.read_buffer.data() + header_size,
+                                                              state.read_buffer.size() - header_size),
+                                             response);
+            }
+            catch (...)
+            {
+                // Внутренняя ошибка: ответа нет, соединение закрывается
+                response.clear();
+            }
+            const auto request_id = ReadRequestId(state.read_buffer.data());
+            state.read_buffer.clear();
+            return QueueResponse(client_socket, state, std::move(response), request_id, succeeded);
+        }
 
+        // Буферы уходят в пул вместе с запросом и вернутся с ответом
+        AsyncProcedure procedure;
+        procedure.request = std::move(state.read_buffer);
+        procedure.request_offset = header_size;
+        procedure.framed_response = std::move(state.spare_buffer);
+        ++state.in_flight;
 
-        if (state.read_buffer.size() == 4)
+        SubmitProcedure(std::move(procedure),
+            [completions = completions_, client_socket, id = state.id](AsyncProcedure&& done)
+            {
+                completions->Push({ client_socket, id, std::move(done) });
+            });
+        return true;
+    }
+
+    void StNonblockingServer::HandleCompletions()
+    {
+        completions_->TakeAll(completed_);
+        for (auto &completion : completed_)
         {
-            int content_size = *reinterpret_cast<int *>(state.read_buffer.data());
-            state.read_buffer.resize(4 + content_size);
+            auto it = clients_.find(completion.client_socket);
+            if (it == clients_.end() || it->second.id != completion.client_id)
+                continue; // Клиент отключился, не дождавшись ответа
+
+            auto &state = it->second;
+            auto &procedure = completion.procedure;
+            --state.in_flight;
+            const auto request_id = ReadRequestId(procedure.request.data());
+            if (state.read_buffer.empty())
+            {
+                state.read_buffer = std::move(procedure.request);
+                state.read_buffer.clear();
+            }
+            if (QueueResponse(completion.client_socket, state, std::move(procedure.framed_response),
+                              request_id, procedure.succeeded))
+                UpdateEvents(completion.client_socket, state);
         }
+        completed_.clear();
+    }
 
-        if (!TryIOEnough(client_socket, state.read_buffer.size(), state.read_buffer.data(), io_func, state.read_offset))
+    bool StNonblockingServer::QueueResponse(int client_socket, ClientState &state, std::vector<char> &&response,
+                                            std::optional<std::uint64_t> request_id, bool succeeded)
+    {
+        if (response.empty())
         {
             CloseClient(client_socket);
-            return;
+            return false;
         }
 
-        if (state.read_offset == state.read_buffer.size())
+        // Битый запрос: больше не читаем, соединение закроется после отправки готовых ответов
+        state.is_closing = state.is_closing || !succeeded;
+        if (request_id)
+            TagResponse(response, *request_id);
+
+        if (state.write_buffer.empty())
+        {
+            state.write_buffer = std::move(response);
+            state.write_offset = 0;
+        }
+        else
         {
-            std::string request(state.read_buffer.begin() + 4, state.read_buffer.end());
-            auto response = ExecuteProcedure(request);
-            state.is_closing = !response.second;
-
-            int response_size = response.first.size();
-            state.write_buffer.resize(sizeof(response_size) + response_size);
-            std::memcpy(state.write_buffer.data(), &response_size, sizeof(response_size));
-            std::memcpy(
-                state.write_buffer.data() + sizeof(response_size),
-                response.first.data(),
-                response_size);
+            state.pending_responses.push_back(std::move(response));
+        }
+        return true;
+    }
 
-            state.read_buffer.clear();
-            state.read_offset = 0;
+    bool StNonblockingServer::WantsRead(const ClientState &state) const
+    {
+        if (state.is_closing || state.read_closed)
+            return false;
 
-            // Обновляем epoll на запись
-            epoll_event event = {};
-            event.events = EPOLLOUT;
-            event.data.fd = client_socket;
-            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_socket, &event);
-        }
+        const std::size_t outstanding = state.in_flight + state.pending_responses.size() + !state.write_buffer.empty();
+        if (outstanding == 0)
+            return true;
+        return state.pipelining && outstanding < MaxPipelinedRequests;
+    }
+
+    void StNonblockingServer::UpdateEvents(int client_socket, ClientState &state)
+    {
+        std::uint32_t events = 0;
+        if (WantsRead(state))
+            events |= EPOLLIN;
+        if (!state.write_buffer.empty())
+            events |= EPOLLOUT;
+        if (events == state.events)
+            return;
+
+        // Без подписки сокет не слушается, пока исполняется запрос (EPOLLHUP/EPOLLERR приходят все равно)
+        epoll_event event = {};
+        event.events = events;
+        event.data.fd = client_socket;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_socket, &event);
+        state.events = events;
     }
 
     void StNonblockingServer::HandleClientWrite(int client_socket)
     {
-        auto &state = clients_[client_socket];
+        auto it = clients_.find(client_socket);
+        if (it == clients_.end())
+            return;
+        auto &state = it->second;
 
         auto io_func = [](int sock, char *buffer, std::size_t size) -> int
         {
             return write(sock, buffer, size);
         };
 
-
-        if (!TryIOEnough(
-            client_socket, 
-            state.write_buffer.size(), 
-            state.write_buffer.data(), 
-            io_func, 
-            state.write_offset))
+        while (!state.write_buffer.empty())
         {
-            CloseClient(client_socket);
-            return;
-        }
+            if (!TryIOEnough(
+                client_socket,
+                state.write_buffer.size(),
+                state.write_buffer.data(),
+                io_func,
+                state.write_offset))
+            {
+                CloseClient(client_socket);
+                return;
+            }
 
-        if (state.write_offset == state.write_buffer.size())
-        {
+            if (state.write_offset < state.write_buffer.size())
+                break;
+
+            // Буфер отправленного ответа пойдет под следующий
+            state.spare_buffer = std::move(state.write_buffer);
+            state.spare_buffer.clear();
             state.write_buffer.clear();
             state.write_offset = 0;
-
-            // Если пакет не был битым и keepalive == true, то нужно читать следующий запрос
-            bool read_next = Cfg().keepalive && !state.is_closing;
-            if (read_next)
+            if (!state.pending_responses.empty())
             {
-                // Обновляем epoll на чтение
-                epoll_event event = {};
-                event.events = EPOLLIN;
-                event.data.fd = client_socket;
-                epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, client_socket, &event);
-            }
-            else
-            {
-                CloseClient(client_socket);
+                state.write_buffer = std::move(state.pending_responses.front());
+                state.pending_responses.pop_front();
             }
         }
+
+        // Если пакет не был битым и keepalive == true, то нужно читать следующий запрос
+        const bool idle = state.write_buffer.empty() && state.in_flight == 0;
+        if (idle && (!Cfg().keepalive || state.is_closing || state.read_closed))
+        {
+            CloseClient(client_socket);
+            return;
+        }
+        UpdateEvents(client_socket, state);
     }
 
     void StNonblockingServer::CloseClient(int client_socket)
@@ -276,9 +436,13 @@ namespace matrix_service
 
     void StNonblockingServer::Swap(StNonblockingServer &another)
     {
+        std::swap(options_, another.options_);
         std::swap(server_socket_, another.server_socket_);
         std::swap(epoll_fd_, another.epoll_fd_);
         std::swap(clients_, another.clients_);
+        std::swap(next_client_id_, another.next_client_id_);
+        std::swap(completions_, another.completions_);
+        std::swap(completed_, another.completed_);
     }
 
 } // namespace matrix_service
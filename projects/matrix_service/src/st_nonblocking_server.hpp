@@ -1,5 +1,7 @@
 #pragma once
 
+#include "completion_channel.hpp"
+#include "framing.hpp"
 #include "server.hpp"
 #include "utility.hpp"
 
@@ -13,8 +15,10 @@
 #include <fcntl.h>
 
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <functional>
+#include <deque>
 #include <unordered_map>
 #include <vector>
 #include <cstring>
@@ -30,14 +34,44 @@ namespace matrix_service
 
         std::vector<char> write_buffer;
         std::size_t write_offset = 0;
+        // Готовые ответы после write_buffer в порядке завершения (конвейер, см. framing.hpp)
+        std::deque<std::vector<char>> pending_responses;
+        // Емкость отправленного ответа для следующего
+        std::vector<char> spare_buffer;
+
+        // Запросов в пуле
+        std::size_t in_flight = 0;
+        // Последний кадр был с номером запроса: следующий читается, не дожидаясь ответа
+        bool pipelining = false;
+        // Текущая подписка сокета в epoll
+        std::uint32_t events = EPOLLIN;
 
         bool is_closing = false;
+        // Клиент закрыл свою сторону (shutdown SHUT_WR): соединение закроется после ответов на принятые кадры
+        bool read_closed = false;
+
+        // Отличает клиента от следующего на том же сокете
+        std::uint64_t id = 0;
     };
 
+    // Цикл событий занимается только вводом-выводом: запросы исполняются в пуле SubmitProcedure,
+    // ответы возвращаются в цикл через CompletionChannel. Пока запрос клиента без номера исполняется,
+    // его сокет не слушается; запросы с номерами идут конвейером (см. framing.hpp).
+    // С LoopOptions::execute_inline запросы исполняются прямо в цикле.
     class StNonblockingServer : public Server
     {
     public:
+        // Для работы циклом в составе MultiReactorServer
+        struct LoopOptions
+        {
+            // SO_REUSEPORT: несколько циклов слушают один порт, ядро ОС делит между ними соединения
+            bool reuse_port = false;
+            // Исполнять запросы в потоке цикла, без общего пула и передачи ответа между потоками
+            bool execute_inline = false;
+        };
+
         explicit StNonblockingServer(Config conf);
+        StNonblockingServer(Config conf, LoopOptions options);
         StNonblockingServer(const StNonblockingServer &) = delete;
         StNonblockingServer &operator=(const StNonblockingServer &) = delete;
 
@@ -58,14 +92,29 @@ namespace matrix_service
         void Run() override;
 
     private:
+        LoopOptions options_;
         int server_socket_ = -1;
         int epoll_fd_ = -1;
         std::unordered_map<int, ClientState> clients_;
+        std::uint64_t next_client_id_ = 0;
+
+        // shared_ptr: завершения могут прийти и после разрушения сервера
+        std::shared_ptr<CompletionChannel> completions_;
+        std::vector<CompletionChannel::Completion> completed_;
 
         void SetupEpoll();
         void ProcessEvents();
         void HandleClientRead(int client_socket);
         void HandleClientWrite(int client_socket);
+        void AcceptClients();
+        // Исполняет прочитанный кадр или отдает его в пул. false - соединение закрыто
+        bool DispatchFrame(int client_socket, ClientState &state);
+        void HandleCompletions();
+        // Ставит ответ в очередь отправки. false - соединение закрыто
+        bool QueueResponse(int client_socket, ClientState &state, std::vector<char> &&response,
+                           std::optional<std::uint64_t> request_id, bool succeeded);
+        bool WantsRead(const ClientState &state) const;
+        void UpdateEvents(int client_socket, ClientState &state);
         void CloseClient(int client_socket);
         void OnStop() override;
 
@@ -0,0 +1,284 @@
+#include "uring.hpp"
+#include "utility.hpp"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace matrix_service {
+
+namespace {
+
+int UringSetup(std::uint32_t entries, io_uring_params& params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int UringEnter(int ring_fd, std::uint32_t to_submit, std::uint32_t min_complete, std::uint32_t flags)
+{
+    return int(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int UringRegister(int ring_fd, std::uint32_t opcode, void* arg, std::uint32_t nr_args)
+{
+    return int(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+void* MapRing(int ring_fd, std::size_t size, off_t offset)
+{
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    if (ptr == MAP_FAILED)
+        RaiseLinuxCallError(__LINE__, __FILE__, "mmap", "failed to map io_uring ring");
+    return ptr;
+}
+
+template <typename T>
+T* At(void* base, std::uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+}
+
+// Поля колец делятся с ядром: чужие читаются с acquire, свои публикуются с release
+std::uint32_t LoadAcquire(std::uint32_t* value)
+{
+    return std::atomic_ref<std::uint32_t>(*value).load(std::memory_order_acquire);
+}
+
+void StoreRelease(std::uint32_t* value, std::uint32_t new_value)
+{
+    std::atomic_ref<std::uint32_t>(*value).store(new_value, std::memory_order_release);
+}
+
+} // namespace
+
+
+bool Uring::Supported()
+{
+    // Многоразовый recv появился в 6.0, по флагам кольца его не обнаружить
+    utsname name = {};
+    unsigned major = 0;
+    unsigned minor = 0;
+    if (uname(&name) != 0 || std::sscanf(name.release, "%u.%u", &major, &minor) != 2 || major < 6)
+        return false;
+
+    io_uring_params params = {};
+    const int ring_fd = UringSetup(2, params);
+    if (ring_fd == -1)
+        return false;
+    close(ring_fd);
+    return true;
+}
+
+Uring::Uring(std::uint32_t entries)
+{
+    io_uring_params params = {};
+    // Многоразовые операции дают пачки завершений: кольцу завершений нужен запас
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 8;
+    VALIDATE_LINUX_CALL(ring_fd_ = UringSetup(entries, params));
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+    sq_ring_ = MapRing(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+    cq_ring_ = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ring_ : MapRing(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(MapRing(ring_fd_, sqes_size_, IORING_OFF_SQES));
+
+    sq_head_ = At<std::uint32_t>(sq_ring_, params.sq_off.head);
+    sq_tail_ = At<std::uint32_t>(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *At<std::uint32_t>(sq_ring_, params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sqe_tail_ = *sq_tail_;
+    // SQE берутся по порядку: индексный массив один раз заполняется тождественно
+    std::uint32_t* sq_array = At<std::uint32_t>(sq_ring_, params.sq_off.array);
+    for (std::uint32_t i = 0; i < sq_entries_; ++i)
+        sq_array[i] = i;
+
+    cq_head_ = At<std::uint32_t>(cq_ring_, params.cq_off.head);
+    cq_tail_ = At<std::uint32_t>(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *At<std::uint32_t>(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = At<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+}
+
+Uring::~Uring()
+{
+    // Закрытие кольца отменяет все незавершенные операции
+    if (ring_fd_ != -1)
+        close(ring_fd_);
+    if (buffers_)
+        munmap(buffers_, buffers_size_);
+    if (buffer_ring_)
+        munmap(buffer_ring_, buffer_ring_size_);
+    if (sqes_)
+        munmap(sqes_, sqes_size_);
+    if (cq_ring_ && cq_ring_ != sq_ring_)
+        munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_)
+        munmap(sq_ring_, sq_ring_size_);
+}
+
+io_uring_sqe* Uring::NextSqe()
+{
+    // Ядро может принять не все SQE или прерваться сигналом: ждем, пока освободится место
+    while (sqe_tail_ - LoadAcquire(sq_head_) >= sq_entries_)
+        Submit(false);
+
+    io_uring_sqe* sqe = &sqes_[sqe_tail_ & sq_mask_];
+    ++sqe_tail_;
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+bool Uring::Submit(bool wait)
+{
+    StoreRelease(sq_tail_, sqe_tail_);
+    const std::uint32_t to_submit = sqe_tail_ - LoadAcquire(sq_head_);
+    if (to_submit == 0 && !wait)
+        return true;
+
+    if (UringEnter(ring_fd_, to_submit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0) == -1)
+    {
+        if (errno == EINTR)
+            return false;
+        RaiseLinuxCallError(__LINE__, __FILE__, "io_uring_enter", "failed to submit io_uring requests");
+    }
+    return true;
+}
+
+void Uring::ForEachCompletion(const std::function<void(const io_uring_cqe&)>& handler)
+{
+    std::uint32_t head = *cq_head_;
+    while (head != LoadAcquire(cq_tail_))
+    {
+        // Копия: слот освобождается до вызова, handler может дождаться новых завершений
+        const io_uring_cqe cqe = cqes_[head & cq_mask_];
+        StoreRelease(cq_head_, ++head);
+        if (cqe.user_data != InternalUserData)
+            handler(cqe);
+    }
+}
+
+io_uring_cqe Uring::RunSync(io_uring_sqe* sqe)
+{
+    sqe->user_data = InternalUserData;
+    while (!Submit(true))
+    {
+    }
+
+    const std::uint32_t head = *cq_head_;
+    const io_uring_cqe cqe = cqes_[head & cq_mask_];
+    StoreRelease(cq_head_, head + 1);
+    return cqe;
+}
+
+void Uring::SetupBufferRing(std::uint16_t group, std::uint16_t count, std::uint32_t size)
+{
+    buffers_size_ = std::size_t(count) * size;
+    void* buffers = mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED)
+        RaiseLinuxCallError(__LINE__, __FILE__, "mmap", "failed to allocate io_uring buffers");
+    buffers_ = static_cast<char*>(buffers);
+    buffer_size_ = size;
+    buffer_group_ = group;
+
+    buffer_ring_size_ = std::size_t(count) * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, buffer_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+        RaiseLinuxCallError(__LINE__, __FILE__, "mmap", "failed to allocate io_uring buffer ring");
+    buffer_ring_ = static_cast<io_uring_buf_ring*>(ring);
+    buffer_mask_ = count - 1;
+
+    io_uring_buf_reg reg = {};
+    reg.ring_addr = reinterpret_cast<std::uint64_t>(buffer_ring_);
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (UringRegister(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == 0)
+    {
+        for (std::uint16_t id = 0; id < count; ++id)
+            RecycleBuffer(id);
+        if (ProbeBufferRing())
+            return;
+        UringRegister(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    }
+
+    munmap(buffer_ring_, buffer_ring_size_);
+    buffer_ring_ = nullptr;
+    legacy_buffers_ = true;
+    ProvideBuffers(0, count);
+}
+
+bool Uring::ProbeBufferRing()
+{
+    int sockets[2];
+    VALIDATE_LINUX_CALL(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets));
+    const char byte = 0;
+    VALIDATE_LINUX_CALL(int(write(sockets[1], &byte, 1)));
+
+    io_uring_sqe* sqe = NextSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sockets[0];
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buffer_group_;
+    const io_uring_cqe cqe = RunSync(sqe);
+    close(sockets[0]);
+    close(sockets[1]);
+
+    if (cqe.res != 1 || !(cqe.flags & IORING_CQE_F_BUFFER))
+        return false;
+    RecycleBuffer(std::uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+    return true;
+}
+
+void Uring::ProvideBuffers(std::uint16_t first_id, std::uint16_t count)
+{
+    io_uring_sqe* sqe = NextSqe();
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = count;
+    sqe->addr = reinterpret_cast<std::uint64_t>(Buffer(first_id));
+    sqe->len = buffer_size_;
+    sqe->off = first_id;
+    sqe->buf_group = buffer_group_;
+    const io_uring_cqe cqe = RunSync(sqe);
+    if (cqe.res < 0)
+    {
+        errno = -cqe.res;
+        RaiseLinuxCallError(__LINE__, __FILE__, "IORING_OP_PROVIDE_BUFFERS", "failed to provide io_uring buffers");
+    }
+}
+
+void Uring::RecycleBuffer(std::uint16_t id)
+{
+    if (legacy_buffers_)
+    {
+        // Уходит в ядро вместе с ближайшей отправкой, без отдельного вызова и без завершения при успехе
+        io_uring_sqe* sqe = NextSqe();
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = 1;
+        sqe->addr = reinterpret_cast<std::uint64_t>(Buffer(id));
+        sqe->len = buffer_size_;
+        sqe->off = id;
+        sqe->buf_group = buffer_group_;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = InternalUserData;
+        return;
+    }
+
+    io_uring_buf& buf = buffer_ring_->bufs[buffer_tail_ & buffer_mask_];
+    buf.addr = reinterpret_cast<std::uint64_t>(Buffer(id));
+    buf.len = buffer_size_;
+    buf.bid = id;
+    std::atomic_ref<std::uint16_t>(buffer_ring_->tail).store(++buffer_tail_, std::memory_order_release);
+}
+
+} // namespace matrix_service
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace matrix_service {
+
+// Минимальная обертка над io_uring через системные вызовы (без liburing): кольца отправки
+// и завершений, отображенные в память процесса, и кольцо буферов для приема (provided buffers).
+// Не потокобезопасна: вся работа - в одном потоке цикла.
+class Uring
+{
+public:
+    // Ядро умеет все, что нужно UringServer: многоразовые accept и recv (6.0+), кольцо буферов.
+    // false - io_uring нет или запрещен (io_uring_disabled, seccomp)
+    static bool Supported();
+
+    explicit Uring(std::uint32_t entries);
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+    ~Uring();
+
+    // Заполнение - на вызывающем. Если кольцо отправки полно, накопленное сначала отправляется в ядро
+    io_uring_sqe* NextSqe();
+    // Отправляет накопленные SQE и, если wait, ждет хотя бы одного завершения. false - прервано сигналом
+    bool Submit(bool wait);
+    // Обрабатывает готовые завершения; handler может ставить новые SQE
+    void ForEachCompletion(const std::function<void(const io_uring_cqe&)>& handler);
+
+    // Кольцо из count (степень двойки) буферов по size байт для recv с IOSQE_BUFFER_SELECT и группой group.
+    // Вызывается до постановки других операций: кольцо проверяется пробным приемом, и если ядро
+    // не выдает из него буферы, они регистрируются по-старому (IORING_OP_PROVIDE_BUFFERS).
+    void SetupBufferRing(std::uint16_t group, std::uint16_t count, std::uint32_t size);
+    // Данные буфера из завершения с IORING_CQE_F_BUFFER
+    const char* Buffer(std::uint16_t id) const { return buffers_ + std::size_t(id) * buffer_size_; }
+    // Возвращает буфер в кольцо, когда данные из него забраны
+    void RecycleBuffer(std::uint16_t id);
+
+private:
+    // Завершения собственных служебных операций, до вызывающего не доходят
+    static constexpr std::uint64_t InternalUserData = ~std::uint64_t(0);
+
+    // Ставит операцию и ждет ее завершения; только пока в кольце нет других операций
+    io_uring_cqe RunSync(io_uring_sqe* sqe);
+    bool ProbeBufferRing();
+    void ProvideBuffers(std::uint16_t first_id, std::uint16_t count);
+
+    int ring_fd_ = -1;
+
+    void* sq_ring_ = nullptr;
+    std::size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    std::size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    std::uint32_t* sq_head_ = nullptr;
+    std::uint32_t* sq_tail_ = nullptr;
+    std::uint32_t sq_mask_ = 0;
+    std::uint32_t sq_entries_ = 0;
+    std::uint32_t sqe_tail_ = 0; // Конец заполненных SQE, ядру публикуется в Submit
+
+    std::uint32_t* cq_head_ = nullptr;
+    std::uint32_t* cq_tail_ = nullptr;
+    std::uint32_t cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    std::uint16_t buffer_group_ = 0;
+    bool legacy_buffers_ = false;
+    io_uring_buf_ring* buffer_ring_ = nullptr;
+    std::size_t buffer_ring_size_ = 0;
+    std::uint16_t buffer_mask_ = 0;
+    std::uint16_t buffer_tail_ = 0;
+    char* buffers_ = nullptr;
+    std::size_t buffers_size_ = 0;
+    std::uint32_t buffer_size_ = 0;
+};
+
+} // namespace matrix_service
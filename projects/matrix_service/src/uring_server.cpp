@@ -0,0 +1,382 @@
+#include "uring_server.hpp"
+#include "utility.hpp"
+
+#include <poll.h>
+
+#include <cstring>
+
+namespace matrix_service
+{
+    namespace
+    {
+        constexpr std::uint32_t RingEntries = 256;
+        // Буферы приема общие на все соединения: память не растет с их числом
+        constexpr std::uint16_t BufferGroup = 0;
+        constexpr std::uint16_t BufferCount = 256;
+        constexpr std::uint32_t BufferSize = 16 * 1024;
+
+        std::uint64_t PackUserData(std::uint8_t op, int client_socket, std::uint32_t client_id)
+        {
+            return std::uint64_t(op) << 56 | std::uint64_t(std::uint32_t(client_socket) & 0xffffff) << 32 | client_id;
+        }
+    }
+
+    UringServer::UringServer(Config conf)
+        : Server(std::move(conf))
+    {
+        VALIDATE_LINUX_CALL(server_socket_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+
+        int reuse = 1;
+        VALIDATE_LINUX_CALL(setsockopt(server_socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)));
+
+        sockaddr_in server_address = {};
+        server_address.sin_family = AF_INET;
+        VALIDATE_LINUX_CALL(inet_pton(AF_INET, Cfg().listening_address.c_str(), &server_address.sin_addr));
+        server_address.sin_port = htons(Cfg().port);
+
+        VALIDATE_LINUX_CALL(bind(server_socket_, (struct sockaddr *)&server_address, sizeof(server_address)));
+        VALIDATE_LINUX_CALL(listen(server_socket_, SOMAXCONN));
+
+        ring_ = std::make_unique<Uring>(RingEntries);
+        ring_->SetupBufferRing(BufferGroup, BufferCount, BufferSize);
+        completions_ = std::make_shared<CompletionChannel>();
+    }
+
+    UringServer::~UringServer()
+    {
+        // Сначала кольцо: его операции держат ссылки на сокеты
+        ring_.reset();
+        for (auto &client : clients_)
+        {
+            shutdown(client.first, SHUT_RDWR);
+            close(client.first);
+        }
+        if (server_socket_ != -1)
+        {
+            shutdown(server_socket_, SHUT_RDWR);
+            close(server_socket_);
+        }
+    }
+
+    void UringServer::OnStop()
+    {
+        if (completions_)
+            completions_->Wake();
+    }
+
+    void UringServer::Run()
+    {
+        ArmAccept();
+        ArmWake();
+
+        while (!StopRequired())
+        {
+            if (!ring_->Submit(true))
+                continue; // EINTR
+
+            ring_->ForEachCompletion([this](const io_uring_cqe &cqe)
+                                     { HandleCompletion(cqe); });
+        }
+    }
+
+    void UringServer::ArmAccept()
+    {
+        io_uring_sqe *sqe = ring_->NextSqe();
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = server_socket_;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = PackUserData(std::uint8_t(Op::Accept), 0, 0);
+    }
+
+    void UringServer::ArmWake()
+    {
+        io_uring_sqe *sqe = ring_->NextSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = completions_->Fd();
+        sqe->len = IORING_POLL_ADD_MULTI;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = PackUserData(std::uint8_t(Op::Wake), 0, 0);
+    }
+
+    void UringServer::ArmRecv(int client_socket, Client &client)
+    {
+        // Буфер выбирает ядро из кольца в момент прихода данных
+        io_uring_sqe *sqe = ring_->NextSqe();
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = client_socket;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BufferGroup;
+        sqe->user_data = PackUserData(std::uint8_t(Op::Recv), client_socket, client.id);
+        client.recv = RecvState::Armed;
+    }
+
+    void UringServer::UpdateRecv(int client_socket, Client &client)
+    {
+        const bool wants = CanSubmit(client) && !client.read_closed;
+        if (wants && client.recv == RecvState::Stopped)
+        {
+            ArmRecv(client_socket, client);
+        }
+        else if (!wants && client.recv == RecvState::Armed)
+        {
+            // Уже принятое до отмены еще придет завершениями: это не больше нескольких буферов кольца
+            io_uring_sqe *sqe = ring_->NextSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = PackUserData(std::uint8_t(Op::Recv), client_socket, client.id);
+            sqe->user_data = PackUserData(std::uint8_t(Op::Cancel), client_socket, client.id);
+            client.recv = RecvState::Cancelling;
+        }
+    }
+
+    void UringServer::ArmSend(int client_socket, Client &client)
+    {
+        // Префикс размера уже лежит перед ответом (см. ExecuteProcedure): кадр уходит одной операцией
+        io_uring_sqe *sqe = ring_->NextSqe();
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = client_socket;
+        sqe->addr = reinterpret_cast<std::uint64_t>(client.write_buffer.data() + client.write_offset);
+        sqe->len = client.write_buffer.size() - client.write_offset;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = PackUserData(std::uint8_t(Op::Send), client_socket, client.id);
+        client.send_armed = true;
+    }
+
+    void UringServer::HandleCompletion(const io_uring_cqe &cqe)
+    {
+        const auto op = Op(cqe.user_data >> 56);
+        const int client_socket = int((cqe.user_data >> 32) & 0xffffff);
+        const auto client_id = std::uint32_t(cqe.user_data);
+
+        switch (op)
+        {
+        case Op::Accept:
+            HandleAccept(cqe);
+            break;
+        case Op::Recv:
+            HandleRecv(client_socket, client_id, cqe);
+            break;
+        case Op::Send:
+            HandleSend(client_socket, client_id, cqe);
+            break;
+        case Op::Wake:
+            HandleCompletions();
+            if (!(cqe.flags & IORING_CQE_F_MORE))
+                ArmWake();
+            break;
+        case Op::Cancel:
+            break; // Итог отмены приходит завершением самого recv
+        }
+    }
+
+    void UringServer::HandleAccept(const io_uring_cqe &cqe)
+    {
+        if (cqe.res >= 0)
+        {
+            const int client_socket = cqe.res;
+            Client &client = clients_[client_socket];
+            client = {};
+            client.id = next_client_id_++;
+            ArmRecv(client_socket, client);
+        }
+        // Многоразовый accept снимается ядром при ошибке или переполнении - ставим заново
+        if (!(cqe.flags & IORING_CQE_F_MORE) && !StopRequired())
+            ArmAccept();
+    }
+
+    void UringServer::HandleRecv(int client_socket, std::uint32_t client_id, const io_uring_cqe &cqe)
+    {
+        Client *client = FindClient(client_socket, client_id);
+        if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+            const auto buffer_id = std::uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            // Данные копируются в кадр, буфер сразу возвращается в кольцо
+            if (client && !client->closed && cqe.res > 0)
+            {
+                const char *data = ring_->Buffer(buffer_id);
+                client->read_buffer.insert(client->read_buffer.end(), data, data + cqe.res);
+            }
+            ring_->RecycleBuffer(buffer_id);
+        }
+        if (!client)
+            return; // Завершение для уже закрытого соединения
+
+        // Последнее завершение многоразового recv: ошибка, отмена или ENOBUFS (все буферы кольца заняты).
+        // Заново прием ставит UpdateRecv, если клиент может принимать запросы
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+            client->recv = RecvState::Stopped;
+        if (client->closed || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED))
+        {
+            CloseClient(client_socket);
+            return;
+        }
+        // Конец потока: полные кадры из read_buffer еще исполнятся, недочитанный отбрасывается
+        client->read_closed = client->read_closed || cqe.res == 0;
+
+        SubmitFrames(client_socket, *client);
+        if (client->read_closed && client->in_flight == 0 && client->write_buffer.empty())
+            CloseClient(client_socket);
+    }
+
+    bool UringServer::CanSubmit(const Client &client) const
+    {
+        if (client.is_closing)
+            return false;
+
+        const std::size_t outstanding = client.in_flight + client.pending_responses.size() + !client.write_buffer.empty();
+        if (outstanding == 0)
+            return true;
+        return client.pipelining && outstanding < MaxPipelinedRequests;
+    }
+
+    void UringServer::SubmitFrames(int client_socket, Client &client)
+    {
+        while (CanSubmit(client) && client.read_buffer.size() >= FrameSizeBytes)
+        {
+            std::uint32_t raw_size = 0;
+            std::memcpy(&raw_size, client.read_buffer.data(), sizeof(raw_size));
+            const std::size_t header_size = FrameHeaderSize(raw_size);
+            const std::size_t frame_size = header_size + ContentSize(raw_size);
+            if (client.read_buffer.size() < frame_size)
+                break;
+
+            // Буферы уходят в пул вместе с запросом и вернутся с ответом
+            AsyncProcedure procedure;
+            if (client.read_buffer.size() == frame_size)
+            {
+                procedure.request = std::move(client.read_buffer);
+                client.read_buffer.clear();
+            }
+            else
+            {
+                // За кадром уже лежит начало следующего
+                procedure.request.assign(client.read_buffer.begin(), client.read_buffer.begin() + frame_size);
+                client.read_buffer.erase(client.read_buffer.begin(), client.read_buffer.begin() + frame_size);
+            }
+            procedure.request_offset = header_size;
+            procedure.framed_response = std::move(client.spare_buffer);
+            client.pipelining = HasRequestId(raw_size) && Cfg().keepalive;
+            ++client.in_flight;
+
+            SubmitProcedure(std::move(procedure),
+                [completions = completions_, client_socket, id = client.id](AsyncProcedure&& done)
+                {
+                    completions->Push({ client_socket, id, std::move(done) });
+                });
+        }
+        UpdateRecv(client_socket, client);
+    }
+
+    void UringServer::HandleCompletions()
+    {
+        completions_->TakeAll(completed_);
+        for (auto &completion : completed_)
+        {
+            Client *client = FindClient(completion.client_socket, std::uint32_t(completion.client_id));
+            if (!client || client->closed)
+                continue; // Клиент отключился, не дождавшись ответа
+
+            auto &procedure = completion.procedure;
+            --client->in_flight;
+            if (procedure.framed_response.empty())
+            {
+                CloseClient(completion.client_socket);
+                continue;
+            }
+            // Битый запрос: больше не читаем, соединение закроется после отправки готовых ответов
+            client->is_closing = client->is_closing || !procedure.succeeded;
+            if (const auto request_id = ReadRequestId(procedure.request.data()))
+                TagResponse(procedure.framed_response, *request_id);
+            if (client->read_buffer.empty())
+            {
+                client->read_buffer = std::move(procedure.request);
+                client->read_buffer.clear();
+            }
+
+            if (!client->write_buffer.empty())
+            {
+                client->pending_responses.push_back(std::move(procedure.framed_response));
+            }
+            else
+            {
+                client->write_buffer = std::move(procedure.framed_response);
+                client->write_offset = 0;
+                ArmSend(completion.client_socket, *client);
+            }
+            UpdateRecv(completion.client_socket, *client);
+        }
+        completed_.clear();
+    }
+
+    void UringServer::HandleSend(int client_socket, std::uint32_t client_id, const io_uring_cqe &cqe)
+    {
+        Client *client = FindClient(client_socket, client_id);
+        if (!client)
+            return;
+        client->send_armed = false;
+        if (client->closed || cqe.res <= 0)
+        {
+            CloseClient(client_socket);
+            return;
+        }
+
+        client->write_offset += cqe.res;
+        if (client->write_offset < client->write_buffer.size())
+        {
+            ArmSend(client_socket, *client);
+            return;
+        }
+
+        // Буфер отправленного ответа пойдет под следующий
+        client->spare_buffer = std::move(client->write_buffer);
+        client->spare_buffer.clear();
+        client->write_buffer.clear();
+        client->write_offset = 0;
+        if (!client->pending_responses.empty())
+        {
+            client->write_buffer = std::move(client->pending_responses.front());
+            client->pending_responses.pop_front();
+            ArmSend(client_socket, *client);
+            return;
+        }
+
+        // Если пакет не был битым и keepalive == true, то нужно читать следующий запрос
+        if (client->in_flight == 0 && (!Cfg().keepalive || client->is_closing))
+        {
+            CloseClient(client_socket);
+            return;
+        }
+        SubmitFrames(client_socket, *client);
+        // Клиент больше ничего не пришлет: ответ на последний принятый кадр отправлен
+        if (client->read_closed && client->in_flight == 0)
+            CloseClient(client_socket);
+    }
+
+    UringServer::Client *UringServer::FindClient(int client_socket, std::uint32_t client_id)
+    {
+        auto it = clients_.find(client_socket);
+        return it != clients_.end() && it->second.id == client_id ? &it->second : nullptr;
+    }
+
+    void UringServer::CloseClient(int client_socket)
+    {
+        auto it = clients_.find(client_socket);
+        if (it == clients_.end())
+            return;
+        Client &client = it->second;
+
+        // shutdown завершает многоразовый recv и отправку, в том числе еще не отданные ядру
+        if (!client.closed)
+        {
+            shutdown(client_socket, SHUT_RDWR);
+            client.closed = true;
+            client.is_closing = true;
+        }
+        if (client.send_armed || client.recv != RecvState::Stopped)
+            return; // Закончим в HandleSend/HandleRecv
+
+        close(client_socket);
+        clients_.erase(it);
+    }
+}
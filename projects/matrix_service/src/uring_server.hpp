@@ -0,0 +1,112 @@
+#pragma once
+
+#include "completion_channel.hpp"
+#include "framing.hpp"
+#include "server.hpp"
+#include "uring.hpp"
+
+#include "executor/executor.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace matrix_service
+{
+
+    // Однопоточный цикл на io_uring вместо epoll: соединения принимает один многоразовый accept,
+    // данные приходят многоразовым recv сразу в буферы из общего кольца, без отдельных вызовов
+    // read/write на каждое событие готовности. Запросы, как в StNonblockingServer, исполняются
+    // в пуле SubmitProcedure, ответы возвращаются через CompletionChannel. Запросы с номерами
+    // идут конвейером, как в StNonblockingServer.
+    class UringServer : public Server
+    {
+    public:
+        explicit UringServer(Config conf);
+        ~UringServer();
+
+        void Run() override;
+
+    private:
+        // Многоразовый recv клиента
+        enum class RecvState : std::uint8_t
+        {
+            Stopped,
+            Armed,
+            Cancelling, // Отмена отправлена, ждем последнего завершения recv
+        };
+
+        struct Client
+        {
+            std::uint32_t id = 0;
+            // Принятые байты, еще не ушедшие в запрос
+            std::vector<char> read_buffer;
+            // Отправляемый ответ и готовые за ним в порядке завершения (конвейер, см. framing.hpp)
+            std::vector<char> write_buffer;
+            std::size_t write_offset = 0;
+            std::deque<std::vector<char>> pending_responses;
+            std::vector<char> spare_buffer;
+            // Запросов в пуле
+            std::size_t in_flight = 0;
+            // Последний кадр был с номером запроса: следующий исполняется, не дожидаясь ответа
+            bool pipelining = false;
+            bool is_closing = false;
+            // Клиент закрыл свою сторону (shutdown SHUT_WR): соединение закроется после ответов на принятые кадры
+            bool read_closed = false;
+            RecvState recv = RecvState::Stopped;
+            // Отправка write_buffer в кольце: ядро читает буфер до ее завершения
+            bool send_armed = false;
+            // CloseClient уже сделал shutdown: сокет и состояние живут до последних завершений recv и send
+            bool closed = false;
+        };
+
+        // Тип операции в user_data завершения, вместе с сокетом и номером клиента
+        enum class Op : std::uint8_t
+        {
+            Accept,
+            Recv,
+            Send,
+            Wake,
+            Cancel,
+        };
+
+        void ArmAccept();
+        void ArmWake();
+        void ArmRecv(int client_socket, Client &client);
+        // Прием идет, только пока клиент может отдать запрос в пул (CanSubmit), иначе recv отменяется:
+        // входящие данные ждут в сокете, а не копятся в read_buffer
+        void UpdateRecv(int client_socket, Client &client);
+        void ArmSend(int client_socket, Client &client);
+
+        void HandleCompletion(const io_uring_cqe &cqe);
+        void HandleAccept(const io_uring_cqe &cqe);
+        void HandleRecv(int client_socket, std::uint32_t client_id, const io_uring_cqe &cqe);
+        void HandleSend(int client_socket, std::uint32_t client_id, const io_uring_cqe &cqe);
+        void HandleCompletions();
+        // Отдает в пул полные кадры из read_buffer, пока клиент может принимать запросы, и обновляет прием
+        void SubmitFrames(int client_socket, Client &client);
+        bool CanSubmit(const Client &client) const;
+        // Закрывает сокет, когда в кольце не осталось его операций, иначе после их завершения:
+        // номер сокета не достанется новому соединению, пока на него ссылаются операции старого
+        void CloseClient(int client_socket);
+        // В том числе закрываемого (closed): его завершения доводят CloseClient до конца
+        Client *FindClient(int client_socket, std::uint32_t client_id);
+        void OnStop() override;
+
+        int server_socket_ = -1;
+        std::unique_ptr<Uring> ring_;
+        std::unordered_map<int, Client> clients_;
+        std::uint32_t next_client_id_ = 0;
+
+        // shared_ptr: завершения могут прийти и после разрушения сервера
+        std::shared_ptr<CompletionChannel> completions_;
+        std::vector<CompletionChannel::Completion> completed_;
+    };
+}
@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+
+# TODO: Use testing framework
+
+import os.path as path
+import sys
+import signal
+import socket
+import subprocess
+
+from threading import Timer
+from time import sleep
+
+
+ROOT_DIR = path.dirname(__file__) + '/../../'
+sys.path.append(ROOT_DIR + '/projects/protogen/py/')
+import matrix_pb2
+import matrix_service_pb2
+
+
+BIN_FILE = ROOT_DIR + '/bin/matrix_service'
+MODE = 'mr_nonblocking'
+ADDR = '127.0.0.1'
+PORT = '23196' # FIXME: Generate
+TIMEOUT = 2
+THREADS = str(4)
+ARGS = [BIN_FILE, '--server_type', MODE, '-a', ADDR, '-p', PORT, '-t', THREADS]
+
+class TestServer:
+    def kill(self):
+        print('>>> KILLING SERVER: time is over')
+        self.server.kill()
+
+    def __init__(self, test_id, keepalive=False, extra_args=[]):
+        print('Started test "' + test_id + '" ...')
+        self.test_id = test_id
+
+        self.server = subprocess.Popen((ARGS if not keepalive else ARGS + ['-k']) + extra_args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        sleep(0.1)
+
+        self.timer = Timer(TIMEOUT, self.kill)
+
+    def __enter__(self):
+        self.timer.start()
+        return self
+
+    def finalize(self):
+        try:
+            self.server.send_signal(signal.SIGINT)
+            self.stdout, self.stderr = self.server.communicate()
+        finally:
+            self.timer.cancel()
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.finalize()
+        failed = self.server.returncode != 0 or exc_val is not None
+
+        print('Test with id = "' + self.test_id + '" finished')
+        if failed:
+            print('>>> FAIL!!! Server returned != 0: (' + str(self.server.returncode) + ') <or> Exception, testname = ' + self.test_id)
+
+        print('=== stdout ===')
+        print(self.stdout)
+        print('=== stderr ===')
+        print(self.stderr)
+        print('=== END: {} ==='.format('OK' if exc_val is None and not failed else 'FAILED') + '\n\n')
+
+class Connection:
+    def __init__(self):
+        self.socket = None
+
+    def send(self, msg, need_sleep=True):
+        self.socket.sendall(msg)
+        if need_sleep:
+            sleep(0.05) # To make effect
+
+    def send_request(self, serialized_proto):
+        self.send(len(msg).to_bytes(4, 'little'), False) # TODO: Change to big endian
+        self.send(serialized_proto)
+
+    def try_recv(self):
+        try:
+            return self.socket.recv(1024)
+        except BlockingIOError as err:
+            if err.errno == 11: # EAGAIN
+                return None
+            raise err
+
+    def __enter__(self):
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.socket.connect((ADDR, int(PORT)))
+        self.socket.setblocking(False)
+        return self
+
+    def __exit__(self, *args):
+        if self.socket is not None:
+            try:
+                self.socket.shutdown(socket.SHUT_RDWR)
+            except OSError as err:
+                assert err.errno == 107 # Transport endpoint is not connected
+            self.socket.close()
+
+
+def make_matrix(m, val):
+    m.rows = 1
+    m.columns = 1
+    m.content.append(val)
+
+def make_mul_request(val1, val2):
+    req_payload = matrix_service_pb2.MatrixOpRequest()
+    req_payload.op = matrix_service_pb2.MatrixOpRequest.Operator.MUL
+    make_matrix(req_payload.args.add(), val1)
+    make_matrix(req_payload.args.add(), val2)
+
+    req = matrix_service_pb2.ProcedureData()
+    req.proc_id = matrix_service_pb2.ProcedureData.ProcedureId.MATRIX_OP
+    req.payload = req_payload.SerializeToString()
+    return req.SerializeToString()
+
+def check_response(val, msg):
+    resp = matrix_service_pb2.ProcedureData()
+    resp.ParseFromString(msg)
+    assert resp.proc_id == matrix_service_pb2.ProcedureData.ProcedureId.MATRIX_OP
+
+    resp_payload_proto = matrix_service_pb2.MatrixOpResponse()
+    resp_payload_proto.ParseFromString(resp.payload)
+    assert resp_payload_proto.result.rows == 1
+    assert resp_payload_proto.result.columns == 1
+    assert len(resp_payload_proto.result.content) == 1
+    assert resp_payload_proto.result.content[0] == val
+
+
+# 1. Запуск - остановка
+with TestServer("simple stop") as s:
+    pass
+
+# 2. Запуск - недописанное сообщение - остановка
+with TestServer("cropped message") as s, Connection() as conn:
+    conn.send(b'1') # Реально ждет 4 байта => сообщение не готово
+    assert conn.try_recv() is None # TODO: Use testng framework
+
+# 3. Запуск - нормальное сообщение - остановка
+with TestServer("normal messages") as s, Connection() as conn:
+    msg = make_mul_request(1, 2)
+    conn.send_request(msg)
+    check_response(2., conn.try_recv()[4:]) # Первые 4 байта - размер
+
+    try:
+        conn.socket.send(b'1')
+        conn.socket.send(b'1')
+        raise AssertionError('Without keepalive socket should be closed')
+    except BrokenPipeError:
+        pass # Ok
+
+# 4. keepalive - 2 раза по 2 сообщения
+with TestServer("keepalive", True) as s:
+    for _ in range(2):
+        with Connection() as conn:
+            msg = make_mul_request(1, 2)
+            for _ in range(2):
+                conn.send_request(msg)
+                check_response(2., conn.try_recv()[4:])
+
+REQUEST_ID_FLAG = 0x80000000
+
+def make_frame(msg, request_id=None):
+    if request_id is None:
+        return len(msg).to_bytes(4, 'little') + msg
+    return (len(msg) | REQUEST_ID_FLAG).to_bytes(4, 'little') + request_id.to_bytes(8, 'little') + msg
+
+def make_square_request(side, val):
+    req_payload = matrix_service_pb2.MatrixOpRequest()
+    req_payload.op = matrix_service_pb2.MatrixOpRequest.Operator.MUL
+    for _ in range(2):
+        m = req_payload.args.add()
+        m.rows = side
+        m.columns = side
+        m.content.extend([val] * (side * side))
+
+    req = matrix_service_pb2.ProcedureData()
+    req.proc_id = matrix_service_pb2.ProcedureData.ProcedureId.MATRIX_OP
+    req.payload = req_payload.SerializeToString()
+    return req.SerializeToString()
+
+# Ответы в порядке прихода: (номер запроса или None, тело)
+def recv_frames(conn, count):
+    conn.socket.settimeout(TIMEOUT)
+    data = bytearray()
+    frames = []
+    while len(frames) < count:
+        chunk = conn.socket.recv(1 << 16)
+        assert chunk, 'Connection closed after {} responses'.format(len(frames))
+        data += chunk
+        while len(data) >= 4:
+            size = int.from_bytes(data[:4], 'little')
+            header = 12 if size & REQUEST_ID_FLAG else 4
+            end = header + (size & ~REQUEST_ID_FLAG)
+            if len(data) < end:
+                break
+            request_id = int.from_bytes(data[4:12], 'little') if header == 12 else None
+            frames.append((request_id, bytes(data[header:end])))
+            del data[:end]
+    return frames
+
+# 5. keepalive - конвейер: кадры с номерами уходят подряд, ответы сопоставляются по номеру
+with TestServer("pipelining", True) as s, Connection() as conn:
+    conn.send(b''.join(make_frame(make_mul_request(request_id, 2), request_id) for request_id in range(1, 4)))
+
+    answered = set()
+    for request_id, msg in recv_frames(conn, 3):
+        check_response(2. * request_id, msg)
+        answered.add(request_id)
+    assert answered == {1, 2, 3}
+
+# 6. Циклы исполняют запросы сами: кадры одного соединения исполняются по очереди, ответы - в порядке запросов
+slow_msg = make_square_request(300, 1.)
+with TestServer("pipelining: inline order", True) as s, Connection() as conn:
+    conn.send(make_frame(slow_msg, 1) + make_frame(make_mul_request(3, 2), 2) + make_frame(make_mul_request(4, 2), 3))
+
+    frames = recv_frames(conn, 3)
+    assert [request_id for request_id, _ in frames] == [1, 2, 3]
+    check_response(6., frames[1][1])
+    check_response(8., frames[2][1])
+
+# 7. Конвейер длиннее MaxPipelinedRequests (64): лишние кадры ждут в сокете, но ответ получают все
+with TestServer("pipelining: long burst", True) as s, Connection() as conn:
+    conn.send(b''.join(make_frame(make_mul_request(request_id, 2), request_id) for request_id in range(1, 201)))
+
+    answered = set()
+    for request_id, msg in recv_frames(conn, 200):
+        check_response(2. * request_id, msg)
+        answered.add(request_id)
+    assert answered == set(range(1, 201))
+
+# 8. Кадр без номера прерывает конвейер: следующие за ним читаются только после ответа на него
+with TestServer("pipelining: untagged frame", True) as s, Connection() as conn:
+    conn.send(make_frame(make_mul_request(1, 2), 1) + make_frame(make_mul_request(10, 2))
+              + make_frame(make_mul_request(2, 2), 2) + make_frame(make_mul_request(3, 2), 3))
+
+    frames = recv_frames(conn, 4)
+    untagged = [i for i, (request_id, _) in enumerate(frames) if request_id is None]
+    assert len(untagged) == 1
+    check_response(20., frames[untagged[0]][1])
+    for i, (request_id, msg) in enumerate(frames):
+        if request_id is not None:
+            check_response(2. * request_id, msg)
+            if request_id > 1:
+                assert i > untagged[0]
+
+# 9. Клиент закрыл свою сторону, не дождавшись ответов: все ответы доходят, затем сервер закрывает соединение
+with TestServer("pipelining: half-close", True) as s, Connection() as conn:
+    conn.send(b''.join(make_frame(make_mul_request(request_id, 2), request_id) for request_id in range(1, 11)), False)
+    conn.socket.shutdown(socket.SHUT_WR)
+
+    answered = set()
+    for request_id, msg in recv_frames(conn, 10):
+        check_response(2. * request_id, msg)
+        answered.add(request_id)
+    assert answered == set(range(1, 11))
+    assert conn.socket.recv(1) == b''
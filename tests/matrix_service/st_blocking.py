@@ -160,3 +160,42 @@ with TestServer("keepalive", True) as s:
             for _ in range(2):
                 conn.send_request(msg)
                 check_response(2., conn.try_recv()[4:])
+
+
+# 5. keepalive - номер запроса из кадра возвращается в ответе, кадр без номера получает ответ без номера.
+# Блокирующий сервер отвечает на кадры по очереди
+REQUEST_ID_FLAG = 0x80000000
+
+def make_frame(msg, request_id=None):
+    if request_id is None:
+        return len(msg).to_bytes(4, 'little') + msg
+    return (len(msg) | REQUEST_ID_FLAG).to_bytes(4, 'little') + request_id.to_bytes(8, 'little') + msg
+
+# Ответы в порядке прихода: (номер запроса или None, тело)
+def recv_frames(conn, count):
+    conn.socket.settimeout(TIMEOUT)
+    data = bytearray()
+    frames = []
+    while len(frames) < count:
+        chunk = conn.socket.recv(1 << 16)
+        assert chunk, 'Connection closed after {} responses'.format(len(frames))
+        data += chunk
+        while len(data) >= 4:
+            size = int.from_bytes(data[:4], 'little')
+            header = 12 if size & REQUEST_ID_FLAG else 4
+            end = header + (size & ~REQUEST_ID_FLAG)
+            if len(data) < end:
+                break
+            request_id = int.from_bytes(data[4:12], 'little') if header == 12 else None
+            frames.append((request_id, bytes(data[header:end])))
+            del data[:end]
+    return frames
+
+with TestServer("request id echo", True) as s, Connection() as conn:
+    request_ids = [7, None, 1 << 40, 3]
+    conn.send(b''.join(make_frame(make_mul_request(i + 1, 2), request_id) for i, request_id in enumerate(request_ids)))
+
+    frames = recv_frames(conn, len(request_ids))
+    assert [request_id for request_id, _ in frames] == request_ids
+    for i, (_, msg) in enumerate(frames):
+        check_response(2. * (i + 1), msg)
@@ -31,11 +31,11 @@ class TestServer:
         print('>>> KILLING SERVER: time is over')
         self.server.kill()
 
-    def __init__(self, test_id, keepalive=False):
+    def __init__(self, test_id, keepalive=False, extra_args=[]):
         print('Started test "' + test_id + '" ...')
         self.test_id = test_id
 
-        self.server = subprocess.Popen(ARGS if not keepalive else ARGS + ['-k'], stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        self.server = subprocess.Popen((ARGS if not keepalive else ARGS + ['-k']) + extra_args, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
         sleep(0.1)
 
         self.timer = Timer(TIMEOUT, self.kill)
@@ -160,3 +160,100 @@ with TestServer("keepalive", True) as s:
             for _ in range(2):
                 conn.send_request(msg)
                 check_response(2., conn.try_recv()[4:])
+
+REQUEST_ID_FLAG = 0x80000000
+
+def make_frame(msg, request_id=None):
+    if request_id is None:
+        return len(msg).to_bytes(4, 'little') + msg
+    return (len(msg) | REQUEST_ID_FLAG).to_bytes(4, 'little') + request_id.to_bytes(8, 'little') + msg
+
+def make_square_request(side, val):
+    req_payload = matrix_service_pb2.MatrixOpRequest()
+    req_payload.op = matrix_service_pb2.MatrixOpRequest.Operator.MUL
+    for _ in range(2):
+        m = req_payload.args.add()
+        m.rows = side
+        m.columns = side
+        m.content.extend([val] * (side * side))
+
+    req = matrix_service_pb2.ProcedureData()
+    req.proc_id = matrix_service_pb2.ProcedureData.ProcedureId.MATRIX_OP
+    req.payload = req_payload.SerializeToString()
+    return req.SerializeToString()
+
+# Ответы в порядке прихода: (номер запроса или None, тело)
+def recv_frames(conn, count):
+    conn.socket.settimeout(TIMEOUT)
+    data = bytearray()
+    frames = []
+    while len(frames) < count:
+        chunk = conn.socket.recv(1 << 16)
+        assert chunk, 'Connection closed after {} responses'.format(len(frames))
+        data += chunk
+        while len(data) >= 4:
+            size = int.from_bytes(data[:4], 'little')
+            header = 12 if size & REQUEST_ID_FLAG else 4
+            end = header + (size & ~REQUEST_ID_FLAG)
+            if len(data) < end:
+                break
+            request_id = int.from_bytes(data[4:12], 'little') if header == 12 else None
+            frames.append((request_id, bytes(data[header:end])))
+            del data[:end]
+    return frames
+
+# 5. keepalive - конвейер: кадры с номерами уходят подряд, ответы сопоставляются по номеру
+with TestServer("pipelining", True) as s, Connection() as conn:
+    conn.send(b''.join(make_frame(make_mul_request(request_id, 2), request_id) for request_id in range(1, 4)))
+
+    answered = set()
+    for request_id, msg in recv_frames(conn, 3):
+        check_response(2. * request_id, msg)
+        answered.add(request_id)
+    assert answered == {1, 2, 3}
+
+# 6. Конвейер: быстрый запрос за медленным не ждет его - ответ на него приходит первым
+slow_msg = make_square_request(1000, 1.)
+with TestServer("pipelining: fast after slow", True, ['--request_threads', '2']) as s, Connection() as conn:
+    conn.send(make_frame(slow_msg, 1) + make_frame(make_mul_request(3, 2), 2))
+
+    frames = recv_frames(conn, 2)
+    assert [request_id for request_id, _ in frames] == [2, 1]
+    check_response(6., frames[0][1])
+
+# 7. Конвейер длиннее MaxPipelinedRequests (64): лишние кадры ждут в сокете, но ответ получают все
+with TestServer("pipelining: long burst", True) as s, Connection() as conn:
+    conn.send(b''.join(make_frame(make_mul_request(request_id, 2), request_id) for request_id in range(1, 201)))
+
+    answered = set()
+    for request_id, msg in recv_frames(conn, 200):
+        check_response(2. * request_id, msg)
+        answered.add(request_id)
+    assert answered == set(range(1, 201))
+
+# 8. Кадр без номера прерывает конвейер: следующие за ним читаются только после ответа на него
+with TestServer("pipelining: untagged frame", True) as s, Connection() as conn:
+    conn.send(make_frame(make_mul_request(1, 2), 1) + make_frame(make_mul_request(10, 2))
+              + make_frame(make_mul_request(2, 2), 2) + make_frame(make_mul_request(3, 2), 3))
+
+    frames = recv_frames(conn, 4)
+    untagged = [i for i, (request_id, _) in enumerate(frames) if request_id is None]
+    assert len(untagged) == 1
+    check_response(20., frames[untagged[0]][1])
+    for i, (request_id, msg) in enumerate(frames):
+        if request_id is not None:
+            check_response(2. * request_id, msg)
+            if request_id > 1:
+                assert i > untagged[0]
+
+# 9. Клиент закрыл свою сторону, не дождавшись ответов: все ответы доходят, затем сервер закрывает соединение
+with TestServer("pipelining: half-close", True) as s, Connection() as conn:
+    conn.send(b''.join(make_frame(make_mul_request(request_id, 2), request_id) for request_id in range(1, 11)), False)
+    conn.socket.shutdown(socket.SHUT_WR)
+
+    answered = set()
+    for request_id, msg in recv_frames(conn, 10):
+        check_response(2. * request_id, msg)
+        answered.add(request_id)
+    assert answered == set(range(1, 11))
+    assert conn.socket.recv(1) == b''
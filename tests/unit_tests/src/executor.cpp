@@ -3,10 +3,52 @@
 
 #include "matrix_service.pb.h"
 
+#include "matrix_op/mapped.hpp"
+#include "matrix_op/precision.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <latch>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
 using namespace matrix_service;
 
 namespace {
 
+// Выделения operator new в текущем потоке, пока включен подсчет
+thread_local bool t_count_allocations = false;
+thread_local std::size_t t_allocations = 0;
+
+} // namespace
+
+// noinline: иначе GCC видит free от указателя из operator new во встроенном коде (-Wmismatched-new-delete)
+[[gnu::noinline]] void* operator new(std::size_t size)
+{
+    if (t_count_allocations)
+        t_allocations++;
+    if (void* ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace {
+
 ProcedureData ParseResponse(std::size_t line, std::string_view response)
 {
     CAPTURE(line);
@@ -97,6 +139,42 @@ TEST_CASE("Test matrix op", "[matrix_service]")
         CHECK(typed_res_proto.result().content()[0] == 2.f);
     }
 
+    payload_proto.set_algorithm(MatrixOpRequest::STRASSEN);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        REQUIRE(typed_res_proto.result().content_size() == 1);
+        CHECK(typed_res_proto.result().content()[0] == 2.f);
+    }
+    payload_proto.set_algorithm(MatrixOpRequest::CLASSIC);
+
+
+    {
+        // Ширина больше строки кэша - в Matrix строки дополняются, в ответе - нет
+        MatrixOpRequest wide_proto;
+        wide_proto.set_op(MatrixOpRequest::MUL);
+        auto* a = wide_proto.add_args();
+        a->set_rows(2);
+        a->set_columns(1);
+        a->mutable_content()->Add(1.f);
+        a->mutable_content()->Add(2.f);
+        auto* b = wide_proto.add_args();
+        b->set_rows(1);
+        b->set_columns(20);
+        for (int i = 0; i < 20; i++)
+            b->mutable_content()->Add(i);
+
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, wide_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().rows() == 2);
+        CHECK(typed_res_proto.result().columns() == 20);
+        REQUIRE(typed_res_proto.result().content_size() == 40);
+        for (int i = 0; i < 20; i++)
+        {
+            CHECK(typed_res_proto.result().content()[i] == i);
+            CHECK(typed_res_proto.result().content()[20 + i] == 2 * i);
+        }
+    }
 
     m2->set_rows(2);
     m2->mutable_content()->Add(2); // (1x1) x (2x1)
@@ -107,3 +185,1293 @@ TEST_CASE("Test matrix op", "[matrix_service]")
         CHECK(!typed_res_proto.has_result());
     }
 }
+
+namespace {
+
+void FillMatrix(Matrix* m, std::uint32_t rows, std::uint32_t columns, float value)
+{
+    m->set_rows(rows);
+    m->set_columns(columns);
+    for (std::uint32_t i = 0; i < rows * columns; i++)
+        m->mutable_content()->Add(value);
+}
+
+std::string PackExprRequest(const MatrixExprRequest& payload_proto)
+{
+    ProcedureData request;
+    request.set_proc_id(ProcedureData::ProcedureId::ProcedureData_ProcedureId_MATRIX_EXPR);
+    *request.mutable_payload() = payload_proto.SerializeAsString();
+    return request.SerializeAsString();
+}
+
+MatrixExprResponse RunValidExprRequest(std::size_t line, const MatrixExprRequest& payload_proto)
+{
+    CAPTURE(line);
+
+    auto res = ExecuteProcedure(PackExprRequest(payload_proto));
+    CHECK(res.second);
+    ProcedureData res_proto = ParseResponse(__LINE__, res.first);
+    CHECK(res_proto.proc_id() == ProcedureData::ProcedureId::ProcedureData_ProcedureId_MATRIX_EXPR);
+
+    MatrixExprResponse typed_res_proto;
+    REQUIRE(typed_res_proto.ParseFromArray(res_proto.payload().data(), res_proto.payload().size()));
+    return typed_res_proto;
+}
+
+} // namespace
+
+TEST_CASE("Test matrix expression", "[matrix_service]")
+{
+    MatrixExprRequest payload_proto;
+    CheckError(__LINE__, PackExprRequest(payload_proto)); // No nodes
+
+    // A (2x3, все 1), B (3x4, все 2), C (4x2, все 0.5)
+    FillMatrix(payload_proto.add_inputs(), 2, 3, 1.f);
+    FillMatrix(payload_proto.add_inputs(), 3, 4, 2.f);
+    FillMatrix(payload_proto.add_inputs(), 4, 2, 0.5f);
+
+    auto* chain = payload_proto.add_nodes(); // #3 = A * B * C = 2x2, все 12
+    chain->set_op(MatrixOpRequest::MUL);
+    chain->add_args(0);
+    chain->add_args(1);
+    chain->add_args(2);
+    {
+        MatrixExprResponse typed_res_proto = RunValidExprRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().rows() == 2);
+        CHECK(typed_res_proto.result().columns() == 2);
+        REQUIRE(typed_res_proto.result().content_size() == 4);
+        for (float v : typed_res_proto.result().content())
+            CHECK(v == 12.f);
+    }
+
+    auto* square = payload_proto.add_nodes(); // #4 = #3 * #3, все 288
+    square->set_op(MatrixOpRequest::MUL);
+    square->add_args(3);
+    square->add_args(3);
+    {
+        MatrixExprResponse typed_res_proto = RunValidExprRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        REQUIRE(typed_res_proto.result().content_size() == 4);
+        for (float v : typed_res_proto.result().content())
+            CHECK(v == 288.f);
+    }
+
+    square->add_args(0); // #3 * #3 * A = 2x3
+    {
+        MatrixExprResponse typed_res_proto = RunValidExprRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().columns() == 3);
+        for (float v : typed_res_proto.result().content())
+            CHECK(v == 576.f);
+    }
+
+    square->add_args(0); // ... * A * A: 2x3 * 2x3 - не перемножаются
+    {
+        MatrixExprResponse typed_res_proto = RunValidExprRequest(__LINE__, payload_proto);
+        CHECK(typed_res_proto.has_error());
+    }
+
+    square->set_args(0, 4); // Ссылка на себя
+    CheckError(__LINE__, PackExprRequest(payload_proto));
+
+    square->clear_args();
+    square->add_args(1); // Один аргумент
+    CheckError(__LINE__, PackExprRequest(payload_proto));
+
+    // Слишком длинная цепочка в узле - ошибка запроса
+    for (int i = 0; i < 100; i++)
+        square->add_args(0);
+    CheckError(__LINE__, PackExprRequest(payload_proto));
+
+    // Промежуточный узел проверяется как результат: 65536 x 1 * 1 x 65536 не выделяется
+    {
+        MatrixExprRequest large_proto;
+        FillMatrix(large_proto.add_inputs(), 65536, 1, 1.f);
+        FillMatrix(large_proto.add_inputs(), 1, 65536, 1.f);
+        auto* outer = large_proto.add_nodes(); // #2 = 65536 x 65536
+        outer->set_op(MatrixOpRequest::MUL);
+        outer->add_args(0);
+        outer->add_args(1);
+        auto* inner = large_proto.add_nodes(); // #3 = 1 x 1
+        inner->set_op(MatrixOpRequest::MUL);
+        inner->add_args(1);
+        inner->add_args(2);
+        inner->add_args(0);
+        CHECK(RunValidExprRequest(__LINE__, large_proto).has_error());
+    }
+
+    // Пустой вход - ошибка в ответе
+    {
+        MatrixExprRequest empty_proto;
+        empty_proto.add_inputs()->set_columns(2);
+        FillMatrix(empty_proto.add_inputs(), 2, 2, 1.f);
+        auto* node = empty_proto.add_nodes();
+        node->set_op(MatrixOpRequest::MUL);
+        node->add_args(0);
+        node->add_args(1);
+        CHECK(RunValidExprRequest(__LINE__, empty_proto).has_error());
+    }
+}
+
+TEST_CASE("Test matrix op with transpose", "[matrix_service]")
+{
+    // A = [[1, 2, 3], [4, 5, 6]]
+    MatrixOpRequest payload_proto;
+    payload_proto.set_op(MatrixOpRequest::TRANSPOSE);
+    auto* a = payload_proto.add_args();
+    a->set_rows(2);
+    a->set_columns(3);
+    for (int i = 1; i <= 6; i++)
+        a->mutable_content()->Add(i);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().rows() == 3);
+        CHECK(typed_res_proto.result().columns() == 2);
+        const float expected[] = { 1, 4, 2, 5, 3, 6 };
+        REQUIRE(typed_res_proto.result().content_size() == 6);
+        CHECK(std::equal(std::begin(expected), std::end(expected), typed_res_proto.result().content().begin()));
+    }
+
+    payload_proto.add_transpose(true);
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // Flags only for MUL
+    payload_proto.clear_transpose();
+
+    *payload_proto.add_args() = *a;
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // TRANSPOSE takes one arg
+
+    // A * A^T = [[14, 32], [32, 77]]
+    payload_proto.set_op(MatrixOpRequest::MUL);
+    payload_proto.add_transpose(false);
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // One flag for two args
+
+    payload_proto.add_transpose(true);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().rows() == 2);
+        CHECK(typed_res_proto.result().columns() == 2);
+        const float expected[] = { 14, 32, 32, 77 };
+        REQUIRE(typed_res_proto.result().content_size() == 4);
+        CHECK(std::equal(std::begin(expected), std::end(expected), typed_res_proto.result().content().begin()));
+    }
+
+    // A^T * A - 3x3
+    payload_proto.set_transpose(0, true);
+    payload_proto.set_transpose(1, false);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().rows() == 3);
+        CHECK(typed_res_proto.result().columns() == 3);
+        REQUIRE(typed_res_proto.result().content_size() == 9);
+        CHECK(typed_res_proto.result().content()[0] == 17.f);
+        CHECK(typed_res_proto.result().content()[8] == 45.f);
+    }
+
+    // A^T * A^T: (3x2) * (3x2) - не перемножаются
+    payload_proto.set_transpose(1, true);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        CHECK(typed_res_proto.has_error());
+    }
+}
+
+namespace {
+
+template<typename T>
+void SetPacked(Matrix* m, std::uint32_t rows, std::uint32_t columns, Matrix::Encoding encoding, const std::vector<T>& values)
+{
+    m->set_rows(rows);
+    m->set_columns(columns);
+    m->set_encoding(encoding);
+    m->set_packed(std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)));
+}
+
+template<typename T>
+std::vector<T> GetPacked(const Matrix& m)
+{
+    std::vector<T> values(m.packed().size() / sizeof(T));
+    std::memcpy(values.data(), m.packed().data(), values.size() * sizeof(T));
+    return values;
+}
+
+} // namespace
+
+TEST_CASE("Test matrix op with reduced precision", "[matrix_service]")
+{
+    // A = [[1, 2], [3, 4]], A * A = [[7, 10], [15, 22]] - точно во всех форматах
+    const float a[] = { 1, 2, 3, 4 };
+    const float expected[] = { 7, 10, 15, 22 };
+
+    MatrixOpRequest payload_proto;
+    payload_proto.set_op(MatrixOpRequest::MUL);
+    std::vector<matrix_op::Float16> a16;
+    for (float v : a)
+        a16.push_back(matrix_op::ToFloat16(v));
+    SetPacked(payload_proto.add_args(), 2, 2, Matrix::FP16, a16);
+    SetPacked(payload_proto.add_args(), 2, 2, Matrix::FP16, a16);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().encoding() == Matrix::FP32);
+        REQUIRE(typed_res_proto.result().content_size() == 4);
+        CHECK(std::equal(std::begin(expected), std::end(expected), typed_res_proto.result().content().begin()));
+    }
+
+    payload_proto.set_result_encoding(Matrix::FP16);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        CHECK(typed_res_proto.result().encoding() == Matrix::FP16);
+        CHECK(typed_res_proto.result().content_size() == 0);
+        auto result = GetPacked<matrix_op::Float16>(typed_res_proto.result());
+        REQUIRE(result.size() == 4);
+        for (int i = 0; i < 4; i++)
+            CHECK(matrix_op::ToFloat(result[i]) == expected[i]);
+    }
+
+    std::vector<matrix_op::BFloat16> a_bf16;
+    for (float v : a)
+        a_bf16.push_back(matrix_op::ToBFloat16(v));
+    SetPacked(payload_proto.mutable_args(0), 2, 2, Matrix::BF16, a_bf16);
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // Different encodings
+
+    SetPacked(payload_proto.mutable_args(1), 2, 2, Matrix::BF16, a_bf16);
+    payload_proto.set_result_encoding(Matrix::BF16);
+    payload_proto.set_algorithm(MatrixOpRequest::STRASSEN); // Игнорируется
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        auto result = GetPacked<matrix_op::BFloat16>(typed_res_proto.result());
+        REQUIRE(result.size() == 4);
+        for (int i = 0; i < 4; i++)
+            CHECK(matrix_op::ToFloat(result[i]) == expected[i]);
+    }
+    payload_proto.set_algorithm(MatrixOpRequest::CLASSIC);
+
+    // INT8: q = value / 0.5 + 1
+    const std::vector<std::int8_t> a8 = { 3, 5, 7, 9 };
+    for (int i = 0; i < 2; i++)
+    {
+        SetPacked(payload_proto.mutable_args(i), 2, 2, Matrix::INT8, a8);
+        payload_proto.mutable_args(i)->set_scale(0.5f);
+        payload_proto.mutable_args(i)->set_zero_point(1);
+    }
+    payload_proto.set_result_encoding(Matrix::FP32);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        REQUIRE(typed_res_proto.result().content_size() == 4);
+        CHECK(std::equal(std::begin(expected), std::end(expected), typed_res_proto.result().content().begin()));
+    }
+
+    payload_proto.set_result_encoding(Matrix::INT8);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        const Matrix& result_proto = typed_res_proto.result();
+        const matrix_op::Quantization q{ result_proto.scale(), result_proto.zero_point() };
+        auto result = GetPacked<std::int8_t>(result_proto);
+        REQUIRE(result.size() == 4);
+        for (int i = 0; i < 4; i++)
+            CHECK(std::abs(matrix_op::Dequantize(result[i], q) - expected[i]) <= q.scale / 2);
+    }
+
+    payload_proto.mutable_args(1)->set_zero_point(200);
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // Invalid zero point
+    payload_proto.mutable_args(1)->set_zero_point(1);
+
+    payload_proto.mutable_args(1)->mutable_packed()->pop_back();
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // Invalid packed size
+
+    payload_proto.set_result_encoding((Matrix::Encoding) (Matrix::Encoding_MAX + 1));
+    CheckError(__LINE__, PackMatrixRequest(payload_proto));
+
+    // TRANSPOSE и выражения - только FP32
+    payload_proto.set_result_encoding(Matrix::FP32);
+    payload_proto.set_op(MatrixOpRequest::TRANSPOSE);
+    payload_proto.mutable_args()->RemoveLast();
+    CheckError(__LINE__, PackMatrixRequest(payload_proto));
+}
+
+namespace {
+
+void SetSparse(Matrix* m, std::uint32_t rows, std::uint32_t columns, Matrix::Encoding encoding,
+               const std::vector<std::uint32_t>& offsets, const std::vector<std::uint32_t>& indices, const std::vector<float>& values)
+{
+    m->set_rows(rows);
+    m->set_columns(columns);
+    m->set_encoding(encoding);
+    m->mutable_offsets()->Assign(offsets.begin(), offsets.end());
+    m->mutable_indices()->Assign(indices.begin(), indices.end());
+    m->mutable_content()->Assign(values.begin(), values.end());
+}
+
+} // namespace
+
+TEST_CASE("Test matrix op with sparse", "[matrix_service]")
+{
+    // S = [[1, 0, 0], [0, 0, 2]] (CSR), D = [[1, 2], [3, 4], [5, 6]]: S * D = [[1, 2], [10, 12]]
+    MatrixOpRequest payload_proto;
+    payload_proto.set_op(MatrixOpRequest::MUL);
+    SetSparse(payload_proto.add_args(), 2, 3, Matrix::CSR, { 0, 1, 2 }, { 0, 2 }, { 1, 2 });
+    FillMatrix(payload_proto.add_args(), 3, 2, 0);
+    for (int i = 0; i < 6; i++)
+        payload_proto.mutable_args(1)->set_content(i, i + 1);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        const std::vector<float> expected = { 1, 2, 10, 12 };
+        CHECK(typed_res_proto.result().encoding() == Matrix::FP32);
+        CHECK(std::equal(expected.begin(), expected.end(), typed_res_proto.result().content().begin(), typed_res_proto.result().content().end()));
+    }
+
+    // Тот же S в CSC, результат - CSR
+    SetSparse(payload_proto.mutable_args(0), 2, 3, Matrix::CSC, { 0, 1, 1, 2 }, { 0, 1 }, { 1, 2 });
+    payload_proto.set_result_encoding(Matrix::CSR);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        const Matrix& result = typed_res_proto.result();
+        CHECK(result.encoding() == Matrix::CSR);
+        CHECK(std::vector<std::uint32_t>(result.offsets().begin(), result.offsets().end()) == std::vector<std::uint32_t>{ 0, 2, 4 });
+        CHECK(std::vector<std::uint32_t>(result.indices().begin(), result.indices().end()) == std::vector<std::uint32_t>{ 0, 1, 0, 1 });
+        CHECK(std::vector<float>(result.content().begin(), result.content().end()) == std::vector<float>{ 1, 2, 10, 12 });
+    }
+
+    // D^T * S^T = [[1, 10], [2, 12]]: плотный слева, оба транспонированы
+    payload_proto.mutable_args()->SwapElements(0, 1);
+    payload_proto.add_transpose(true);
+    payload_proto.add_transpose(true);
+    payload_proto.set_result_encoding(Matrix::FP32);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        const std::vector<float> expected = { 1, 10, 2, 12 };
+        CHECK(std::equal(expected.begin(), expected.end(), typed_res_proto.result().content().begin(), typed_res_proto.result().content().end()));
+    }
+
+    // S * S^T = [[1, 0], [0, 4]] без плотного промежуточного
+    SetSparse(payload_proto.mutable_args(0), 2, 3, Matrix::CSR, { 0, 1, 2 }, { 0, 2 }, { 1, 2 });
+    SetSparse(payload_proto.mutable_args(1), 2, 3, Matrix::CSR, { 0, 1, 2 }, { 0, 2 }, { 1, 2 });
+    payload_proto.set_transpose(0, false);
+    payload_proto.set_result_encoding(Matrix::CSC);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        const Matrix& result = typed_res_proto.result();
+        CHECK(result.encoding() == Matrix::CSC);
+        CHECK(std::vector<std::uint32_t>(result.offsets().begin(), result.offsets().end()) == std::vector<std::uint32_t>{ 0, 1, 2 });
+        CHECK(std::vector<std::uint32_t>(result.indices().begin(), result.indices().end()) == std::vector<std::uint32_t>{ 0, 1 });
+        CHECK(std::vector<float>(result.content().begin(), result.content().end()) == std::vector<float>{ 1, 4 });
+    }
+
+    payload_proto.set_transpose(1, false);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        CHECK(typed_res_proto.has_error()); // (2 x 3) * (2 x 3)
+    }
+    payload_proto.set_transpose(1, true);
+
+    payload_proto.mutable_args(1)->set_indices(1, 3);
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // Index out of range
+    payload_proto.mutable_args(1)->set_indices(1, 2);
+
+    payload_proto.mutable_args(1)->mutable_offsets()->RemoveLast();
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // Invalid offsets size
+
+    // Размеры разреженных аргументов ограничены: (1 x 1) * (1 x 4e9) из пары смещений
+    // потребовал бы аккумулятор на 4e9 столбцов
+    {
+        MatrixOpRequest huge_proto;
+        huge_proto.set_op(MatrixOpRequest::MUL);
+        SetSparse(huge_proto.add_args(), 1, 1, Matrix::CSR, { 0, 1 }, { 0 }, { 1 });
+        SetSparse(huge_proto.add_args(), 1, 4000000000u, Matrix::CSR, { 0, 0 }, {}, {});
+        huge_proto.set_result_encoding(Matrix::CSR);
+        CHECK(RunValidMatrixRequest(__LINE__, huge_proto).has_error());
+        huge_proto.set_result_encoding(Matrix::CSC);
+        CHECK(RunValidMatrixRequest(__LINE__, huge_proto).has_error());
+        huge_proto.mutable_args(0)->Clear();
+        FillMatrix(huge_proto.mutable_args(0), 1, 1, 1);
+        CHECK(RunValidMatrixRequest(__LINE__, huge_proto).has_error());
+    }
+
+    // Разреженный умножается только на FP32 или разреженный
+    SetPacked(payload_proto.mutable_args(1), 3, 2, Matrix::FP16, std::vector<matrix_op::Float16>(6));
+    payload_proto.clear_transpose();
+    CheckError(__LINE__, PackMatrixRequest(payload_proto));
+}
+
+namespace {
+
+std::string PackBatchRequest(const BatchMulRequest& payload_proto)
+{
+    ProcedureData request;
+    request.set_proc_id(ProcedureData::BATCH_MUL);
+    request.set_payload(payload_proto.SerializeAsString());
+    return request.SerializeAsString();
+}
+
+} // namespace
+
+TEST_CASE("Test batch multiplication", "[matrix_service]")
+{
+    // A_i = i * E (2 x 2), B_i = [[1, 2], [3, 4]]: C_i = i * B_i
+    constexpr std::uint32_t count = 10;
+    BatchMulRequest payload_proto;
+    payload_proto.set_count(count);
+    payload_proto.set_rows(2);
+    payload_proto.set_inner(2);
+    payload_proto.set_columns(2);
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        for (float v : { float(i), 0.f, 0.f, float(i) })
+            payload_proto.add_first(v);
+        for (float v : { 1.f, 2.f, 3.f, 4.f })
+            payload_proto.add_another(v);
+    }
+
+    {
+        auto res = ExecuteProcedure(PackBatchRequest(payload_proto));
+        REQUIRE(res.second);
+        ProcedureData res_proto = ParseResponse(__LINE__, res.first);
+        CHECK(res_proto.proc_id() == ProcedureData::BATCH_MUL);
+
+        BatchMulResponse typed_res_proto;
+        REQUIRE(typed_res_proto.ParseFromString(res_proto.payload()));
+        REQUIRE(typed_res_proto.has_result());
+        const auto& result = typed_res_proto.result();
+        CHECK(result.count() == count);
+        CHECK(result.rows() == 2);
+        CHECK(result.columns() == 2);
+        REQUIRE(result.content_size() == 4 * count);
+        for (std::uint32_t i = 0; i < count; i++)
+         for (std::uint32_t j = 0; j < 4; j++)
+            CHECK(result.content()[i * 4 + j] == i * (j + 1.f));
+    }
+
+    payload_proto.mutable_another()->RemoveLast();
+    {
+        auto res = ExecuteProcedure(PackBatchRequest(payload_proto));
+        REQUIRE(res.second);
+        BatchMulResponse typed_res_proto;
+        REQUIRE(typed_res_proto.ParseFromString(ParseResponse(__LINE__, res.first).payload()));
+        CHECK(typed_res_proto.has_error());
+    }
+
+    // Размеры, произведения которых переполняются: ошибка вместо умножения пустых данных
+    payload_proto.set_count(1u << 22);
+    payload_proto.set_rows(1u << 21);
+    payload_proto.set_inner(1u << 21);
+    payload_proto.set_columns(1u << 21);
+    payload_proto.clear_first();
+    payload_proto.clear_another();
+    {
+        auto res = ExecuteProcedure(PackBatchRequest(payload_proto));
+        REQUIRE(res.second);
+        BatchMulResponse typed_res_proto;
+        REQUIRE(typed_res_proto.ParseFromString(ParseResponse(__LINE__, res.first).payload()));
+        CHECK(typed_res_proto.has_error());
+    }
+}
+
+TEST_CASE("Test matrix op with epilogue", "[matrix_service]")
+{
+    // A = [[1, 2], [3, 4]], A * A = [[7, 10], [15, 22]]
+    MatrixOpRequest payload_proto;
+    payload_proto.set_op(MatrixOpRequest::MUL);
+    for (int i = 0; i < 2; i++)
+    {
+        FillMatrix(payload_proto.add_args(), 2, 2, 0);
+        for (int j = 0; j < 4; j++)
+            payload_proto.mutable_args(i)->set_content(j, j + 1);
+    }
+
+    // relu(2 * A * A - [[100, 0], [0, 0]] + [1, -30])
+    auto* epilogue = payload_proto.mutable_epilogue();
+    epilogue->set_alpha(2);
+    epilogue->set_beta(-1);
+    FillMatrix(epilogue->mutable_addend(), 2, 2, 0);
+    epilogue->mutable_addend()->set_content(0, 100);
+    epilogue->add_bias(1);
+    epilogue->add_bias(-30);
+    epilogue->set_activation(MatrixOpRequest::RELU);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        const std::vector<float> expected = { 0, 0, 31, 14 };
+        CHECK(std::equal(expected.begin(), expected.end(), typed_res_proto.result().content().begin(), typed_res_proto.result().content().end()));
+    }
+
+    // Без alpha - 1, в кодировке пониженной точности - так же
+    epilogue->clear_alpha();
+    epilogue->set_beta(0);
+    epilogue->set_activation(MatrixOpRequest::NONE);
+    payload_proto.set_result_encoding(Matrix::FP16);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(typed_res_proto.has_result());
+        const std::vector<float> expected = { 8, -20, 16, -8 };
+        auto result = GetPacked<matrix_op::Float16>(typed_res_proto.result());
+        REQUIRE(result.size() == 4);
+        for (int i = 0; i < 4; i++)
+            CHECK(matrix_op::ToFloat(result[i]) == expected[i]);
+    }
+    payload_proto.set_result_encoding(Matrix::FP32);
+
+    epilogue->add_bias(0);
+    {
+        MatrixOpResponse typed_res_proto = RunValidMatrixRequest(__LINE__, payload_proto);
+        CHECK(typed_res_proto.has_error()); // Bias size != columns
+    }
+    epilogue->clear_bias();
+
+    epilogue->set_beta(1);
+    epilogue->clear_addend();
+    CheckError(__LINE__, PackMatrixRequest(payload_proto)); // Beta without addend
+
+    epilogue->set_beta(0);
+    epilogue->set_activation((MatrixOpRequest::Activation) 100);
+    CheckError(__LINE__, PackMatrixRequest(payload_proto));
+    epilogue->set_activation(MatrixOpRequest::NONE);
+
+    payload_proto.set_op(MatrixOpRequest::TRANSPOSE);
+    payload_proto.mutable_args()->RemoveLast();
+    CheckError(__LINE__, PackMatrixRequest(payload_proto));
+}
+
+TEST_CASE("Test framed execution", "[matrix_service]")
+{
+    MatrixOpRequest payload_proto;
+    payload_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+    for (int i = 0; i < 2; i++)
+    {
+        auto* m = payload_proto.add_args();
+        m->set_rows(2);
+        m->set_columns(2);
+        for (float v : {1.f, 2.f, 3.f, 4.f})
+            m->mutable_content()->Add(v);
+    }
+    const std::string request = PackMatrixRequest(payload_proto);
+
+    auto check_framed = [](std::size_t line, std::string_view request, bool expected_success)
+    {
+        CAPTURE(line);
+        std::vector<char> framed(3, 'x'); // Прежнее содержимое перезаписывается
+        CHECK(ExecuteProcedure(request, framed) == expected_success);
+        REQUIRE(framed.size() >= sizeof(FrameSize));
+        FrameSize size = 0;
+        std::memcpy(&size, framed.data(), sizeof(size));
+        CHECK(std::size_t(size) == framed.size() - sizeof(FrameSize));
+
+        // Байт в байт как сериализация протобуфа
+        auto plain = ExecuteProcedure(request);
+        CHECK(plain.second == expected_success);
+        CHECK(std::string_view(framed.data() + sizeof(FrameSize), size) == plain.first);
+    };
+
+    check_framed(__LINE__, request, true);
+    check_framed(__LINE__, "qqq", false);
+    check_framed(__LINE__, "", false);
+    {
+        // Ошибка вычисления - успешный ответ с error
+        payload_proto.mutable_args(1)->set_rows(1);
+        payload_proto.mutable_args(1)->set_columns(4);
+        check_framed(__LINE__, PackMatrixRequest(payload_proto), true);
+        payload_proto.mutable_args(1)->set_rows(2);
+        payload_proto.mutable_args(1)->set_columns(2);
+    }
+
+    // Неизвестные поля пропускаются, payload перед proc_id разбирается так же
+    {
+        std::string reordered;
+        ProcedureData only_payload;
+        *only_payload.mutable_payload() = payload_proto.SerializeAsString();
+        ProcedureData only_id;
+        only_id.set_proc_id(ProcedureData::ProcedureId::ProcedureData_ProcedureId_MATRIX_OP);
+        reordered = only_payload.SerializeAsString() + "\xa8\x01\x05" /* поле 21 = 5 */ + only_id.SerializeAsString();
+
+        std::vector<char> framed;
+        REQUIRE(ExecuteProcedure(reordered, framed));
+        std::vector<char> expected;
+        REQUIRE(ExecuteProcedure(request, expected));
+        CHECK(framed == expected);
+    }
+
+    // Буфер ответа переиспользуется: повторный запрос не перевыделяет его.
+    // Арена потока уже подросла после первого запроса - дальше разбор, исполнение и ответ не идут в кучу
+    std::vector<char> framed;
+    t_allocations = 0;
+    t_count_allocations = true;
+    bool succeeded = ExecuteProcedure(request, framed);
+    t_count_allocations = false;
+    REQUIRE(succeeded);
+    CHECK(t_allocations > 0); // Хотя бы под буфер ответа: подсчет работает
+    const char* data = framed.data();
+    t_allocations = 0;
+    t_count_allocations = true;
+    for (int i = 0; i < 10; i++)
+        succeeded = ExecuteProcedure(request, framed) && succeeded;
+    t_count_allocations = false;
+    REQUIRE(succeeded);
+    CHECK(framed.data() == data);
+    CHECK(t_allocations == 0);
+
+    ProcedureData res_proto = ParseResponse(__LINE__, std::string_view(framed.data() + sizeof(FrameSize), framed.size() - sizeof(FrameSize)));
+    MatrixOpResponse typed_res_proto;
+    REQUIRE(typed_res_proto.ParseFromString(res_proto.payload()));
+    CHECK(std::vector<float>(typed_res_proto.result().content().begin(), typed_res_proto.result().content().end())
+          == std::vector<float>{7.f, 10.f, 15.f, 22.f});
+}
+
+TEST_CASE("Test result cache", "[matrix_service]")
+{
+    auto square_request = [](float value)
+    {
+        MatrixOpRequest payload_proto;
+        payload_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+        for (int i = 0; i < 2; i++)
+        {
+            auto* m = payload_proto.add_args();
+            m->set_rows(1);
+            m->set_columns(1);
+            m->mutable_content()->Add(value);
+        }
+        return PackMatrixRequest(payload_proto);
+    };
+
+    CHECK(GetResultCacheStats().hits == 0);
+
+    ExecutorConfig conf;
+    conf.result_cache_bytes = 1 << 20;
+    ConfigureExecutor(conf);
+
+    const std::string request = square_request(3.f);
+    auto first = ExecuteProcedure(request);
+    REQUIRE(first.second);
+    auto second = ExecuteProcedure(request);
+    CHECK(second == first);
+    {
+        ResultCacheStats stats = GetResultCacheStats();
+        CHECK(stats.hits == 1);
+        CHECK(stats.misses == 1);
+        CHECK(stats.entries == 1);
+        CHECK(stats.bytes >= request.size() + first.first.size());
+    }
+
+    // Другие данные - другой ответ
+    auto other = ExecuteProcedure(square_request(4.f));
+    REQUIRE(other.second);
+    CHECK(other.first != first.first);
+    CHECK(GetResultCacheStats().entries == 2);
+
+    // Ошибки протокола не запоминаются
+    CheckError(__LINE__, "qqq");
+    CheckError(__LINE__, "qqq");
+    CHECK(GetResultCacheStats().entries == 2);
+    CHECK(GetResultCacheStats().hits == 1);
+
+    // Лимит памяти соблюдается: старые записи вытесняются
+    conf.result_cache_bytes = 16 * 1024;
+    ConfigureExecutor(conf);
+    for (int i = 0; i < 1000; i++)
+        REQUIRE(ExecuteProcedure(square_request(float(i))).second);
+    {
+        ResultCacheStats stats = GetResultCacheStats();
+        CHECK(stats.misses == 1000);
+        CHECK(stats.bytes <= conf.result_cache_bytes);
+        CHECK(stats.entries > 0);
+        CHECK(stats.entries < 1000);
+    }
+    auto recomputed = ExecuteProcedure(square_request(0.f));
+    REQUIRE(recomputed.second);
+    ProcedureData res_proto = ParseResponse(__LINE__, recomputed.first);
+    MatrixOpResponse typed_res_proto;
+    REQUIRE(typed_res_proto.ParseFromString(res_proto.payload()));
+    CHECK(typed_res_proto.result().content()[0] == 0.f);
+
+    ConfigureExecutor({});
+    CHECK(GetResultCacheStats().entries == 0);
+}
+
+TEST_CASE("Test async execution", "[matrix_service]")
+{
+    constexpr int Requests = 64;
+
+    ExecutorConfig conf;
+    conf.request_threads = 4;
+    ConfigureExecutor(conf);
+
+    std::vector<std::string> requests;
+    for (int i = 0; i < Requests; i++)
+    {
+        MatrixOpRequest payload_proto;
+        payload_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+        for (int a = 0; a < 2; a++)
+        {
+            auto* m = payload_proto.add_args();
+            m->set_rows(3);
+            m->set_columns(3);
+            for (int j = 0; j < 9; j++)
+                m->mutable_content()->Add(float(i + j));
+        }
+        requests.push_back(i % 8 == 7 ? std::string("qqq") : PackMatrixRequest(payload_proto));
+    }
+
+    std::mutex mutex;
+    std::vector<AsyncProcedure> done(Requests);
+    std::latch finished(Requests);
+    for (int i = 0; i < Requests; i++)
+    {
+        // Как в сервере: запрос после префикса размера
+        AsyncProcedure procedure;
+        procedure.request.assign(sizeof(FrameSize), '\0');
+        procedure.request.insert(procedure.request.end(), requests[i].begin(), requests[i].end());
+        procedure.request_offset = sizeof(FrameSize);
+
+        SubmitProcedure(std::move(procedure), [&, i](AsyncProcedure&& result)
+        {
+            {
+                std::lock_guard lock(mutex);
+                done[i] = std::move(result);
+            }
+            finished.count_down();
+        });
+    }
+    finished.wait();
+
+    for (int i = 0; i < Requests; i++)
+    {
+        CAPTURE(i);
+        std::vector<char> expected;
+        const bool succeeded = ExecuteProcedure(requests[i], expected);
+        CHECK(done[i].succeeded == succeeded);
+        CHECK(done[i].succeeded == (i % 8 != 7));
+        CHECK(done[i].framed_response == expected);
+        CHECK(done[i].request.size() == sizeof(FrameSize) + requests[i].size()); // Буфер запроса возвращается
+    }
+
+    ConfigureExecutor({});
+}
+
+TEST_CASE("Test request scheduler", "[matrix_service]")
+{
+    auto square_request = [](std::uint32_t side, bool transpose_first)
+    {
+        MatrixOpRequest payload_proto;
+        payload_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+        for (int a = 0; a < 2; a++)
+        {
+            auto* m = payload_proto.add_args();
+            // Первый аргумент - side x 1 (или 1 x side с транспонированием): стоимость side * side
+            m->set_rows(a == 0 && !transpose_first ? side : 1);
+            m->set_columns(a == 0 && !transpose_first ? 1 : side);
+            for (std::uint32_t j = 0; j < side; j++)
+                m->mutable_content()->Add(1.f);
+        }
+        if (transpose_first)
+        {
+            payload_proto.add_transpose(true);
+            payload_proto.add_transpose(false);
+        }
+        return PackMatrixRequest(payload_proto);
+    };
+
+    ExecutorConfig conf;
+    conf.request_threads = 4;
+    conf.small_request_slots = 1;
+    conf.large_request_slots = 1;
+    conf.small_request_cost = 100 * 100;
+    ConfigureExecutor(conf);
+
+    // Синхронно: стоимость оценивается по размерам с учетом транспонирования
+    REQUIRE(ExecuteProcedure(square_request(8, false)).second);
+    REQUIRE(ExecuteProcedure(square_request(8, true)).second);
+    REQUIRE(ExecuteProcedure(square_request(200, true)).second);
+    CHECK(!ExecuteProcedure("qqq").second);
+    {
+        // 2^16 в четвертой степени переполняет uint64: оценка насыщается, а не становится нулевой
+        BatchMulRequest batch;
+        batch.set_count(1 << 16);
+        batch.set_rows(1 << 16);
+        batch.set_inner(1 << 16);
+        batch.set_columns(1 << 16);
+        auto res = ExecuteProcedure(PackBatchRequest(batch));
+        REQUIRE(res.second);
+        BatchMulResponse typed_res_proto;
+        REQUIRE(typed_res_proto.ParseFromString(ParseResponse(__LINE__, res.first).payload()));
+        CHECK(typed_res_proto.has_error());
+    }
+    {
+        SchedulerStats stats = GetSchedulerStats();
+        CHECK(stats.small_started == 3);
+        CHECK(stats.large_started == 2);
+        CHECK(stats.small_waiting + stats.large_waiting == 0);
+    }
+
+    // Асинхронно: дорогие идут по одному, мелкие не ждут их в общей очереди
+    constexpr int Large = 3;
+    constexpr int Small = 40;
+    std::mutex mutex;
+    std::vector<int> order;
+    std::latch finished(Large + Small);
+    auto submit = [&](const std::string& request, int tag)
+    {
+        AsyncProcedure procedure;
+        procedure.request.assign(request.begin(), request.end());
+        SubmitProcedure(std::move(procedure), [&, tag](AsyncProcedure&& result)
+        {
+            CHECK(result.succeeded);
+            {
+                std::lock_guard lock(mutex);
+                order.push_back(tag);
+            }
+            finished.count_down();
+        });
+    };
+    for (int i = 0; i < Large; i++)
+        submit(square_request(1500, false), -1);
+    for (int i = 0; i < Small; i++)
+        submit(square_request(4, i % 2 == 0), i);
+    finished.wait();
+
+    // Порядок завершений зависит от потоков пула - проверяем только, что каждый запрос завершился один раз.
+    // Раздельные полосы видны по счетчикам планировщика
+    REQUIRE(order.size() == Large + Small);
+    std::sort(order.begin(), order.end());
+    CHECK(std::count(order.begin(), order.end(), -1) == Large);
+    CHECK(std::adjacent_find(order.begin() + Large, order.end()) == order.end());
+    SchedulerStats stats = GetSchedulerStats();
+    CHECK(stats.small_started == 3 + Small);
+    CHECK(stats.large_started == 2 + Large);
+    CHECK(stats.small_waiting + stats.large_waiting == 0);
+
+    ConfigureExecutor({});
+    CHECK(GetSchedulerStats().small_started == 0);
+}
+
+TEST_CASE("Test request coalescing", "[matrix_service]")
+{
+    constexpr int Clients = 6;
+    constexpr std::uint32_t Inner = 48;
+    constexpr std::uint32_t Columns = 40;
+
+    // Целые значения: результат точный при любом порядке суммирования
+    auto make_request = [](int client, std::uint32_t weights_seed, bool transpose_first)
+    {
+        MatrixOpRequest payload_proto;
+        payload_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+        const std::uint32_t rows = 1 + client * 3;
+        auto* a = payload_proto.add_args();
+        a->set_rows(transpose_first ? Inner : rows);
+        a->set_columns(transpose_first ? rows : Inner);
+        for (std::uint32_t i = 0; i < rows * Inner; i++)
+            a->mutable_content()->Add(float((i * 7 + client) % 11) - 5.f);
+        auto* b = payload_proto.add_args();
+        b->set_rows(Inner);
+        b->set_columns(Columns);
+        for (std::uint32_t i = 0; i < Inner * Columns; i++)
+            b->mutable_content()->Add(float((i * 13 + weights_seed) % 9) - 4.f);
+        if (transpose_first)
+        {
+            payload_proto.add_transpose(true);
+            payload_proto.add_transpose(false);
+        }
+        return PackMatrixRequest(payload_proto);
+    };
+
+    std::vector<std::string> requests;
+    for (int client = 0; client < Clients; client++)
+        requests.push_back(make_request(client, 1, client % 2 == 1));
+    requests.push_back(make_request(Clients, 2, false)); // Другая матрица весов
+
+    std::vector<std::string> expected;
+    for (const auto& request : requests)
+        expected.push_back(ExecuteProcedure(request).first);
+    CHECK(GetCoalescingStats().requests == 0);
+
+    ExecutorConfig conf;
+    conf.coalesce_window_us = 300'000;
+    ConfigureExecutor(conf);
+
+    std::vector<std::string> responses(requests.size());
+    std::vector<std::thread> clients;
+    for (std::size_t i = 0; i < requests.size(); i++)
+        clients.emplace_back([&, i] { responses[i] = ExecuteProcedure(requests[i]).first; });
+    for (auto& client : clients)
+        client.join();
+
+    for (std::size_t i = 0; i < requests.size(); i++)
+    {
+        CAPTURE(i);
+        CHECK(responses[i] == expected[i]);
+    }
+
+    CoalescingStats stats = GetCoalescingStats();
+    CHECK(stats.window_us == 300'000);
+    CHECK(stats.requests == requests.size());
+    CHECK(stats.coalesced >= 1);
+    CHECK(stats.coalesced <= Clients - 1); // Запрос с другими весами ни к кому не присоединяется
+    CHECK(stats.batches >= 1);
+
+    // С эпилогом умножение не объединяется
+    {
+        MatrixOpRequest payload_proto;
+        REQUIRE(payload_proto.ParseFromString(ParseResponse(__LINE__, requests[0]).payload()));
+        payload_proto.mutable_epilogue()->set_activation(MatrixOpRequest::RELU);
+        RunValidMatrixRequest(__LINE__, payload_proto);
+        CHECK(GetCoalescingStats().requests == requests.size());
+    }
+
+    ConfigureExecutor({});
+}
+
+namespace {
+
+template<typename ResponseT, typename RequestT>
+ResponseT RunStoreProcedure(std::size_t line, ProcedureData::ProcedureId proc_id, const RequestT& payload_proto)
+{
+    CAPTURE(line);
+    ProcedureData request;
+    request.set_proc_id(proc_id);
+    request.set_payload(payload_proto.SerializeAsString());
+
+    auto res = ExecuteProcedure(request.SerializeAsString());
+    CHECK(res.second);
+    ProcedureData res_proto = ParseResponse(__LINE__, res.first);
+    CHECK(res_proto.proc_id() == proc_id);
+
+    ResponseT typed_res_proto;
+    REQUIRE(typed_res_proto.ParseFromString(res_proto.payload()));
+    return typed_res_proto;
+}
+
+StoreMatrixResponse StoreMatrix(std::size_t line, const Matrix& m)
+{
+    StoreMatrixRequest payload_proto;
+    *payload_proto.mutable_matrix() = m;
+    return RunStoreProcedure<StoreMatrixResponse>(line, ProcedureData::STORE_MATRIX, payload_proto);
+}
+
+bool ReleaseMatrix(std::size_t line, std::uint64_t handle)
+{
+    ReleaseMatrixRequest payload_proto;
+    payload_proto.set_handle(handle);
+    return RunStoreProcedure<ReleaseMatrixResponse>(line, ProcedureData::RELEASE_MATRIX, payload_proto).released();
+}
+
+// Целые значения: результат точный при любом порядке суммирования
+Matrix IntegerMatrix(std::uint32_t rows, std::uint32_t columns, std::uint32_t seed)
+{
+    Matrix m;
+    m.set_rows(rows);
+    m.set_columns(columns);
+    for (std::uint32_t i = 0; i < rows * columns; i++)
+        m.mutable_content()->Add(float((i * 7 + seed) % 11) - 5.f);
+    return m;
+}
+
+Matrix HandleMatrix(std::uint64_t handle)
+{
+    Matrix m;
+    m.set_handle(handle);
+    return m;
+}
+
+} // namespace
+
+TEST_CASE("Test matrix store", "[matrix_service]")
+{
+    const Matrix a = IntegerMatrix(37, 300, 1);
+    const Matrix b = IntegerMatrix(300, 45, 2);
+
+    // Без хранилища загрузка - ошибка в ответе
+    CHECK(StoreMatrix(__LINE__, b).has_error());
+    CHECK(!ReleaseMatrix(__LINE__, 1));
+
+    ExecutorConfig conf;
+    conf.matrix_store_bytes = 1 << 20;
+    ConfigureExecutor(conf);
+
+    const StoreMatrixResponse stored_a = StoreMatrix(__LINE__, a);
+    const StoreMatrixResponse stored_b = StoreMatrix(__LINE__, b);
+    REQUIRE(stored_a.has_handle());
+    REQUIRE(stored_b.has_handle());
+    CHECK(stored_a.handle() != stored_b.handle());
+    {
+        MatrixStoreStats stats = GetMatrixStoreStats();
+        CHECK(stats.matrices == 2);
+        CHECK(stats.bytes >= 2 * (37 * 300 + 300 * 45) * sizeof(float));
+        CHECK(stats.evictions == 0);
+    }
+
+    // Handle вместо аргумента дает тот же результат, что и сама матрица - в любой позиции
+    MatrixOpRequest inline_proto;
+    inline_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+    *inline_proto.add_args() = a;
+    *inline_proto.add_args() = b;
+    inline_proto.mutable_epilogue()->set_alpha(2.f);
+    for (int i = 0; i < 45; i++)
+        inline_proto.mutable_epilogue()->add_bias(float(i));
+    const MatrixOpResponse expected = RunValidMatrixRequest(__LINE__, inline_proto);
+    REQUIRE(expected.has_result());
+
+    for (int mask = 1; mask < 4; mask++)
+    {
+        CAPTURE(mask);
+        MatrixOpRequest payload_proto = inline_proto;
+        if (mask & 1)
+            *payload_proto.mutable_args(0) = HandleMatrix(stored_a.handle());
+        if (mask & 2)
+            *payload_proto.mutable_args(1) = HandleMatrix(stored_b.handle());
+        const MatrixOpResponse response = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(response.has_result());
+        CHECK(response.result().SerializeAsString() == expected.result().SerializeAsString());
+    }
+
+    // Транспонированный аргумент из хранилища и транспонирование самой матрицы
+    {
+        MatrixOpRequest payload_proto;
+        payload_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+        *payload_proto.add_args() = HandleMatrix(stored_b.handle());
+        *payload_proto.add_args() = HandleMatrix(stored_b.handle());
+        payload_proto.add_transpose(true);
+        payload_proto.add_transpose(false);
+        const MatrixOpResponse response = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(response.has_result());
+        CHECK(response.result().rows() == 45);
+        CHECK(response.result().columns() == 45);
+
+        payload_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_TRANSPOSE);
+        payload_proto.mutable_args()->RemoveLast();
+        payload_proto.clear_transpose();
+        const MatrixOpResponse transposed = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(transposed.has_result());
+        CHECK(transposed.result().rows() == 45);
+        CHECK(transposed.result().content()[1] == b.content()[45]);
+    }
+
+    // Вход выражения
+    {
+        MatrixExprRequest payload_proto;
+        *payload_proto.add_inputs() = HandleMatrix(stored_a.handle());
+        *payload_proto.add_inputs() = b;
+        auto* node = payload_proto.add_nodes();
+        node->set_op(MatrixOpRequest::MUL);
+        node->add_args(0);
+        node->add_args(1);
+        const MatrixExprResponse response = RunValidExprRequest(__LINE__, payload_proto);
+        REQUIRE(response.has_result());
+        CHECK(response.result().rows() == 37);
+    }
+
+    // Освобожденный handle - ошибка в ответе, соединение не рвется
+    CHECK(ReleaseMatrix(__LINE__, stored_a.handle()));
+    CHECK(!ReleaseMatrix(__LINE__, stored_a.handle()));
+    {
+        MatrixOpRequest payload_proto = inline_proto;
+        *payload_proto.mutable_args(0) = HandleMatrix(stored_a.handle());
+        CHECK(RunValidMatrixRequest(__LINE__, payload_proto).has_error());
+    }
+    CHECK(GetMatrixStoreStats().matrices == 1);
+
+    // Хранилище - только для FP32, handle не загружается повторно
+    {
+        MatrixOpRequest payload_proto = inline_proto;
+        payload_proto.clear_epilogue();
+        for (int i = 0; i < 2; i++)
+        {
+            *payload_proto.mutable_args(i) = HandleMatrix(stored_b.handle());
+            payload_proto.mutable_args(i)->set_encoding(Matrix::FP16);
+        }
+        CheckError(__LINE__, PackMatrixRequest(payload_proto));
+
+        ProcedureData request;
+        request.set_proc_id(ProcedureData::STORE_MATRIX);
+        StoreMatrixRequest store_proto;
+        *store_proto.mutable_matrix() = HandleMatrix(stored_b.handle());
+        request.set_payload(store_proto.SerializeAsString());
+        CheckError(__LINE__, request.SerializeAsString());
+    }
+
+    // Лимит памяти: давно не использованные вытесняются, нужные запросу - нет
+    conf.matrix_store_bytes = 256 * 1024;
+    ConfigureExecutor(conf);
+    std::vector<std::uint64_t> handles;
+    for (int i = 0; i < 20; i++)
+    {
+        const StoreMatrixResponse stored = StoreMatrix(__LINE__, b);
+        REQUIRE(stored.has_handle());
+        handles.push_back(stored.handle());
+    }
+    {
+        MatrixStoreStats stats = GetMatrixStoreStats();
+        CHECK(stats.evictions > 0);
+        CHECK(stats.matrices < 20);
+        CHECK(stats.bytes <= conf.matrix_store_bytes);
+    }
+    {
+        MatrixOpRequest payload_proto = inline_proto;
+        *payload_proto.mutable_args(1) = HandleMatrix(handles.front());
+        CHECK(RunValidMatrixRequest(__LINE__, payload_proto).has_error());
+        *payload_proto.mutable_args(1) = HandleMatrix(handles.back());
+        const MatrixOpResponse response = RunValidMatrixRequest(__LINE__, payload_proto);
+        REQUIRE(response.has_result());
+        CHECK(response.result().SerializeAsString() == expected.result().SerializeAsString());
+    }
+
+    // Матрица больше лимита не сохраняется
+    CHECK(StoreMatrix(__LINE__, IntegerMatrix(300, 300, 3)).has_error());
+
+    // Пустая матрица - ошибка в ответе, а не исключение из исполнителя
+    {
+        Matrix empty;
+        empty.set_rows(0);
+        empty.set_columns(5);
+        CHECK(StoreMatrix(__LINE__, empty).has_error());
+    }
+
+    // С кэшем ответов: запрос с освобожденным handle получает error, а не прежний ответ из кэша
+    conf.result_cache_bytes = 64 << 20;
+    ConfigureExecutor(conf);
+    {
+        const StoreMatrixResponse stored = StoreMatrix(__LINE__, b);
+        REQUIRE(stored.has_handle());
+        MatrixOpRequest payload_proto = inline_proto;
+        *payload_proto.mutable_args(1) = HandleMatrix(stored.handle());
+        for (int i = 0; i < 2; i++)
+        {
+            const MatrixOpResponse response = RunValidMatrixRequest(__LINE__, payload_proto);
+            REQUIRE(response.has_result());
+            CHECK(response.result().SerializeAsString() == expected.result().SerializeAsString());
+        }
+        CHECK(ReleaseMatrix(__LINE__, stored.handle()));
+        CHECK(RunValidMatrixRequest(__LINE__, payload_proto).has_error());
+        CHECK(GetResultCacheStats().hits == 0);
+
+        // Запрос без handle кэшируется как прежде
+        RunValidMatrixRequest(__LINE__, inline_proto);
+        RunValidMatrixRequest(__LINE__, inline_proto);
+        CHECK(GetResultCacheStats().hits == 1);
+    }
+
+    ConfigureExecutor({});
+    CHECK(GetMatrixStoreStats().matrices == 0);
+}
+
+TEST_CASE("Test mapped multiplication", "[matrix_service]")
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "matrix_service_mapped_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    const Matrix a = IntegerMatrix(40, 700, 1);
+    const Matrix b = IntegerMatrix(700, 30, 2);
+    auto write = [&](const char* name, const Matrix& source)
+    {
+        matrix_op::MappedMatrix mapped = matrix_op::MappedMatrix::Create((dir / name).string(), source.rows(), source.columns());
+        std::copy(source.content().begin(), source.content().end(), mapped.MutableView().Data());
+        mapped.Commit();
+    };
+    write("a.bin", a);
+    write("b.bin", b);
+
+    auto run = [](std::size_t line, const MappedMulRequest& payload_proto)
+    {
+        return RunStoreProcedure<MappedMulResponse>(line, ProcedureData::MAPPED_MUL, payload_proto);
+    };
+
+    MappedMulRequest payload_proto;
+    payload_proto.set_first("a.bin");
+    payload_proto.set_another("b.bin");
+    payload_proto.set_result("c.bin");
+    payload_proto.set_working_set_bytes(64 * 1024);
+
+    // Без каталога процедура выключена
+    CHECK(run(__LINE__, payload_proto).has_error());
+
+    ExecutorConfig conf;
+    conf.mapped_matrix_dir = dir.string();
+    conf.result_cache_bytes = 1 << 20;
+    ConfigureExecutor(conf);
+
+    const MappedMulResponse response = run(__LINE__, payload_proto);
+    REQUIRE(response.has_result());
+    CHECK(response.result().rows() == 40);
+    CHECK(response.result().columns() == 30);
+
+    // Тот же результат, что и у умножения в памяти
+    MatrixOpRequest inline_proto;
+    inline_proto.set_op(MatrixOpRequest::Operator::MatrixOpRequest_Operator_MUL);
+    *inline_proto.add_args() = a;
+    *inline_proto.add_args() = b;
+    const MatrixOpResponse expected = RunValidMatrixRequest(__LINE__, inline_proto);
+    REQUIRE(expected.has_result());
+    {
+        const matrix_op::MappedMatrix result = matrix_op::MappedMatrix::Open((dir / "c.bin").string());
+        CHECK(std::equal(expected.result().content().begin(), expected.result().content().end(), result.View().Data()));
+    }
+
+    // Файлы могут меняться: ответ не берется из кэша
+    CHECK(run(__LINE__, payload_proto).has_result());
+    CHECK(GetResultCacheStats().hits == 0);
+
+    // Ошибки файлов - в ответе, выход за каталог - ошибка запроса
+    payload_proto.set_another("missing.bin");
+    CHECK(run(__LINE__, payload_proto).has_error());
+    payload_proto.set_another("a.bin");
+    CHECK(run(__LINE__, payload_proto).has_error());
+
+    // Результат поверх аргумента - ошибка, аргумент не тронут
+    payload_proto.set_another("b.bin");
+    for (const char* path : { "a.bin", "b.bin", "./a.bin" })
+    {
+        CAPTURE(path);
+        payload_proto.set_result(path);
+        CHECK(run(__LINE__, payload_proto).has_error());
+    }
+    {
+        const matrix_op::MappedMatrix first = matrix_op::MappedMatrix::Open((dir / "a.bin").string());
+        CHECK(std::equal(a.content().begin(), a.content().end(), first.View().Data()));
+    }
+    payload_proto.set_result("c.bin");
+
+    // Символические ссылки не разыменовываются: ни на файлы вне каталога, ни на каталоги
+    const std::filesystem::path outside = std::filesystem::temp_directory_path() / "matrix_service_mapped_outside";
+    std::filesystem::remove_all(outside);
+    std::filesystem::create_directories(outside);
+    std::filesystem::copy_file(dir / "a.bin", outside / "a.bin", std::filesystem::copy_options::overwrite_existing);
+    const auto outside_size = std::filesystem::file_size(outside / "a.bin");
+    std::filesystem::create_symlink(outside / "a.bin", dir / "link.bin");
+    std::filesystem::create_directory_symlink(outside, dir / "sub");
+    payload_proto.set_first("link.bin");
+    CHECK(run(__LINE__, payload_proto).has_error());
+    payload_proto.set_first("sub/a.bin");
+    CHECK(run(__LINE__, payload_proto).has_error());
+    payload_proto.set_first("a.bin");
+    payload_proto.set_result("sub/c.bin");
+    CHECK(run(__LINE__, payload_proto).has_error());
+    CHECK(!std::filesystem::exists(outside / "c.bin"));
+    // Результат на месте ссылки заменяет саму ссылку, файл вне каталога не тронут
+    payload_proto.set_result("link.bin");
+    CHECK(run(__LINE__, payload_proto).has_result());
+    CHECK(!std::filesystem::is_symlink(dir / "link.bin"));
+    CHECK(std::filesystem::file_size(outside / "a.bin") == outside_size);
+    std::filesystem::remove_all(outside);
+    payload_proto.set_result("c.bin");
+
+    for (const char* path : { "../b.bin", "/tmp/b.bin", "" })
+    {
+        CAPTURE(path);
+        payload_proto.set_another(path);
+        ProcedureData request;
+        request.set_proc_id(ProcedureData::MAPPED_MUL);
+        request.set_payload(payload_proto.SerializeAsString());
+        CheckError(__LINE__, request.SerializeAsString());
+    }
+
+    ConfigureExecutor({});
+    std::filesystem::remove_all(dir);
+}
@@ -1,8 +1,29 @@
+#include "matrix_op/batch.hpp"
+#include "matrix_op/chain.hpp"
+#include "matrix_op/isa.hpp"
+#include "matrix_op/mapped.hpp"
 #include "matrix_op/matrix.hpp"
 #include "matrix_op/matrix_exception.hpp"
+#include "matrix_op/matrix_view.hpp"
+#include "matrix_op/packed.hpp"
+#include "matrix_op/parallel.hpp"
+#include "matrix_op/precision.hpp"
+#include "matrix_op/sparse.hpp"
+#include "matrix_op/storage.hpp"
 
 #include "catch2/catch_test_macros.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <span>
+#include <tuple>
+#include <vector>
+
 using namespace matrix_op;
 
 TEST_CASE("Check matrix operations", "[matrix_op]")
@@ -52,3 +73,903 @@ TEST_CASE("Check matrix operations", "[matrix_op]")
     // Умножение неправильных размерностей
     CHECK_THROWS_AS(m1 * Matrix(1, 1, content, content + 1), MatrixCalcError);
 }
+
+namespace {
+
+Matrix RandomMatrix(std::uint32_t rows, std::uint32_t columns, std::mt19937& gen)
+{
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<float> content(rows * columns);
+    for (float& v : content)
+        v = dist(gen);
+    return Matrix(rows, columns, content.data(), content.data() + content.size());
+}
+
+// Наивное умножение с накоплением в double - эталон
+std::vector<double> ReferenceMul(const Matrix& a, const Matrix& b)
+{
+    std::vector<double> result(a.Rows() * b.Columns());
+    for (std::uint32_t r = 0; r < a.Rows(); r++)
+     for (std::uint32_t c = 0; c < b.Columns(); c++)
+    {
+        double sum = 0;
+        for (std::uint32_t i = 0; i < a.Columns(); i++)
+            sum += (double) a[r][i] * b[i][c];
+        result[r * b.Columns() + c] = sum;
+    }
+    return result;
+}
+
+void CheckMul(std::uint32_t rows, std::uint32_t inner, std::uint32_t columns, std::mt19937& gen)
+{
+    CAPTURE(rows, inner, columns);
+    Matrix a = RandomMatrix(rows, inner, gen);
+    Matrix b = RandomMatrix(inner, columns, gen);
+
+    Matrix mul = a * b;
+    REQUIRE(mul.Rows() == rows);
+    REQUIRE(mul.Columns() == columns);
+
+    std::vector<double> expected = ReferenceMul(a, b);
+    for (std::size_t i = 0; i < expected.size(); i++)
+        CHECK(std::abs(mul.Content()[i] - expected[i]) <= 1e-4 * (1 + inner));
+
+    // Детерминизм: повторное умножение дает тот же результат бит в бит
+    Matrix again = a * b;
+    CHECK(std::equal(mul.Content().begin(), mul.Content().end(), again.Content().begin()));
+}
+
+} // namespace
+
+TEST_CASE("Check blocked multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(42);
+
+    // Размеры подобраны так, чтобы задеть краевые тайлы и границы блоков MC/KC/NC
+    CheckMul(1, 1, 1, gen);
+    CheckMul(3, 5, 7, gen);
+    CheckMul(4, 8, 8, gen);
+    CheckMul(17, 33, 65, gen);
+    CheckMul(130, 257, 9, gen);
+    CheckMul(129, 513, 31, gen);
+    CheckMul(2, 3, 4101, gen);
+}
+
+TEST_CASE("Check small fixed-size multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(43);
+
+    // Специализированные размеры вперемешку с обычными (5, 7) - те идут в блочное умножение
+    for (std::uint32_t rows : { 2u, 3u, 5u, 16u })
+     for (std::uint32_t inner : { 2u, 4u, 7u, 8u })
+      for (std::uint32_t columns : { 3u, 8u, 16u })
+    {
+        CheckMul(rows, inner, columns, gen);
+
+        CAPTURE(rows, inner, columns);
+        Matrix at = RandomMatrix(inner, rows, gen);
+        Matrix bt = RandomMatrix(columns, inner, gen);
+        std::vector<double> expected = ReferenceMul(Transpose(at), Transpose(bt));
+        std::vector<float> out(rows * columns);
+        Multiply(at.View(), Trans::Yes, bt.View(), Trans::Yes, MutableMatrixView(rows, columns, columns, out.data()));
+        for (std::size_t i = 0; i < expected.size(); i++)
+            CHECK(std::abs(out[i] - expected[i]) <= 1e-4 * (1 + inner));
+    }
+}
+
+TEST_CASE("Check multiplication on every supported ISA", "[matrix_op]")
+{
+    const Isa initial = ActiveIsa();
+    CHECK(IsaSupported(Isa::Scalar));
+    CHECK(IsaSupported(DetectedIsa()));
+
+    for (Isa isa : { Isa::Scalar, Isa::Avx2, Isa::Avx512 })
+    {
+        if (!IsaSupported(isa))
+        {
+            CHECK_THROWS_AS(ForceIsa(isa), MatrixCalcError);
+            continue;
+        }
+
+        CAPTURE(IsaName(isa));
+        ForceIsa(isa);
+        REQUIRE(ActiveIsa() == isa);
+
+        std::mt19937 gen(7);
+        CheckMul(1, 1, 1, gen);
+        CheckMul(13, 29, 37, gen);
+        CheckMul(150, 300, 70, gen);
+    }
+
+    ForceIsa(initial);
+
+    Isa parsed;
+    CHECK(ParseIsa("avx2", parsed));
+    CHECK(parsed == Isa::Avx2);
+    CHECK(!ParseIsa("sse", parsed));
+}
+
+TEST_CASE("Check parallel multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(13);
+    Matrix a = RandomMatrix(301, 257, gen);
+    Matrix b = RandomMatrix(257, 403, gen);
+
+    SetParallelThreshold(std::numeric_limits<std::uint64_t>::max());
+    Matrix sequential = a * b;
+
+    // Разбиение только по строкам/столбцам C - результат совпадает бит в бит
+    SetParallelThreshold(0);
+    for (std::uint32_t threads : { 1u, 3u, 8u })
+    {
+        CAPTURE(threads);
+        SetParallelism(threads);
+        REQUIRE(Parallelism() == threads);
+
+        Matrix parallel = a * b;
+        CHECK(std::equal(sequential.Content().begin(), sequential.Content().end(), parallel.Content().begin()));
+    }
+
+    SetParallelism(0);
+    SetParallelThreshold(DefaultParallelThreshold);
+}
+
+TEST_CASE("Check Strassen multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(3);
+
+    // Маленький cutoff, чтобы рекурсия шла на несколько уровней, и нечетные размеры
+    for (auto [rows, inner, columns] : { std::tuple{ 64u, 64u, 64u }, { 67u, 45u, 53u }, { 100u, 33u, 81u }, { 5u, 200u, 7u } })
+    {
+        CAPTURE(rows, inner, columns);
+        Matrix a = RandomMatrix(rows, inner, gen);
+        Matrix b = RandomMatrix(inner, columns, gen);
+
+        Matrix mul = Multiply(a, b, { MulAlgorithm::Strassen, 4 });
+        REQUIRE(mul.Rows() == rows);
+        REQUIRE(mul.Columns() == columns);
+
+        std::vector<double> expected = ReferenceMul(a, b);
+        for (std::size_t i = 0; i < expected.size(); i++)
+            CHECK(std::abs(mul.Content()[i] - expected[i]) <= 1e-3 * (1 + inner));
+    }
+
+    float content[] = { 1, 2, 3, 4 };
+    Matrix m(2, 2, content, content + 4);
+    CHECK_THROWS_AS(Multiply(m, Matrix(1, 1, content, content + 1), { MulAlgorithm::Strassen }), MatrixCalcError);
+}
+
+TEST_CASE("Check matrix storage layout", "[matrix_op]")
+{
+    std::mt19937 gen(5);
+
+    // Узкие матрицы - плотно, широкие - с выровненными строками,
+    // ширина-степень двойки - с дополнительным сдвигом против 4K aliasing
+    CHECK(LeadingDimension(3) == 3);
+    CHECK(LeadingDimension(20) == 32);
+    CHECK(LeadingDimension(1024) == 1040);
+
+    StorageOptions options = GetStorageOptions();
+    options.pad_leading_dimension = false;
+    SetStorageOptions(options);
+    CHECK(LeadingDimension(1024) == 1024);
+    options.pad_leading_dimension = true;
+    SetStorageOptions(options);
+
+    for (std::uint32_t columns : { 3u, 20u, 1024u })
+    {
+        CAPTURE(columns);
+        std::vector<float> content(5 * columns);
+        std::iota(content.begin(), content.end(), 0.f);
+
+        Matrix m(5, columns, content.data(), content.data() + content.size());
+        CHECK(m.Stride() == LeadingDimension(columns));
+        CHECK(reinterpret_cast<std::uintptr_t>(m.Data()) % RowAlignment == 0);
+        if (m.Stride() != columns)
+            CHECK(reinterpret_cast<std::uintptr_t>(m[1].data()) % RowAlignment == 0);
+
+        // Content() и operator[] видят только логические элементы
+        REQUIRE(m.Content().size() == content.size());
+        CHECK(std::equal(content.begin(), content.end(), m.Content().begin(), m.Content().end()));
+        CHECK(m[4][columns - 1] == content.back());
+
+        Matrix copy = m;
+        CHECK(std::equal(content.begin(), content.end(), copy.Content().begin()));
+    }
+
+    // Умножение на дополненных строках совпадает с эталоном
+    CheckMul(9, 1024, 20, gen);
+    CheckMul(20, 20, 1024, gen);
+
+    // Буфер под huge pages тоже выровнен
+    options.hugepage_threshold = 0;
+    SetStorageOptions(options);
+    CheckMul(3, 17, 33, gen);
+    SetStorageOptions(StorageOptions{});
+}
+
+TEST_CASE("Check multiplication of views", "[matrix_op]")
+{
+    std::mt19937 gen(11);
+    Matrix a = RandomMatrix(37, 50, gen);
+    Matrix b = RandomMatrix(50, 21, gen);
+    Matrix expected = a * b;
+
+    // Плотные данные, как в протобуфе
+    std::vector<float> a_dense(a.Content().begin(), a.Content().end());
+    std::vector<float> b_dense(b.Content().begin(), b.Content().end());
+    MatrixView a_view(37, 50, a_dense.data(), a_dense.data() + a_dense.size());
+    MatrixView b_view(50, 21, b_dense.data(), b_dense.data() + b_dense.size());
+
+    // Результат - в середину большего буфера со своим шагом
+    constexpr std::size_t stride = 30;
+    std::vector<float> out(37 * stride, -1.f);
+    Multiply(a_view, b_view, MutableMatrixView(37, 21, stride, out.data()));
+    for (std::uint32_t r = 0; r < 37; r++)
+    {
+        CHECK(std::equal(expected[r].begin(), expected[r].end(), out.data() + r * stride));
+        CHECK(out[r * stride + 21] == -1.f); // Дополнение строки не тронуто
+    }
+
+    // Matrix::View() с дополненными строками
+    std::vector<float> out_dense(37 * 21);
+    Multiply(a.View(), b.View(), MutableMatrixView(37, 21, 21, out_dense.data()));
+    CHECK(std::equal(expected.Content().begin(), expected.Content().end(), out_dense.begin()));
+
+    CHECK_THROWS_AS(MatrixView(2, 2, a_dense.data(), a_dense.data() + 3), MatrixCalcError);
+    CHECK_THROWS_AS(Multiply(b_view, a_view, MutableMatrixView(37, 21, 21, out_dense.data())), MatrixCalcError);
+    CHECK_THROWS_AS(Multiply(a_view, b_view, MutableMatrixView(21, 37, 37, out_dense.data())), MatrixCalcError);
+}
+
+TEST_CASE("Check transposed multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(23);
+
+    // Размеры не кратны MR/NR, а inner больше KC - задеты краевые панели и несколько блоков по K
+    Matrix a = RandomMatrix(70, 301, gen);
+    Matrix b = RandomMatrix(301, 45, gen);
+
+    Matrix at = Transpose(a);
+    REQUIRE(at.Rows() == 301);
+    REQUIRE(at.Columns() == 70);
+    for (std::uint32_t r = 0; r < a.Rows(); r++)
+     for (std::uint32_t c = 0; c < a.Columns(); c++)
+        REQUIRE(at[c][r] == a[r][c]);
+    Matrix bt = Transpose(b);
+
+    Matrix nn = a * b;
+    std::vector<double> expected = ReferenceMul(a, b);
+    std::vector<float> out(70 * 45);
+    for (Trans a_trans : { Trans::No, Trans::Yes })
+     for (Trans b_trans : { Trans::No, Trans::Yes })
+    {
+        CAPTURE((int) a_trans, (int) b_trans);
+        const Matrix& first = a_trans == Trans::Yes ? at : a;
+        const Matrix& another = b_trans == Trans::Yes ? bt : b;
+
+        // Упаковка дает те же панели, что и для NN - результат совпадает бит в бит
+        Multiply(first.View(), a_trans, another.View(), b_trans, MutableMatrixView(70, 45, 45, out.data()));
+        CHECK(std::equal(nn.Content().begin(), nn.Content().end(), out.begin()));
+
+        Multiply(first.View(), a_trans, another.View(), b_trans, MutableMatrixView(70, 45, 45, out.data()),
+                 { MulAlgorithm::Strassen, 4 });
+        for (std::size_t i = 0; i < expected.size(); i++)
+            CHECK(std::abs(out[i] - expected[i]) <= 1e-3 * 302);
+    }
+
+    // Транспонирование в view со своим шагом
+    constexpr std::size_t stride = 80;
+    std::vector<float> out_t(301 * stride, -1.f);
+    Transpose(a.View(), MutableMatrixView(301, 70, stride, out_t.data()));
+    for (std::uint32_t r = 0; r < 301; r++)
+    {
+        CHECK(std::equal(at[r].begin(), at[r].end(), out_t.data() + r * stride));
+        CHECK(out_t[r * stride + 70] == -1.f);
+    }
+
+    CHECK_THROWS_AS(Transpose(a.View(), MutableMatrixView(70, 301, 301, out_t.data())), MatrixCalcError);
+    CHECK_THROWS_AS(Multiply(a.View(), Trans::Yes, b.View(), Trans::No, MutableMatrixView(70, 45, 45, out.data())), MatrixCalcError);
+    CHECK_THROWS_AS(Multiply(a.View(), Trans::No, b.View(), Trans::Yes, MutableMatrixView(70, 45, 45, out.data())), MatrixCalcError);
+    CHECK_NOTHROW(ValidateMulShapes(a.View(), Trans::Yes, at.View(), Trans::Yes));
+}
+
+TEST_CASE("Check matrix chain multiplication", "[matrix_op]")
+{
+    // Пример из CLRS: оптимум ((A1 (A2 A3)) ((A4 A5) A6)) = 15125
+    const std::uint32_t dims[] = { 30, 35, 15, 5, 10, 20, 25 };
+    ChainOrder order(dims);
+    CHECK(order.Size() == 6);
+    CHECK(order.Cost() == 15125);
+    CHECK(order.Split(0, 5) == 2);
+    CHECK(order.Split(0, 2) == 0);
+    CHECK(order.Split(3, 5) == 4);
+    // Промежуточные 30x5, 35x5, 5x25 и 5x20
+    CHECK(LargestChainIntermediate(dims) == std::pair<std::uint32_t, std::uint32_t>{ 35, 5 });
+    CHECK(LargestChainIntermediate(std::span(dims).first(3)) == std::pair<std::uint32_t, std::uint32_t>{ 0, 0 });
+
+    std::mt19937 gen(17);
+    std::vector<Matrix> matrices;
+    for (std::size_t i = 0; i + 1 < std::size(dims); i++)
+        matrices.push_back(RandomMatrix(dims[i], dims[i + 1], gen));
+
+    Matrix expected = matrices[0];
+    std::vector<MatrixView> factors;
+    for (std::size_t i = 0; i < matrices.size(); i++)
+    {
+        if (i > 0)
+            expected = expected * matrices[i];
+        factors.push_back(matrices[i].View());
+    }
+
+    BufferPool pool;
+    std::vector<float> out(30 * 25);
+    MultiplyChain(factors, MutableMatrixView(30, 25, 25, out.data()), {}, pool);
+    for (std::size_t i = 0; i < out.size(); i++)
+        CHECK(std::abs(out[i] - expected.Content()[i]) <= 1e-3);
+
+    // Одиночный множитель - копия
+    out.resize(30 * 35);
+    MultiplyChain(std::span(factors).first(1), MutableMatrixView(30, 35, 35, out.data()), {}, pool);
+    CHECK(std::equal(matrices[0].Content().begin(), matrices[0].Content().end(), out.begin()));
+
+    std::swap(factors[1], factors[2]);
+    CHECK_THROWS_AS(MultiplyChain(factors, MutableMatrixView(30, 25, 25, out.data()), {}, pool), MatrixCalcError);
+}
+
+TEST_CASE("Check reduced precision conversions", "[matrix_op]")
+{
+    for (float v : { 0.f, 1.f, -2.5f, 0x1p-14f, 0x1p-24f, 0x3p-24f })
+    {
+        CAPTURE(v);
+        CHECK(ToFloat(ToFloat16(v)) == v);
+        CHECK(ToFloat(ToBFloat16(v)) == v);
+    }
+
+    // Округление к ближайшему четному и переполнение
+    CHECK(ToFloat(ToFloat16(65504.f)) == 65504.f);
+    CHECK(ToFloat(ToFloat16(1.f + 0x1p-11f)) == 1.f);
+    CHECK(ToFloat(ToFloat16(1.f + 0x3p-11f)) == 1.f + 0x1p-9f);
+    CHECK(ToFloat(ToFloat16(65520.f)) == std::numeric_limits<float>::infinity());
+    CHECK(ToFloat(ToFloat16(0x1p-26f)) == 0.f);
+    CHECK(std::isnan(ToFloat(ToFloat16(std::numeric_limits<float>::quiet_NaN()))));
+    CHECK(ToFloat(ToBFloat16(1.f + 0x1p-8f)) == 1.f);
+    CHECK(ToFloat(ToBFloat16(1.f + 0x3p-8f)) == 1.f + 0x1p-6f);
+    CHECK(std::isnan(ToFloat(ToBFloat16(std::numeric_limits<float>::quiet_NaN()))));
+
+    // Квантование: ноль точен, края диапазона - в пределах шага
+    const Quantization q = ChooseQuantization(-1.f, 3.f);
+    CHECK(Dequantize(Quantize(0.f, q), q) == 0.f);
+    CHECK(std::abs(Dequantize(Quantize(-1.f, q), q) + 1.f) <= q.scale);
+    CHECK(std::abs(Dequantize(Quantize(3.f, q), q) - 3.f) <= q.scale);
+    CHECK(Quantize(100.f, q) == 127);
+    CHECK(ChooseQuantization(0.f, 0.f).scale == 1.f);
+}
+
+namespace {
+
+// Эталон op(A) * op(B) по расширенным до double значениям плотных A и B
+template<typename HalfT>
+std::vector<double> ReferenceHalfMul(std::uint32_t rows, std::uint32_t inner, std::uint32_t columns,
+                                     const std::vector<HalfT>& a, Trans a_trans, const std::vector<HalfT>& b, Trans b_trans)
+{
+    std::vector<double> result(rows * columns);
+    for (std::uint32_t r = 0; r < rows; r++)
+     for (std::uint32_t c = 0; c < columns; c++)
+    {
+        double sum = 0;
+        for (std::uint32_t i = 0; i < inner; i++)
+        {
+            const HalfT av = a_trans == Trans::Yes ? a[i * rows + r] : a[r * inner + i];
+            const HalfT bv = b_trans == Trans::Yes ? b[c * inner + i] : b[i * columns + c];
+            sum += double(ToFloat(av)) * ToFloat(bv);
+        }
+        result[r * columns + c] = sum;
+    }
+    return result;
+}
+
+template<typename HalfT>
+void CheckHalfMul(std::uint32_t rows, std::uint32_t inner, std::uint32_t columns, std::mt19937& gen, auto convert)
+{
+    CAPTURE(rows, inner, columns);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<HalfT> a(rows * inner), b(inner * columns);
+    for (HalfT& v : a)
+        v = convert(dist(gen));
+    for (HalfT& v : b)
+        v = convert(dist(gen));
+
+    std::vector<float> out(rows * columns);
+    for (Trans a_trans : { Trans::No, Trans::Yes })
+     for (Trans b_trans : { Trans::No, Trans::Yes })
+    {
+        CAPTURE((int) a_trans, (int) b_trans);
+        // Хранение не меняется, меняется только смысл: транспонированный A - это inner x rows
+        BasicMatrixView<HalfT> a_view = a_trans == Trans::Yes ? BasicMatrixView<HalfT>(inner, rows, rows, a.data())
+                                                              : BasicMatrixView<HalfT>(rows, inner, inner, a.data());
+        BasicMatrixView<HalfT> b_view = b_trans == Trans::Yes ? BasicMatrixView<HalfT>(columns, inner, inner, b.data())
+                                                              : BasicMatrixView<HalfT>(inner, columns, columns, b.data());
+        Multiply(a_view, a_trans, b_view, b_trans, MutableMatrixView(rows, columns, columns, out.data()));
+
+        std::vector<double> expected = ReferenceHalfMul(rows, inner, columns, a, a_trans, b, b_trans);
+        for (std::size_t i = 0; i < expected.size(); i++)
+            CHECK(std::abs(out[i] - expected[i]) <= 1e-4 * (1 + inner));
+    }
+}
+
+void CheckInt8Mul(std::uint32_t rows, std::uint32_t inner, std::uint32_t columns, std::mt19937& gen)
+{
+    CAPTURE(rows, inner, columns);
+    std::uniform_int_distribution<int> dist(-128, 127);
+    std::vector<std::int8_t> a(rows * inner), b(inner * columns);
+    for (std::int8_t& v : a)
+        v = dist(gen);
+    for (std::int8_t& v : b)
+        v = dist(gen);
+
+    // Крайние нулевые точки: |q - zero_point| доходит до 255
+    const Quantization qa{ 0.5f, -128 }, qb{ 0.25f, 127 };
+
+    std::vector<float> out(rows * columns);
+    for (Trans a_trans : { Trans::No, Trans::Yes })
+     for (Trans b_trans : { Trans::No, Trans::Yes })
+    {
+        CAPTURE((int) a_trans, (int) b_trans);
+        QuantizedMatrixView a_view{ a_trans == Trans::Yes ? BasicMatrixView<std::int8_t>(inner, rows, rows, a.data())
+                                                          : BasicMatrixView<std::int8_t>(rows, inner, inner, a.data()), qa };
+        QuantizedMatrixView b_view{ b_trans == Trans::Yes ? BasicMatrixView<std::int8_t>(columns, inner, inner, b.data())
+                                                          : BasicMatrixView<std::int8_t>(inner, columns, columns, b.data()), qb };
+        Multiply(a_view, a_trans, b_view, b_trans, MutableMatrixView(rows, columns, columns, out.data()));
+
+        for (std::uint32_t r = 0; r < rows; r++)
+         for (std::uint32_t c = 0; c < columns; c++)
+        {
+            // Целочисленная сумма точна, погрешность - только от сложения блоков K в fp32
+            std::int64_t sum = 0;
+            for (std::uint32_t i = 0; i < inner; i++)
+            {
+                const std::int64_t av = a_trans == Trans::Yes ? a[i * rows + r] : a[r * inner + i];
+                const std::int64_t bv = b_trans == Trans::Yes ? b[c * inner + i] : b[i * columns + c];
+                sum += (av - qa.zero_point) * (bv - qb.zero_point);
+            }
+            const double expected = double(qa.scale) * qb.scale * sum;
+            CHECK(std::abs(out[r * columns + c] - expected) <= 1e-6 * (1 + std::abs(expected)));
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("Check reduced precision multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(29);
+
+    // Краевые тайлы, нечетный inner (дополнение пар int8) и несколько блоков K
+    CheckHalfMul<Float16>(13, 301, 37, gen, [](float v) { return ToFloat16(v); });
+    CheckHalfMul<BFloat16>(13, 301, 37, gen, [](float v) { return ToBFloat16(v); });
+
+    const Isa initial = ActiveIsa();
+    for (Isa isa : { Isa::Scalar, DetectedIsa() })
+    {
+        CAPTURE(IsaName(isa));
+        ForceIsa(isa);
+        CheckInt8Mul(1, 1, 1, gen);
+        CheckInt8Mul(13, 301, 37, gen);
+        CheckInt8Mul(100, 513, 20, gen);
+    }
+    ForceIsa(initial);
+
+    // Параллельное int8-умножение по полосам строк
+    SetParallelThreshold(0);
+    SetParallelism(4);
+    CheckInt8Mul(300, 33, 17, gen);
+    SetParallelism(0);
+    SetParallelThreshold(DefaultParallelThreshold);
+
+    std::vector<Float16> data(6);
+    Float16MatrixView view(2, 3, data.data(), data.data() + data.size());
+    std::vector<float> out(4);
+    CHECK_THROWS_AS(Multiply(view, Trans::No, view, Trans::No, MutableMatrixView(2, 3, 3, out.data())), MatrixCalcError);
+    CHECK_NOTHROW(Multiply(view, Trans::No, view, Trans::Yes, MutableMatrixView(2, 2, 2, out.data())));
+}
+
+namespace {
+
+// Плотная матрица, в которой ненулевой только доля density элементов
+Matrix RandomSparseMatrix(std::uint32_t rows, std::uint32_t columns, double density, std::mt19937& gen)
+{
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::bernoulli_distribution non_zero(density);
+    std::vector<float> content(rows * columns);
+    for (float& v : content)
+        v = non_zero(gen) ? dist(gen) : 0.f;
+    return Matrix(rows, columns, content.data(), content.data() + content.size());
+}
+
+void CheckDense(const std::vector<float>& result, const std::vector<double>& expected, std::uint32_t inner)
+{
+    REQUIRE(result.size() == expected.size());
+    for (std::size_t i = 0; i < expected.size(); i++)
+        CHECK(std::abs(result[i] - expected[i]) <= 1e-5 * (1 + inner));
+}
+
+void CheckSparseMul(std::uint32_t rows, std::uint32_t inner, std::uint32_t columns, std::mt19937& gen)
+{
+    CAPTURE(rows, inner, columns);
+    Matrix a = RandomSparseMatrix(rows, inner, 0.1, gen);
+    Matrix b = RandomSparseMatrix(inner, columns, 0.2, gen);
+    Matrix dense_b = RandomMatrix(inner, columns, gen);
+    Matrix dense_a = RandomMatrix(rows, inner, gen);
+
+    std::vector<float> out(rows * columns);
+    MutableMatrixView result(rows, columns, columns, out.data());
+    for (SparseLayout layout : { SparseLayout::Csr, SparseLayout::Csc })
+    {
+        CAPTURE((int) layout);
+        const SparseMatrix sparse_a = SparseMatrix::FromDense(a.View(), layout);
+        const SparseMatrix sparse_b = SparseMatrix::FromDense(b.View(), layout);
+
+        Multiply(sparse_a.View(), dense_b.View(), result);
+        CheckDense(out, ReferenceMul(a, dense_b), inner);
+
+        Multiply(dense_a.View(), sparse_b.View(), result);
+        CheckDense(out, ReferenceMul(dense_a, b), inner);
+
+        const SparseMatrix product = Multiply(sparse_a.View(), sparse_b.View());
+        CHECK(product.Layout() == SparseLayout::Csr);
+        ToDense(product.View(), result);
+        CheckDense(out, ReferenceMul(a, b), inner);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Check sparse matrices", "[matrix_op]")
+{
+    std::mt19937 gen(31);
+    Matrix dense = RandomSparseMatrix(17, 23, 0.2, gen);
+
+    for (SparseLayout layout : { SparseLayout::Csr, SparseLayout::Csc })
+    {
+        const SparseMatrix sparse = SparseMatrix::FromDense(dense.View(), layout);
+        CHECK(sparse.Rows() == 17);
+        CHECK(sparse.Columns() == 23);
+        CHECK(sparse.NonZeros() == std::size_t(std::count_if(dense.Content().begin(), dense.Content().end(), [](float v) { return v != 0; })));
+
+        std::vector<float> back(17 * 23);
+        ToDense(sparse.View(), MutableMatrixView(17, 23, 23, back.data()));
+        CHECK(std::equal(back.begin(), back.end(), dense.Content().begin()));
+
+        // Переупаковка туда и обратно сохраняет элементы
+        const SparseMatrix other = Convert(sparse.View(), layout == SparseLayout::Csr ? SparseLayout::Csc : SparseLayout::Csr);
+        std::fill(back.begin(), back.end(), 1.f);
+        ToDense(Convert(other.View(), layout).View(), MutableMatrixView(17, 23, 23, back.data()));
+        CHECK(std::equal(back.begin(), back.end(), dense.Content().begin()));
+
+        // Транспонирование без копирования
+        const Matrix transposed = Transpose(dense);
+        ToDense(sparse.View().Transposed(), MutableMatrixView(23, 17, 17, back.data()));
+        CHECK(std::equal(back.begin(), back.end(), transposed.Content().begin()));
+    }
+
+    // Некорректная структура: 2 x 3 CSR
+    const std::vector<std::uint32_t> offsets = { 0, 1, 2 };
+    const std::vector<std::uint32_t> indices = { 0, 2 };
+    const std::vector<float> values = { 1, 2 };
+    CHECK_NOTHROW(SparseMatrixView(2, 3, SparseLayout::Csr, offsets, indices, values));
+    CHECK_THROWS_AS(SparseMatrixView(3, 3, SparseLayout::Csr, offsets, indices, values), MatrixCalcError);
+    CHECK_THROWS_AS(SparseMatrixView(2, 2, SparseLayout::Csr, offsets, indices, values), MatrixCalcError);
+    CHECK_THROWS_AS(SparseMatrixView(2, 3, SparseLayout::Csr, offsets, indices, std::span(values).first(1)), MatrixCalcError);
+    const std::vector<std::uint32_t> decreasing = { 0, 2, 1 };
+    CHECK_THROWS_AS(SparseMatrixView(2, 3, SparseLayout::Csr, decreasing, indices, values), MatrixCalcError);
+}
+
+TEST_CASE("Check sparse multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(37);
+    CheckSparseMul(1, 1, 1, gen);
+    CheckSparseMul(40, 31, 1, gen); // SpMV
+    CheckSparseMul(57, 43, 29, gen);
+
+    // Параллельно по полосам строк
+    SetParallelThreshold(0);
+    SetParallelism(4);
+    CheckSparseMul(200, 61, 1, gen);
+    CheckSparseMul(200, 61, 37, gen);
+    SetParallelism(0);
+    SetParallelThreshold(DefaultParallelThreshold);
+
+    Matrix a = RandomSparseMatrix(3, 4, 0.5, gen);
+    const SparseMatrix sparse = SparseMatrix::FromDense(a.View(), SparseLayout::Csr);
+    std::vector<float> out(9);
+    MutableMatrixView result(3, 3, 3, out.data());
+    CHECK_THROWS_AS(Multiply(sparse.View(), a.View(), result), MatrixCalcError);
+    CHECK_THROWS_AS(Multiply(sparse.View(), sparse.View()), MatrixCalcError);
+    CHECK_NOTHROW(Multiply(sparse.View(), sparse.View().Transposed()));
+    CHECK_NOTHROW(Multiply(a.View(), sparse.View().Transposed(), result));
+}
+
+namespace {
+
+void CheckBatchMul(std::uint32_t count, std::uint32_t rows, std::uint32_t inner, std::uint32_t columns, std::mt19937& gen)
+{
+    CAPTURE(count, rows, inner, columns);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<float> first(count * rows * inner);
+    std::vector<float> another(count * inner * columns);
+    for (float& v : first)
+        v = dist(gen);
+    for (float& v : another)
+        v = dist(gen);
+
+    std::vector<float> result(count * rows * columns);
+    MultiplyBatch({ count, rows, inner, columns }, first, another, result);
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        Matrix a(rows, inner, first.data() + i * rows * inner, first.data() + (i + 1) * rows * inner);
+        Matrix b(inner, columns, another.data() + i * inner * columns, another.data() + (i + 1) * inner * columns);
+        std::vector<double> expected = ReferenceMul(a, b);
+        for (std::size_t j = 0; j < expected.size(); j++)
+            CHECK(std::abs(result[i * rows * columns + j] - expected[j]) <= 1e-5 * (1 + inner));
+    }
+}
+
+} // namespace
+
+TEST_CASE("Check batched multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(41);
+
+    // Группами по линиям с остатком, по одной (columns >= 8) и большие через блочное умножение
+    CheckBatchMul(1, 2, 2, 2, gen);
+    CheckBatchMul(37, 2, 2, 2, gen);
+    CheckBatchMul(19, 3, 5, 4, gen);
+    CheckBatchMul(11, 4, 3, 16, gen);
+    CheckBatchMul(3, 40, 20, 30, gen);
+
+    SetParallelThreshold(0);
+    SetParallelism(4);
+    CheckBatchMul(301, 3, 3, 3, gen);
+    SetParallelism(0);
+    SetParallelThreshold(DefaultParallelThreshold);
+
+    std::vector<float> data(8);
+    CHECK_THROWS_AS(MultiplyBatch({ 2, 2, 2, 2 }, data, std::span(data).first(7), data), MatrixCalcError);
+    CHECK_THROWS_AS(MultiplyBatch({ 2, 2, 2, 2 }, data, data, std::span(data).first(4)), MatrixCalcError);
+    CHECK_THROWS_AS(MultiplyBatch({ 0, 2, 2, 2 }, {}, {}, {}), MatrixCalcError);
+    // Все размеры данных переполняются в 0 и совпали бы с пустыми входами
+    CHECK_THROWS_AS(ValidateBatch({ 1u << 22, 1u << 21, 1u << 21, 1u << 21 }, {}, {}), MatrixCalcError);
+    CHECK_THROWS_AS(MultiplyBatch({ 1u << 22, 1u << 21, 1u << 21, 1u << 21 }, {}, {}, {}), MatrixCalcError);
+}
+
+namespace {
+
+// result = relu(alpha * a * b + beta * c + bias) через эпилог против эталона
+void CheckEpilogue(std::uint32_t rows, std::uint32_t inner, std::uint32_t columns, std::mt19937& gen,
+                   MulAlgorithm algorithm = MulAlgorithm::Classic)
+{
+    CAPTURE(rows, inner, columns, (int) algorithm);
+    Matrix a = RandomMatrix(rows, inner, gen);
+    Matrix b = RandomMatrix(inner, columns, gen);
+    Matrix c = RandomMatrix(rows, columns, gen);
+    Matrix bias = RandomMatrix(1, columns, gen);
+
+    MulOptions options;
+    options.algorithm = algorithm;
+    options.strassen_cutoff = 16;
+    options.epilogue = { 0.5f, -2.f, bias.Data(), Activation::Relu };
+
+    std::vector<float> out(rows * columns);
+    for (std::uint32_t r = 0; r < rows; r++)
+        std::copy(c[r].begin(), c[r].end(), out.begin() + r * columns);
+    Multiply(a.View(), b.View(), MutableMatrixView(rows, columns, columns, out.data()), options);
+
+    std::vector<double> expected = ReferenceMul(a, b);
+    for (std::uint32_t r = 0; r < rows; r++)
+     for (std::uint32_t col = 0; col < columns; col++)
+    {
+        const double value = 0.5 * expected[r * columns + col] - 2.0 * c[r][col] + bias[0][col];
+        CHECK(std::abs(out[r * columns + col] - std::max(value, 0.0)) <= 1e-4 * (1 + inner));
+    }
+}
+
+} // namespace
+
+TEST_CASE("Check fused epilogue", "[matrix_op]")
+{
+    std::mt19937 gen(47);
+
+    // Фиксированный размер, краевые тайлы и несколько блоков K (beta только в первом, bias - в последнем)
+    const Isa initial = ActiveIsa();
+    for (Isa isa : { Isa::Scalar, DetectedIsa() })
+    {
+        CAPTURE(IsaName(isa));
+        ForceIsa(isa);
+        CheckEpilogue(4, 8, 8, gen);
+        CheckEpilogue(13, 29, 37, gen);
+        CheckEpilogue(130, 300, 70, gen);
+    }
+    ForceIsa(initial);
+
+    CheckEpilogue(70, 65, 45, gen, MulAlgorithm::Strassen);
+
+    SetParallelThreshold(0);
+    SetParallelism(4);
+    CheckEpilogue(300, 40, 200, gen);
+    SetParallelism(0);
+    SetParallelThreshold(DefaultParallelThreshold);
+
+    // Без beta результат не читается: мусор в нем не влияет
+    Matrix a = RandomMatrix(5, 7, gen);
+    std::vector<float> out(25, std::numeric_limits<float>::quiet_NaN());
+    MulOptions options;
+    options.epilogue.alpha = 2;
+    Multiply(a.View(), Trans::No, a.View(), Trans::Yes, MutableMatrixView(5, 5, 5, out.data()), options);
+    const Matrix plain = Multiply(a, Transpose(a), {});
+    for (std::size_t i = 0; i < out.size(); i++)
+        CHECK(out[i] == 2 * plain.Content()[i]);
+
+    // Эпилог цепочки - только у последнего умножения
+    const Matrix at = Transpose(a);
+    const std::vector<MatrixView> factors = { a.View(), at.View(), a.View() };
+    std::vector<float> chain(35);
+    BufferPool pool;
+    options.epilogue.activation = Activation::Relu;
+    MultiplyChain(factors, MutableMatrixView(5, 7, 7, chain.data()), options, pool);
+    const Matrix plain_chain = plain * a;
+    for (std::size_t i = 0; i < chain.size(); i++)
+        CHECK(std::abs(chain[i] - std::max(2 * plain_chain.Content()[i], 0.f)) <= 1e-5);
+
+    options.epilogue.beta = 1;
+    CHECK_THROWS_AS(Multiply(a, a, options), MatrixCalcError);
+}
+
+namespace {
+
+// Упакованная B дает те же панели, что и упаковка внутри Multiply - результат совпадает бит в бит
+void CheckPackedMul(std::uint32_t rows, std::uint32_t inner, std::uint32_t columns, std::mt19937& gen)
+{
+    CAPTURE(rows, inner, columns);
+    Matrix a = RandomMatrix(rows, inner, gen);
+    Matrix b = RandomMatrix(inner, columns, gen);
+    Matrix at = Transpose(a);
+    Matrix bt = Transpose(b);
+    Matrix bias = RandomMatrix(1, columns, gen);
+
+    MulOptions options;
+    options.epilogue.alpha = 0.5f;
+    options.epilogue.bias = bias.Data();
+    std::vector<float> expected(rows * columns);
+    Multiply(a.View(), b.View(), MutableMatrixView(rows, columns, columns, expected.data()), options);
+
+    std::vector<float> out(rows * columns);
+    for (Trans a_trans : { Trans::No, Trans::Yes })
+     for (Trans b_trans : { Trans::No, Trans::Yes })
+    {
+        CAPTURE((int) a_trans, (int) b_trans);
+        const PackedMatrix packed(b_trans == Trans::Yes ? bt.View() : b.View(), b_trans);
+        REQUIRE(packed.Rows() == inner);
+        REQUIRE(packed.Columns() == columns);
+        CHECK(packed.Bytes() >= std::size_t(inner) * columns * sizeof(float));
+
+        std::fill(out.begin(), out.end(), -1.f);
+        Multiply(a_trans == Trans::Yes ? at.View() : a.View(), a_trans, packed,
+                 MutableMatrixView(rows, columns, columns, out.data()), options);
+        CHECK(out == expected);
+    }
+}
+
+} // namespace
+
+TEST_CASE("Check prepacked multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(53);
+
+    // Краевые панели, несколько блоков K и (2 x 3 x 4101) несколько блоков NC
+    const Isa initial = ActiveIsa();
+    for (Isa isa : { Isa::Scalar, DetectedIsa() })
+    {
+        CAPTURE(IsaName(isa));
+        ForceIsa(isa);
+        CheckPackedMul(13, 29, 37, gen);
+        CheckPackedMul(130, 300, 70, gen);
+        CheckPackedMul(2, 3, 4101, gen);
+    }
+
+    // Упаковка помнит свое ядро: смена ISA после нее не ломает умножение
+    Matrix a = RandomMatrix(20, 30, gen);
+    Matrix b = RandomMatrix(30, 40, gen);
+    ForceIsa(Isa::Scalar);
+    const PackedMatrix packed(b.View());
+    Matrix expected = a * b;
+    ForceIsa(DetectedIsa());
+    std::vector<float> out(20 * 40);
+    Multiply(a.View(), Trans::No, packed, MutableMatrixView(20, 40, 40, out.data()));
+    CHECK(std::equal(expected.Content().begin(), expected.Content().end(), out.begin()));
+    ForceIsa(initial);
+
+    // Тайлы потоков режут блоки упаковки по столбцам
+    SetParallelThreshold(0);
+    SetParallelism(4);
+    CheckPackedMul(300, 20, 4200, gen);
+    SetParallelism(0);
+    SetParallelThreshold(DefaultParallelThreshold);
+
+    CHECK_THROWS_AS(Multiply(a.View(), Trans::Yes, packed, MutableMatrixView(20, 40, 40, out.data())), MatrixCalcError);
+    CHECK_THROWS_AS(Multiply(a.View(), Trans::No, packed, MutableMatrixView(20, 30, 30, out.data())), MatrixCalcError);
+}
+
+TEST_CASE("Check out-of-core multiplication", "[matrix_op]")
+{
+    std::mt19937 gen(59);
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "matrix_op_mapped_test";
+    std::filesystem::create_directories(dir);
+
+    auto create = [&](const char* name, const Matrix& source)
+    {
+        MappedMatrix mapped = MappedMatrix::Create((dir / name).string(), source.Rows(), source.Columns());
+        MutableMatrixView view = mapped.MutableView();
+        for (std::uint32_t r = 0; r < source.Rows(); r++)
+            std::copy(source[r].begin(), source[r].end(), view[r].begin());
+        mapped.Commit();
+        return mapped;
+    };
+
+    // inner > нескольких блоков K, чтобы B проходил слоями
+    const Matrix a = RandomMatrix(150, 600, gen);
+    const Matrix b = RandomMatrix(600, 70, gen);
+    const Matrix expected = a * b;
+    create("a.bin", a);
+    create("b.bin", b);
+
+    const MappedMatrix first = MappedMatrix::Open((dir / "a.bin").string());
+    const MappedMatrix another = MappedMatrix::Open((dir / "b.bin").string());
+    REQUIRE(first.Rows() == 150);
+    REQUIRE(first.Columns() == 600);
+    CHECK(!first.Writable());
+
+    // Окно меньше матриц: много полос A и слоев B. И окно больше всего - одно умножение
+    for (std::size_t working_set : { std::size_t(64 * 1024), DefaultOutOfCoreWorkingSet })
+    {
+        CAPTURE(working_set);
+        MappedMatrix result = MappedMatrix::Create((dir / "c.bin").string(), 150, 70);
+        MultiplyOutOfCore(first, another, result, { working_set });
+        CHECK(std::equal(expected.Content().begin(), expected.Content().end(), MatrixContent(result.View().Data(), 150, 70, 70).begin()));
+        result.Commit();
+    }
+    CHECK_THROWS_AS(create("d.bin", a).Commit(), MatrixCalcError);
+
+    // Результат в файле переживает закрытие
+    {
+        const MappedMatrix reopened = MappedMatrix::Open((dir / "c.bin").string());
+        CHECK(reopened.View()[149][69] == expected[149][69]);
+    }
+
+    // Новый файл на месте открытого: открытый видит прежние данные, без Commit файл не меняется
+    {
+        MappedMatrix replacing = MappedMatrix::Create((dir / "b.bin").string(), 3, 3);
+        CHECK(replacing.Replaces(another));
+        CHECK(!replacing.Replaces(first));
+    }
+    CHECK(MappedMatrix::Open((dir / "b.bin").string()).Rows() == 600);
+    {
+        MappedMatrix replacing = MappedMatrix::Create((dir / "b.bin").string(), 3, 3);
+        replacing.Commit();
+        CHECK(!replacing.Replaces(another));
+    }
+    CHECK(MappedMatrix::Open((dir / "b.bin").string()).Rows() == 3);
+    CHECK(std::equal(b.Content().begin(), b.Content().end(), MatrixContent(another.View().Data(), 600, 70, 70).begin()));
+
+    MappedMatrix wrong = MappedMatrix::Create((dir / "w.bin").string(), 70, 150);
+    CHECK_THROWS_AS(MultiplyOutOfCore(first, another, wrong), MatrixCalcError);
+    CHECK_THROWS_AS(MultiplyOutOfCore(another, first, wrong), MatrixCalcError);
+
+    MappedMatrix read_only = MappedMatrix::Open((dir / "a.bin").string());
+    CHECK_THROWS_AS(read_only.MutableView(), MatrixCalcError);
+    CHECK_THROWS_AS(MappedMatrix::Open((dir / "missing.bin").string()), MatrixCalcError);
+    std::ofstream((dir / "junk.bin").string()) << "not a matrix file, but long enough to hold the header of one.........";
+    CHECK_THROWS_AS(MappedMatrix::Open((dir / "junk.bin").string()), MatrixCalcError);
+
+    std::filesystem::remove_all(dir);
+}